@@ -0,0 +1,85 @@
+#ifndef BRESENHAM_HPP
+#define BRESENHAM_HPP
+
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+#include "curve.hpp"
+
+// compact all-octant integer line, kept to compare against Bresenham()
+vpoints<int> line(int x0, int y0, int x1, int y1)
+{
+    int dx = abs(x1-x0), sx = x0<x1 ? 1 : -1;
+    int dy = abs(y1-y0), sy = y0<y1 ? 1 : -1;
+    int err = (dx>dy ? dx : -dy)/2, e2;
+    
+    vpoints<int> points;
+    
+    for(;;){
+//        setPixel(x0,y0);
+        points.push_back({x0, y0});
+        if (x0==x1 && y0==y1) break;
+        e2 = err;
+        if (e2 >-dx) { err -= dy; x0 += sx; }
+        if (e2 < dy) { err += dx; y0 += sy; }
+    }
+    
+    return points;
+}
+
+// computes a list of pixels that form a line using Bresenham's algorithm, where endpoints are p1 and p2
+// start is p1: (x1, y1), end is p2: (x2, y2)
+// post: output size is between [1, max(dx, dy) + 1] px, all coords are unique, contiguous (no more than 1 px away, list is in order from end to end
+vpoints<int> Bresenham(int x1, int y1, int x2, int y2)
+{
+    auto dx = x2 - x1;
+    if (x2 < x1) // if p2 is to the left of p1, swap p1 and p2, narrow down to quadrants I & IV
+        return Bresenham(x2, y2, x1, y1);
+    
+    auto dy = y2 - y1;
+    // if too steep, reflect y=x to graph in terms of f(y), then reflect x&y of each resulting pixel
+    // narrows down to lines that are +/- 45 deg
+    if (std::abs(dy) > dx)
+    {
+        auto flipped = Bresenham(y1, x1, y2, x2);
+        for (auto &point : flipped)
+            std::swap(point.first, point.second);
+        
+        return flipped;
+    }
+    
+    // if line slopes down, draw it sloping up, reflect about y=y1, reflect back when done
+    // narrows down to only +45 deg
+    if (dy < 0)
+    {
+        auto mirrored = Bresenham(x1, y1, x2, y1 - dy);
+        for (auto &point : mirrored)
+        {
+            auto d = point.second - y1; // pixel's y-dist from y1
+            point.second = y1 - d; // sink it that far below y1
+        }
+        
+        return mirrored; // should be sloping down now
+    }
+    
+    vpoints<int> points;
+    points.reserve(dx + 1);
+    
+    auto d_error = 0;
+    for (int x = x1, y = y1; x <= x2; ++x)
+    {
+        points.push_back({x, y});
+        d_error += dy; // for each px, accumulate error, error += dy/dx
+
+        if (2 * d_error >= dx) // if error > dx/2, then the line has left the current pixel, and entered the one above
+        {
+            ++y; // pixel moves to the adjacent above
+            d_error -= dx; // "reset" the error
+        }
+    }
+    
+    return points;
+}
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef CURVE_HPP
+#define CURVE_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// 2D point, simple alias is enough
+template<typename T>
+using point = std::pair<T, T>;
+
+// alias for list of 2D point, to avoid typing
+template<typename T>
+using vpoints = std::vector<point<int>>;
+
+// evaluates a curve at every parameter in ts, results go into xs and ys
+// kept as plain arrays in a flat loop so an inlined curve (lambda, functor) can be vectorised by the compiler
+template<typename F>
+void sample_curve(const F &curve, const std::vector<double> &ts, std::vector<double> &xs, std::vector<double> &ys)
+{
+    xs.resize(ts.size());
+    ys.resize(ts.size());
+
+    for (size_t i = 0; i < ts.size(); ++i)
+    {
+        point<double> p = curve(ts[i]);
+        xs[i] = p.first;
+        ys[i] = p.second;
+    }
+}
+
+// turns a parametric curve into a polyline whose segments are all within tolerance (px) of the curve
+// curve is anything callable as point<double>(double): lambda, functor, std::function
+// starts from initial_segments uniform steps over [t0, t1], then splits every segment in three where the curve at a
+// third or two thirds of the way strays further than tolerance from the chord at the same place. one interior point
+// alone can fall back on the chord of a wiggle (a sine over a whole period crosses its chord at the middle), two
+// can't both do that unless the wiggle is a third of the segment. segments are always split for the first min_depth
+// levels, so the curve is seen at least 3^min_depth times finer than the initial steps before anything counts as flat
+// splitting is done a level at a time, so all the points of a level are evaluated in one batch. each point is
+// evaluated once and shared by the 2 segments it joins
+// post: first point is curve(t0), last is curve(t1), consecutive points are the endpoints of a segment
+template<typename F>
+std::vector<point<double>> flatten(const F &curve, double t0, double t1, double tolerance = 0.5,
+                                   size_t initial_segments = 32, size_t max_depth = 8, size_t min_depth = 1)
+{
+    if (initial_segments < 1)
+        initial_segments = 1;
+
+    // polyline so far, flat[i] is set when the segment (i, i + 1) is done
+    std::vector<double> ts(initial_segments + 1), xs, ys;
+    std::vector<char> flat(initial_segments, 0);
+
+    for (size_t i = 0; i <= initial_segments; ++i)
+        ts[i] = t0 + (t1 - t0) * i / initial_segments;
+
+    sample_curve(curve, ts, xs, ys);
+
+    std::vector<double> in_ts, in_xs, in_ys; // 2 points inside each unfinished segment, at 1/3 and 2/3
+    std::vector<double> next_ts, next_xs, next_ys;
+    std::vector<char> next_flat;
+
+    const double tol2 = tolerance * tolerance;
+
+    for (size_t depth = 0; depth < max_depth; ++depth)
+    {
+        // gather the inner points of every unfinished segment, evaluate them all at once
+        in_ts.clear();
+        for (size_t i = 0; i < flat.size(); ++i)
+        {
+            if (flat[i])
+                continue;
+
+            in_ts.push_back((2 * ts[i] + ts[i + 1]) / 3);
+            in_ts.push_back((ts[i] + 2 * ts[i + 1]) / 3);
+        }
+
+        if (in_ts.empty())
+            break;
+
+        sample_curve(curve, in_ts, in_xs, in_ys);
+
+        next_ts.clear();
+        next_xs.clear();
+        next_ys.clear();
+        next_flat.clear();
+
+        // splice the inner points of the segments that are still too far from the curve
+        for (size_t i = 0, k = 0; i < flat.size(); ++i)
+        {
+            next_ts.push_back(ts[i]);
+            next_xs.push_back(xs[i]);
+            next_ys.push_back(ys[i]);
+
+            if (flat[i])
+            {
+                next_flat.push_back(1);
+                continue;
+            }
+
+            // how far the curve is from the chord, a third and two thirds of the way along both
+            bool close = depth >= min_depth;
+            for (size_t j = 0; j < 2 && close; ++j)
+            {
+                double a = j == 0 ? 2.0 / 3 : 1.0 / 3;
+                double ex = in_xs[k + j] - (a * xs[i] + (1 - a) * xs[i + 1]);
+                double ey = in_ys[k + j] - (a * ys[i] + (1 - a) * ys[i + 1]);
+
+                close = ex * ex + ey * ey <= tol2;
+            }
+
+            if (close)
+            {
+                next_flat.push_back(1); // chord is close enough, the inner points aren't needed
+            }
+            else
+            {
+                for (size_t j = 0; j < 2; ++j)
+                {
+                    next_flat.push_back(0);
+                    next_ts.push_back(in_ts[k + j]);
+                    next_xs.push_back(in_xs[k + j]);
+                    next_ys.push_back(in_ys[k + j]);
+                }
+
+                next_flat.push_back(0);
+            }
+
+            k += 2;
+        }
+
+        next_ts.push_back(ts.back());
+        next_xs.push_back(xs.back());
+        next_ys.push_back(ys.back());
+
+        std::swap(ts, next_ts);
+        std::swap(xs, next_xs);
+        std::swap(ys, next_ys);
+        std::swap(flat, next_flat);
+    }
+
+    std::vector<point<double>> points;
+    points.reserve(xs.size());
+
+    for (size_t i = 0; i < xs.size(); ++i)
+        points.push_back({xs[i], ys[i]});
+
+    return points;
+}
+
+// rasterizes a parametric curve by flattening it, then drawing each segment with draw_line(x1, y1, x2, y2)
+// returns the number of segments drawn
+template<typename F, typename L>
+size_t draw_curve(const F &curve, double t0, double t1, L draw_line, double tolerance = 0.5)
+{
+    auto points = flatten(curve, t0, t1, tolerance);
+
+    for (size_t i = 1; i < points.size(); ++i)
+    {
+        draw_line(static_cast<int>(std::lround(points[i - 1].first)), static_cast<int>(std::lround(points[i - 1].second)),
+                  static_cast<int>(std::lround(points[i].first)), static_cast<int>(std::lround(points[i].second)));
+    }
+
+    return points.size() - 1;
+}
+
+#endif
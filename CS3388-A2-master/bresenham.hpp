@@ -58,9 +58,11 @@ vpoints<int> Bresenham(int x1, int y1, int x2, int y2)
 }
 
 // draw a line from p1 to p2 on an sfml image using Bresenham(int, int, int, int)
-void Bresenham(sf::Image &image, int x1, int y1, int x2, int y2)
+// returns the number of pixels that landed on the image
+size_t Bresenham(sf::Image &image, int x1, int y1, int x2, int y2)
 {
 	auto points = Bresenham(x1, y1, x2, y2);
+	size_t drawn = 0;
 	
 	for (auto &point : points)
 	{
@@ -72,7 +74,10 @@ void Bresenham(sf::Image &image, int x1, int y1, int x2, int y2)
 		if (point.second < 0 || static_cast<size_t>(point.second) >= height) continue;
 		
 		image.setPixel(point.first, point.second, sf::Color::Black);
+		++drawn;
 	}
+
+	return drawn;
 }
 
 #endif
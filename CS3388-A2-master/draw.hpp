@@ -0,0 +1,59 @@
+#ifndef DRAW_HPP
+#define DRAW_HPP
+
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "bresenham.hpp"
+#include "geom.hpp"
+#include "matrix.hpp"
+#include "../common/profiler.hpp"
+
+// draws a scene, applies perspective division right before drawing
+draw_counts draw_scene(const std::vector<std::vector<vec4d>> &objects, sf::Image &image)
+{
+	draw_counts counts;
+
+	for (auto &lines : objects)
+	{
+		for (size_t i = 1; i < lines.size(); i += 2)
+		{
+			auto start = normalize_w(lines[i - 1]);
+			auto end = normalize_w(lines[i]);
+			
+			counts.pixels += Bresenham(image, start.at(0, 0), start.at(1, 0), end.at(0, 0), end.at(1, 0));
+			counts.lines += 1;
+		}
+	}
+
+	return counts;
+}
+
+// draws a scene whose points are already divided by w, see normalize_w(), for callers that time the division apart
+draw_counts draw_divided(const std::vector<std::vector<vec4d>> &objects, sf::Image &image)
+{
+	draw_counts counts;
+
+	for (auto &lines : objects)
+	{
+		for (size_t i = 1; i < lines.size(); i += 2)
+		{
+			counts.pixels += Bresenham(image, lines[i - 1].at(0, 0), lines[i - 1].at(1, 0), lines[i].at(0, 0), lines[i].at(1, 0));
+			counts.lines += 1;
+		}
+	}
+
+	return counts;
+}
+
+// spins the scene to angle, then draws it
+void draw_frame(const std::vector<std::vector<vec4d>> &scene, const mat4d &view, const mat4d &screen, double angle, sf::Image &image)
+{
+	std::vector<std::vector<vec4d>> transformed;
+	for (auto &obj : scene)
+		transformed.push_back(screen * view * roty(angle) * obj);
+	draw_scene(transformed, image);
+}
+
+#endif
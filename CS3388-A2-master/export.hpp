@@ -0,0 +1,200 @@
+#ifndef EXPORT_HPP
+#define EXPORT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+// hands rendered frames to a single consumer strictly in order
+// frames are rendered in place into one of capacity slots, so no more than capacity frames
+// are ever alive at once, no matter how many are exported
+class reorder_queue
+{
+	std::mutex lock;
+	std::condition_variable changed;
+	std::vector<sf::Image> slots;
+	std::vector<char> ready;
+	size_t next = 0; // next frame the consumer is waiting on
+
+public:
+	reorder_queue(size_t capacity);
+
+	// blocks until frame index fits in the window [next, next + capacity), returns its slot to render into
+	sf::Image &acquire(size_t index);
+
+	// marks frame index as rendered
+	void publish(size_t index);
+
+	// blocks until the next frame in order is rendered, hands it to sink, then frees its slot
+	template<typename F>
+	void consume(F sink);
+};
+
+inline reorder_queue::reorder_queue(size_t capacity) :
+	slots(std::max<size_t>(capacity, 1)),
+	ready(slots.size(), 0)
+{}
+
+inline sf::Image &reorder_queue::acquire(size_t index)
+{
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, [&] { return index < next + slots.size(); });
+
+	return slots[index % slots.size()];
+}
+
+inline void reorder_queue::publish(size_t index)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		ready[index % slots.size()] = 1;
+	}
+
+	changed.notify_all();
+}
+
+template<typename F>
+void reorder_queue::consume(F sink)
+{
+	size_t slot;
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		slot = next % slots.size();
+		changed.wait(guard, [&] { return ready[slot] != 0; });
+	}
+
+	// no worker can touch this slot until next moves past it, so it's safe to read unlocked
+	sink(next, slots[slot]);
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		ready[slot] = 0;
+		++next;
+	}
+
+	changed.notify_all();
+}
+
+// renders frames [0, frames) on threads workers, passes them to sink(index, image) in order on the calling thread
+// render(index, image) has to be safe to call concurrently for different frames
+template<typename R, typename S>
+void export_frames(size_t frames, R render, S sink, size_t threads = std::thread::hardware_concurrency())
+{
+	threads = std::max<size_t>(threads, 1);
+
+	reorder_queue queue(2 * threads); // a little slack so a slow frame doesn't stall every worker
+	std::atomic<size_t> counter{0};
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < threads; ++i)
+	{
+		workers.emplace_back([&]
+		{
+			for (size_t frame = counter++; frame < frames; frame = counter++)
+			{
+				auto &image = queue.acquire(frame);
+				render(frame, image);
+				queue.publish(frame);
+			}
+		});
+	}
+
+	for (size_t i = 0; i < frames; ++i)
+		queue.consume(sink);
+
+	for (auto &worker : workers)
+		worker.join();
+}
+
+// writes frames to a raw YUV4MPEG2 video, 4:2:0 full range chroma
+// frames are expected top row first, alpha is ignored
+class y4m_writer
+{
+	std::ofstream out;
+	unsigned width, height;
+	std::vector<uint8_t> plane_y, plane_u, plane_v;
+	std::vector<int> acc_u, acc_v, counts; // chroma is averaged over 2x2 blocks, accumulated in ints first
+
+public:
+	y4m_writer(const std::string &path, unsigned width, unsigned height, unsigned fps = 30);
+
+	bool good() const;
+
+	void write(const sf::Image &frame);
+};
+
+inline y4m_writer::y4m_writer(const std::string &path, unsigned width, unsigned height, unsigned fps) :
+	out(path, std::ios::binary),
+	width(width),
+	height(height),
+	plane_y(width * height),
+	plane_u(((width + 1) / 2) * ((height + 1) / 2)),
+	plane_v(plane_u.size()),
+	acc_u(plane_u.size()),
+	acc_v(plane_u.size()),
+	counts(plane_u.size())
+{
+	out << "YUV4MPEG2 W" << width << " H" << height << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+}
+
+inline bool y4m_writer::good() const
+{
+	return out.good();
+}
+
+inline void y4m_writer::write(const sf::Image &frame)
+{
+	const uint8_t *px = frame.getPixelsPtr();
+	const unsigned cw = (width + 1) / 2;
+
+	std::fill(acc_u.begin(), acc_u.end(), 0);
+	std::fill(acc_v.begin(), acc_v.end(), 0);
+	std::fill(counts.begin(), counts.end(), 0);
+
+	for (unsigned y = 0; y < height; ++y)
+	{
+		for (unsigned x = 0; x < width; ++x)
+		{
+			const uint8_t *p = px + 4 * (static_cast<size_t>(y) * width + x);
+			double r = p[0], g = p[1], b = p[2];
+
+			plane_y[y * width + x] = static_cast<uint8_t>(std::clamp(0.299 * r + 0.587 * g + 0.114 * b + 0.5, 0.0, 255.0));
+
+			size_t c = (y / 2) * cw + x / 2;
+			acc_u[c] += static_cast<int>(128.5 - 0.168736 * r - 0.331264 * g + 0.5 * b);
+			acc_v[c] += static_cast<int>(128.5 + 0.5 * r - 0.418688 * g - 0.081312 * b);
+			counts[c] += 1;
+		}
+	}
+
+	for (size_t c = 0; c < plane_u.size(); ++c)
+	{
+		plane_u[c] = static_cast<uint8_t>(std::clamp(acc_u[c] / counts[c], 0, 255));
+		plane_v[c] = static_cast<uint8_t>(std::clamp(acc_v[c] / counts[c], 0, 255));
+	}
+
+	out << "FRAME\n";
+	out.write(reinterpret_cast<const char *>(plane_y.data()), plane_y.size());
+	out.write(reinterpret_cast<const char *>(plane_u.data()), plane_u.size());
+	out.write(reinterpret_cast<const char *>(plane_v.data()), plane_v.size());
+}
+
+// file name of a frame in a numbered image sequence, e.g. prefix_0042.png
+inline std::string sequence_name(const std::string &prefix, size_t index, const std::string &ext = ".png")
+{
+	char number[32];
+	std::snprintf(number, sizeof(number), "_%04zu", index);
+
+	return prefix + number + ext;
+}
+
+#endif
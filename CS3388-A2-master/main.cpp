@@ -10,11 +10,16 @@
 #include <vector>
 #include <tuple>
 #include <chrono>
+#include <stdexcept>
+#include <string>
 
 #include <SFML/Graphics.hpp>
 
 #include "bresenham.hpp"
+#include "draw.hpp"
 #include "matrix.hpp"
+#include "export.hpp"
+#include "../common/profiler.hpp"
 
 void draw_test_frag(sf::Image &image);
 
@@ -22,13 +27,20 @@ void draw_test_frag(sf::Image &image);
 template<typename T, size_t M, size_t N>
 std::ostream &operator<<(std::ostream &os, const matrix<T, M, N> &m);
 
-// draws a scene, applies perspective division right before drawing
-void draw_scene(const std::vector<std::vector<vec4d>> &objects, sf::Image &image);
+// renders frames at a fixed angular step on every core, streams them in order to a .y4m video,
+// or to a numbered .png sequence named after path otherwise
+int export_animation(const std::vector<std::vector<vec4d>> &scene, const mat4d &view, const mat4d &screen,
+	size_t width, size_t height, const std::string &path, size_t frames, double step);
 
-int main()
+// stages of a live frame, for the profiler
+enum stage : size_t { transform, divide, rasterize, upload, present };
+
+// usage: A2 [--export <out.y4m | frame prefix> <frames> [radians per frame]] [--profile <frames.csv>]
+// without --export the scene spins live in a window, P toggles the frame stats overlay
+// with --profile the timings of the last frames are written out on exit
+int main(int argc, char **argv)
 {
 	const size_t window_width = 1000, window_height = 600;
-	sf::RenderWindow window(sf::VideoMode(window_width, window_height), "It's a ball, no, it's a torus!");
 
 	std::vector<std::vector<vec4d>> scene{
 		translate(0.0, 0.0, 200.0) * make_torus(160, 60, 48, 32), // make a torus, place it in (0, 0, 200)
@@ -36,6 +48,48 @@ int main()
 		translate(-200.0, 0.0, -200.0) * make_cone(200, 400, 32) // make a cone
 	};
 
+	auto view = rotx(M_PI / 4) * translate(0.0, 0.0, 0.0) * scale(0.75);
+	auto screen = translate(window_width / 2.0, window_height / 2.0, 0.0);
+
+	if (argc >= 4 && std::string(argv[1]) == "--export")
+	{
+		// stoul takes "-1" as the largest size_t, so a sign is turned away before it gets there, and so is anything after
+		// the digits
+		size_t frames = 0, used = 0;
+		double step = 0;
+		try
+		{
+			frames = argv[3][0] == '-' ? 0 : std::stoul(argv[3], &used);
+			if (argv[3][used] != '\0')
+				frames = 0;
+
+			if (argc >= 5)
+				step = std::stod(argv[4]);
+		}
+		catch (const std::exception &)
+		{
+			frames = 0;
+		}
+
+		if (frames < 1)
+		{
+			std::cerr << "usage: A2 --export <out.y4m | frame prefix> <frames, at least 1> [radians per frame]" << std::endl;
+			return 1;
+		}
+
+		if (argc < 5)
+			step = 2 * M_PI / frames; // one full turn by default, loops seamlessly
+
+		return export_animation(scene, view, screen, window_width, window_height, argv[2], frames, step);
+	}
+
+	std::string csv_path;
+	for (int i = 1; i + 1 < argc; ++i)
+		if (std::string(argv[i]) == "--profile")
+			csv_path = argv[i + 1];
+
+	sf::RenderWindow window(sf::VideoMode(window_width, window_height), "It's a ball, no, it's a torus!");
+
 	sf::Transform flip_y; // origin is upper left by default, y+ down. flipping to y+ up
 	flip_y.scale(1, -1); // flip y axis
 	flip_y.translate(0, -static_cast<float>(window_height)); // shift down 1 sq, origin is now bottom left
@@ -44,8 +98,9 @@ int main()
 	sf::Texture texture; // need a texture to make a sprite
 	sf::Sprite sprite; // SFML can draw sprites
 
-	auto view = rotx(M_PI / 4) * translate(0.0, 0.0, 0.0) * scale(0.75);
-	auto screen = translate(window_width / 2.0, window_height / 2.0, 0.0);
+	profiler prof({ "transform", "divide", "rasterize", "upload", "present" });
+	stats_overlay overlay;
+	bool show_stats = false;
 
 	auto prog_start = std::chrono::high_resolution_clock::now();
 
@@ -59,27 +114,55 @@ int main()
 			   (event.type == sf::Event::KeyPressed &&
 				event.key.code == sf::Keyboard::Q))
 				window.close();
+
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+				show_stats = !show_stats;
 		}
 
-		// auto draw_start = std::chrono::high_resolution_clock::now(); // benchmarking, I'm curious how -mavx changes things
-		window.clear(sf::Color::White);
-		image.create(window_width, window_height, sf::Color(0, 0, 0, 0)); // init to 100% transparent
+		prof.begin_frame();
 
 		auto current_time = std::chrono::high_resolution_clock::now();
 		double angle = 0.5 * std::chrono::duration_cast<std::chrono::duration<double>>(current_time - prog_start).count();
 
 		std::vector<std::vector<vec4d>> transformed;
-		for (auto &obj : scene)
-			transformed.push_back(screen * view * roty(angle) * obj);
-		draw_scene(transformed, image);
-
-		texture.loadFromImage(image); // convert to texture
-		sprite.setTexture(texture); // convert to sprite
-		window.draw(sprite, flip_y);
-		window.display();
-		// auto draw_end = std::chrono::high_resolution_clock::now();
-		// std::cout << std::chrono::duration_cast<std::chrono::microseconds>(draw_end - draw_start).count() << std::endl;
+		{
+			auto timer = prof.time(transform);
+			for (auto &obj : scene)
+				transformed.push_back(screen * view * roty(angle) * obj);
+		}
+
+		{
+			auto timer = prof.time(divide);
+			for (auto &obj : transformed)
+				obj = normalize_w(obj);
+		}
+
+		{
+			auto timer = prof.time(rasterize);
+			image.create(window_width, window_height, sf::Color(0, 0, 0, 0)); // init to 100% transparent
+			prof.count(draw_divided(transformed, image)); // divided already, draw_scene() would do it again
+		}
+
+		{
+			auto timer = prof.time(upload);
+			texture.loadFromImage(image); // convert to texture
+			sprite.setTexture(texture); // convert to sprite
+		}
+
+		{
+			auto timer = prof.time(present);
+			window.clear(sf::Color::White);
+			window.draw(sprite, flip_y);
+			if (show_stats)
+				overlay.draw(window, prof);
+			window.display();
+		}
+
+		prof.end_frame();
 	}
+
+	if (!csv_path.empty() && !prof.dump_csv(csv_path))
+		std::cerr << "can't write " << csv_path << std::endl;
 	
 	return 0;
 }
@@ -117,16 +200,37 @@ std::ostream &operator<<(std::ostream &os, const matrix<T, M, N> &m)
 	return os;
 }
 
-void draw_scene(const std::vector<std::vector<vec4d>> &objects, sf::Image &image)
+int export_animation(const std::vector<std::vector<vec4d>> &scene, const mat4d &view, const mat4d &screen,
+	size_t width, size_t height, const std::string &path, size_t frames, double step)
 {
-	for (auto &lines : objects)
+	auto render = [&](size_t frame, sf::Image &image)
+	{
+		image.create(width, height, sf::Color::White); // no window behind it, so draw on white directly
+		draw_frame(scene, view, screen, frame * step, image);
+		image.flipVertically(); // y+ up, like the window
+	};
+
+	bool video = path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+
+	if (video)
 	{
-		for (size_t i = 1; i < lines.size(); i += 2)
+		y4m_writer writer(path, width, height);
+		if (!writer.good())
 		{
-			auto start = normalize_w(lines[i - 1]);
-			auto end = normalize_w(lines[i]);
-			
-			Bresenham(image, start.at(0, 0), start.at(1, 0), end.at(0, 0), end.at(1, 0));
+			std::cerr << "can't open " << path << std::endl;
+			return 1;
 		}
+
+		export_frames(frames, render, [&](size_t, const sf::Image &image) { writer.write(image); });
+
+		return writer.good() ? 0 : 1;
 	}
+
+	bool ok = true;
+	export_frames(frames, render, [&](size_t frame, const sf::Image &image)
+	{
+		ok = image.saveToFile(sequence_name(path, frame)) && ok;
+	});
+
+	return ok ? 0 : 1;
 }
@@ -1,6 +1,8 @@
 #ifndef VECTOR_HPP
 #define VECTOR_HPP
 
+#include <vector>
+
 #include "matrix.hpp"
 
 template<typename T, size_t N>
@@ -33,4 +35,17 @@ vec4<T> normalize_w(const vec4<T> &v)
 	return v / w;
 }
 
+// perspective div on a batch of vectors
+template<typename T>
+std::vector<vec4<T>> normalize_w(const std::vector<vec4<T>> &obj)
+{
+	std::vector<vec4<T>> normed;
+	normed.reserve(obj.size());
+
+	for (auto &pt : obj)
+		normed.push_back(normalize_w(pt));
+
+	return normed;
+}
+
 #endif
@@ -9,6 +9,7 @@
 #include <vector>
 #include <tuple>
 #include <chrono>
+#include <string>
 #include <utility>
 
 #include <SFML/Graphics.hpp>
@@ -16,6 +17,9 @@
 #include "bresenham.hpp"
 #include "matrix.hpp"
 #include "light.hpp"
+#include "../common/profiler.hpp"
+#include "raster.hpp"
+#include "../common/trace.hpp"
 
 // prints out a matrix/vector, helps with debugging
 template<typename T, size_t M, size_t N>
@@ -24,32 +28,30 @@ std::ostream &operator<<(std::ostream &os, const matrix<T, M, N> &m);
 // draws a scene, applies perspective division right before drawing
 void draw_scene(const std::vector<std::vector<vec4d>> &objects, sf::Image &image);
 
-// makes edges (pairs of points) from a triangle
-std::vector<std::pair<vec4d, vec4d>> edges_of(const std::vector<vec4d> &t);
-
-// removes horizontal edges so that scanline fill doesn't intersect
-std::vector<std::pair<vec4d, vec4d>> remove_horizontal_edges(const std::vector<std::pair<vec4d, vec4d>> &edges);
-
-// find vertical range of a triangle, or the number of scanlines required to fill the triangle
-std::pair<int, int> find_range(const std::vector<vec4d> &t);
-
-// finds intersections between the edges at a scanline y
-std::vector<int> find_intersections(const std::vector<std::pair<vec4d, vec4d>> &edges, int y);
-
-// trims a value between a max and a min
-double clamp(double v, double max, double min);
-
-// computes the color for each triangle of a mesh
-void compute_color(std::vector<mesh> &meshes, const light &light, const vec4d &eye);
-
-// fills the triangles of a mesh with scanline algorithm
-void fill_triangles(const std::vector<mesh> &meshes, sf::Image &image);
+// stages of a frame, for the profiler
+enum stage : size_t { transform, divide, shade, rasterize, upload, present };
 
 // shading is kind of a mix between flat and Phong
 // no interpolation, but diffuse, ambient, and specular lighting is implemented
 // When the faces are smaller than a pixel, it basically becomes Phong
-int main()
+// usage: A3 [--profile <frames.csv>] [--trace <trace.json>], P toggles the frame stats overlay
+// the frame is drawn again every time through the loop, so the stats and --profile cover every frame shown
+// --trace needs a build with ENABLE_TRACING defined
+int main(int argc, char **argv)
 {
+	std::string csv_path, trace_path;
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--profile")
+			csv_path = argv[i + 1];
+		else if (std::string(argv[i]) == "--trace")
+			trace_path = argv[i + 1];
+	}
+
+#if defined(ENABLE_TRACING)
+	trace_start("a3");
+#endif
+
 	const size_t window_width = 1000, window_height = 600;
 	sf::RenderWindow window(sf::VideoMode(window_width, window_height), "It's not a torus, it's actually a ball!");
 
@@ -58,7 +60,6 @@ int main()
 	flip_y.translate(0, -static_cast<float>(window_height)); // shift down 1 sq, origin is now bottom left
 
 	sf::Image image; // colleciton of pixels. cannot be drawn directly by SFML
-	image.create(window_width, window_height, sf::Color(0, 0, 0, 0)); // init to 100% transparent
 
 	sf::Texture texture; // need a texture to make a sprite
 	sf::Sprite sprite; // SFML can draw sprites
@@ -79,31 +80,81 @@ int main()
 
 	light bulb{ {{0, 400, 400, 1.0}}, 1 };
 
+	profiler prof({ "transform", "divide", "shade", "rasterize", "upload", "present" });
+	stats_overlay overlay;
+	bool show_stats = false;
+
 	mesh sphere = make_sphere_mesh(200, 1000, 1000);
 	sphere.color = vec4d{{255, 127, 0.0, 255.0}};
 
-	for (auto &tri : sphere.faces) // transform the sphere
-		tri.points = normalize_w(screen * view * translate(-300.0, 0.0, 0.0) * tri.points);
-	
 	mesh cone = make_cone_mesh(150, 250, 800, 1);
 	cone.color = vec4d{{0.0, 127, 0.0, 255}};
 
-	for (auto &tri : cone.faces) // transform the cone
-		tri.points = normalize_w(screen * view * translate(100.0, 0.0, 0.0) * tri.points);
+	// the meshes as made, each frame transforms a fresh copy, with where each goes in the scene
+	const std::vector<mesh> models = { cone, sphere };
+	const std::vector<mat4d> placements = { translate(100.0, 0.0, 0.0), translate(-300.0, 0.0, 0.0) };
 
-	std::vector<mesh> meshes;
-	meshes.push_back(cone);
-	meshes.push_back(sphere);
+	// the scene is static, but every frame is drawn from scratch, so the profiler has a sample of each stage a frame
+	auto draw_frame = [&]()
+	{
+		std::vector<mesh> meshes = models;
+
+		prof.begin_frame();
+
+		{
+			auto timer = prof.time(transform);
+			TRACE_ZONE("transform");
+
+			for (size_t i = 0; i < meshes.size(); ++i)
+			{
+				auto to_screen = screen * view * placements[i];
 
-	compute_color(meshes, bulb, vec4d{{eyex, eyey, eyez, 1.0}});
-	fill_triangles(meshes, image);
+				for (auto &tri : meshes[i].faces)
+					tri.points = to_screen * tri.points;
+			}
+		}
 
-	window.clear(sf::Color::White);
+		{
+			auto timer = prof.time(divide);
+			TRACE_ZONE("divide");
 
-	texture.loadFromImage(image); // convert to texture
-	sprite.setTexture(texture); // convert to sprite
-	window.draw(sprite, flip_y);
-	window.display();
+			for (auto &m : meshes)
+				for (auto &tri : m.faces)
+					tri.points = normalize_w(tri.points);
+		}
+
+		{
+			auto timer = prof.time(shade);
+			TRACE_ZONE("shade");
+			compute_color(meshes, bulb, vec4d{{eyex, eyey, eyez, 1.0}});
+		}
+
+		{
+			auto timer = prof.time(rasterize);
+			TRACE_ZONE("rasterize");
+			image.create(window_width, window_height, sf::Color(0, 0, 0, 0)); // init to 100% transparent
+			prof.count(fill_triangles(meshes, image));
+		}
+
+		{
+			auto timer = prof.time(upload);
+			TRACE_ZONE("upload");
+			texture.loadFromImage(image); // convert to texture
+			sprite.setTexture(texture); // convert to sprite
+		}
+
+		{
+			auto timer = prof.time(present);
+			TRACE_ZONE("present");
+			window.clear(sf::Color::White);
+			window.draw(sprite, flip_y);
+			if (show_stats)
+				overlay.draw(window, prof);
+			window.display();
+		}
+
+		prof.end_frame();
+	};
 
 	while (window.isOpen()) // poll for input while window is open
 	{
@@ -115,8 +166,25 @@ int main()
 			   (event.type == sf::Event::KeyPressed &&
 				event.key.code == sf::Keyboard::Q))
 				window.close();
+
+			if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+				show_stats = !show_stats;
 		}
+
+		if (window.isOpen())
+			draw_frame();
 	}
+
+	if (!csv_path.empty() && !prof.dump_csv(csv_path))
+		std::cerr << "can't write " << csv_path << std::endl;
+
+#if defined(ENABLE_TRACING)
+	if (!trace_path.empty() && !write_trace(trace_path))
+		std::cerr << "can't write " << trace_path << std::endl;
+#else
+	if (!trace_path.empty())
+		std::cerr << "tracing is compiled out, rebuild with ENABLE_TRACING defined" << std::endl;
+#endif
 	
 	return 0;
 }
@@ -153,136 +221,3 @@ void draw_scene(const std::vector<std::vector<vec4d>> &objects, sf::Image &image
 		}
 	}
 }
-
-std::vector<std::pair<vec4d, vec4d>> edges_of(const std::vector<vec4d> &t)
-{
-	std::vector<std::pair<vec4d, vec4d>> edges;
-
-	return {{
-		{t[0], t[1]},
-		{t[1], t[2]},
-		{t[2], t[0]},
-	}};
-}
-
-std::vector<std::pair<vec4d, vec4d>> remove_horizontal_edges(const std::vector<std::pair<vec4d, vec4d>> &edges)
-{
-	std::vector<std::pair<vec4d, vec4d>> filtered;
-
-	for (const auto &edge : edges)
-	{
-		auto dy = edge.second.at(1, 0) - edge.first.at(1, 0);
-
-		if (dy == 0)
-			continue;
-
-		filtered.push_back(edge);
-	}
-
-	return filtered;
-}
-
-std::pair<int, int> find_range(const std::vector<vec4d> &t)
-{
-	return {
-		std::round(std::max(std::max(t[0].at(1, 0), t[1].at(1, 0)), t[2].at(1, 0))),
-		std::round(std::min(std::min(t[0].at(1, 0), t[1].at(1, 0)), t[2].at(1, 0)))
-	};
-}
-
-std::vector<int> find_intersections(const std::vector<std::pair<vec4d, vec4d>> &edges, int y)
-{
-	std::vector<int> xs;
-	
-	for (const auto &edge : edges)
-	{
-		double y2 = edge.second.at(1, 0);
-		double y1 = edge.first.at(1, 0);
-
-		double dy = y2 - y1;
-		
-		double x2 = edge.second.at(0, 0);
-		double x1 = edge.first.at(0, 0);
-
-		double dx = x2 - x1;
-
-		double t = (y - y1) / dy;
-
-		double x = x1 + t * dx;
-
-		if (1 >= t && t >= 0)
-			xs.push_back(std::round(x));
-	}
-
-	return xs;
-}
-
-double clamp(double v, double max, double min)
-{
-	return std::max(std::min(v, max), min);
-}
-
-void compute_color(std::vector<mesh> &meshes, const light &light, const vec4d &eye)
-{
-	for (auto &mesh : meshes)
-	{
-		for (auto &face : mesh.faces)
-		{
-			double ambient = light.intensity;
-			// ambient = 0;
-			
-			vec3d n = cart(face.normal());
-
-			vec3d s = cart(light.position) - cart(face.center());
-			double diffuse = light.intensity * std::max(0.0, dot(norm(s), n));
-			// diffuse = 0;
-
-			vec3d rvec = -s + n * 2 * (dot(s, n) / dot(n, n));
-			vec3d v = -cart(eye) + cart(face.center());
-			double specular = light.intensity * std::pow(std::max(0.0, dot(rvec, v) / (magnitude(rvec) * magnitude(v))), 50);
-
-			double r = (diffuse + ambient + specular) * mesh.color.at(0, 0);
-			double g = (diffuse + ambient + specular) * mesh.color.at(1, 0);
-			double b = (diffuse + ambient + specular) * mesh.color.at(2, 0);
-
-			face.color = vec4d{{r, g, b, 1.0}};
-		}
-	}
-}
-
-void fill_triangles(const std::vector<mesh> &meshes, sf::Image &image)
-{
-	for (const auto &mesh : meshes)
-	{
-		for (const auto &t : mesh.faces)
-		{
-			if (t.normal().at(2, 0) < 0)
-				continue;
-				
-			auto edges = remove_horizontal_edges(edges_of(t.points));
-			auto range = find_range(t.points);
-
-			// std::cout << range.first << ", " << range.second << std::endl;
-			for (int y = range.first; y >= range.second; --y)
-			{
-				auto intersections = find_intersections(edges, y);
-
-				if (intersections.size() == 0)
-					continue;
-				
-				auto start = std::min(intersections[0], intersections[1]);
-				auto end = std::max(intersections[0], intersections[1]);
-				
-				// TODO check bounds
-				for (int x = start; x <= end; ++x)
-				{
-					uint8_t r = std::round(clamp(t.color.at(0, 0), 255, 0));
-					uint8_t g = std::round(clamp(t.color.at(1, 0), 255, 0));
-					uint8_t b = std::round(clamp(t.color.at(2, 0), 255, 0));
-
-					image.setPixel(x, y, sf::Color{r, g, b, 255});
-				}
-			}
-		}
-	}
-}
@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "raster.hpp"
+#include "../common/trace.hpp"
+
+std::vector<std::pair<vec4d, vec4d>> edges_of(const std::vector<vec4d> &t)
+{
+	std::vector<std::pair<vec4d, vec4d>> edges;
+
+	return {{
+		{t[0], t[1]},
+		{t[1], t[2]},
+		{t[2], t[0]},
+	}};
+}
+
+std::vector<std::pair<vec4d, vec4d>> remove_horizontal_edges(const std::vector<std::pair<vec4d, vec4d>> &edges)
+{
+	std::vector<std::pair<vec4d, vec4d>> filtered;
+
+	for (const auto &edge : edges)
+	{
+		auto dy = edge.second.at(1, 0) - edge.first.at(1, 0);
+
+		if (dy == 0)
+			continue;
+
+		filtered.push_back(edge);
+	}
+
+	return filtered;
+}
+
+std::pair<int, int> find_range(const std::vector<vec4d> &t)
+{
+	return {
+		std::round(std::max(std::max(t[0].at(1, 0), t[1].at(1, 0)), t[2].at(1, 0))),
+		std::round(std::min(std::min(t[0].at(1, 0), t[1].at(1, 0)), t[2].at(1, 0)))
+	};
+}
+
+std::vector<int> find_intersections(const std::vector<std::pair<vec4d, vec4d>> &edges, int y)
+{
+	std::vector<int> xs;
+	
+	for (const auto &edge : edges)
+	{
+		double y2 = edge.second.at(1, 0);
+		double y1 = edge.first.at(1, 0);
+
+		double dy = y2 - y1;
+		
+		double x2 = edge.second.at(0, 0);
+		double x1 = edge.first.at(0, 0);
+
+		double dx = x2 - x1;
+
+		double t = (y - y1) / dy;
+
+		double x = x1 + t * dx;
+
+		if (1 >= t && t >= 0)
+			xs.push_back(std::round(x));
+	}
+
+	return xs;
+}
+
+double clamp(double v, double max, double min)
+{
+	return std::max(std::min(v, max), min);
+}
+
+void compute_color(std::vector<mesh> &meshes, const light &light, const vec4d &eye)
+{
+	for (size_t id = 0; id < meshes.size(); ++id)
+	{
+		auto &mesh = meshes[id];
+		TRACE_OBJECT_ZONE("shade mesh", id);
+
+		for (auto &face : mesh.faces)
+		{
+			double ambient = light.intensity;
+			// ambient = 0;
+			
+			vec3d n = cart(face.normal());
+
+			vec3d s = cart(light.position) - cart(face.center());
+			double diffuse = light.intensity * std::max(0.0, dot(norm(s), n));
+			// diffuse = 0;
+
+			vec3d rvec = -s + n * 2 * (dot(s, n) / dot(n, n));
+			vec3d v = -cart(eye) + cart(face.center());
+			double specular = light.intensity * std::pow(std::max(0.0, dot(rvec, v) / (magnitude(rvec) * magnitude(v))), 50);
+
+			double r = (diffuse + ambient + specular) * mesh.color.at(0, 0);
+			double g = (diffuse + ambient + specular) * mesh.color.at(1, 0);
+			double b = (diffuse + ambient + specular) * mesh.color.at(2, 0);
+
+			face.color = vec4d{{r, g, b, 1.0}};
+		}
+	}
+}
+
+draw_counts fill_triangles(const std::vector<mesh> &meshes, sf::Image &image)
+{
+	draw_counts counts;
+
+	const int width = static_cast<int>(image.getSize().x), height = static_cast<int>(image.getSize().y);
+
+	for (size_t id = 0; id < meshes.size(); ++id)
+	{
+		const auto &mesh = meshes[id];
+		TRACE_OBJECT_ZONE("fill mesh", id);
+
+		for (const auto &t : mesh.faces)
+		{
+			if (t.normal().at(2, 0) < 0)
+				continue;
+
+			counts.triangles += 1;
+				
+			auto edges = remove_horizontal_edges(edges_of(t.points));
+			auto range = find_range(t.points);
+
+			// rows and columns off the image are skipped, setPixel() doesn't check
+			for (int y = std::min(range.first, height - 1); y >= std::max(range.second, 0); --y)
+			{
+				auto intersections = find_intersections(edges, y);
+
+				if (intersections.size() == 0)
+					continue;
+				
+				auto start = std::max(std::min(intersections[0], intersections[1]), 0);
+				auto end = std::min(std::max(intersections[0], intersections[1]), width - 1);
+				
+				for (int x = start; x <= end; ++x)
+				{
+					uint8_t r = std::round(clamp(t.color.at(0, 0), 255, 0));
+					uint8_t g = std::round(clamp(t.color.at(1, 0), 255, 0));
+					uint8_t b = std::round(clamp(t.color.at(2, 0), 255, 0));
+
+					image.setPixel(x, y, sf::Color{r, g, b, 255});
+					counts.pixels += 1;
+				}
+			}
+		}
+	}
+
+	return counts;
+}
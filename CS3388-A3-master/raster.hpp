@@ -0,0 +1,35 @@
+#ifndef RASTER_HPP
+#define RASTER_HPP
+
+#include <utility>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "light.hpp"
+#include "mesh.hpp"
+#include "../common/profiler.hpp"
+#include "vector.hpp"
+
+// makes edges (pairs of points) from a triangle
+std::vector<std::pair<vec4d, vec4d>> edges_of(const std::vector<vec4d> &t);
+
+// removes horizontal edges so that scanline fill doesn't intersect
+std::vector<std::pair<vec4d, vec4d>> remove_horizontal_edges(const std::vector<std::pair<vec4d, vec4d>> &edges);
+
+// find vertical range of a triangle, or the number of scanlines required to fill the triangle
+std::pair<int, int> find_range(const std::vector<vec4d> &t);
+
+// finds intersections between the edges at a scanline y
+std::vector<int> find_intersections(const std::vector<std::pair<vec4d, vec4d>> &edges, int y);
+
+// trims a value between a max and a min
+double clamp(double v, double max, double min);
+
+// computes the color for each triangle of a mesh
+void compute_color(std::vector<mesh> &meshes, const light &light, const vec4d &eye);
+
+// fills the triangles of a mesh with scanline algorithm
+draw_counts fill_triangles(const std::vector<mesh> &meshes, sf::Image &image);
+
+#endif
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <thread>
+
+#include "bvh.hpp"
+
+// most primitives a leaf gets when splitting it isn't cheaper, and fewest it's always split above
+const uint32_t max_leaf = 16;
+const uint32_t min_leaf = 4;
+
+// centroid bins the split is picked from
+const size_t bins = 16;
+
+// subtrees smaller than this aren't worth a thread of their own
+const uint32_t parallel_min = 1 << 14;
+
+static double area(const double *lo, const double *hi)
+{
+	double dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+	return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+static void grow(double *lo, double *hi, const double *box_lo, const double *box_hi)
+{
+	for (size_t k = 0; k < 3; ++k)
+	{
+		lo[k] = std::min(lo[k], box_lo[k]);
+		hi[k] = std::max(hi[k], box_hi[k]);
+	}
+}
+
+// builds a hierarchy over boxes, the primitives are sorted into order, leaves cover ranges of it
+// subtrees are split by the surface area heuristic over centroid bins
+class bvh_builder
+{
+public:
+	std::vector<uint32_t> order;
+
+	explicit bvh_builder(const std::vector<primitive_box> &boxes);
+
+	// nodes of the subtree over order[first, first + count), its rights count from its own first node
+	// the top split_levels levels build their second child on another thread
+	std::vector<bvh_node> build(uint32_t first, uint32_t count, size_t depth, size_t split_levels);
+
+private:
+	const std::vector<primitive_box> &boxes;
+
+	void build_into(std::vector<bvh_node> &nodes, uint32_t first, uint32_t count, size_t depth);
+
+	// fills in node and sorts its primitives for the split, returns where the second child starts, 0 when it's a leaf
+	uint32_t split(bvh_node &node, uint32_t first, uint32_t count, size_t depth);
+};
+
+bvh_builder::bvh_builder(const std::vector<primitive_box> &boxes) :
+	order(boxes.size()),
+	boxes(boxes)
+{
+	std::iota(order.begin(), order.end(), 0);
+}
+
+uint32_t bvh_builder::split(bvh_node &node, uint32_t first, uint32_t count, size_t depth)
+{
+	const double inf = std::numeric_limits<double>::infinity();
+
+	double center_lo[3] = { inf, inf, inf }, center_hi[3] = { -inf, -inf, -inf };
+	std::fill(node.lo, node.lo + 3, inf);
+	std::fill(node.hi, node.hi + 3, -inf);
+
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		auto &box = boxes[order[i]];
+
+		grow(node.lo, node.hi, box.lo, box.hi);
+		grow(center_lo, center_hi, box.center, box.center);
+	}
+
+	node.first = first;
+	node.count = count;
+	node.right = 0;
+	node.axis = 0;
+
+	if (count <= min_leaf || depth + 1 >= bvh_max_depth)
+		return 0;
+
+	uint32_t axis = 0;
+	for (uint32_t k = 1; k < 3; ++k)
+		if (center_hi[k] - center_lo[k] > center_hi[axis] - center_lo[axis])
+			axis = k;
+
+	double extent = center_hi[axis] - center_lo[axis];
+	uint32_t mid = 0;
+
+	if (extent > 0)
+	{
+		auto bin_of = [&](uint32_t t)
+		{
+			auto b = static_cast<size_t>((boxes[t].center[axis] - center_lo[axis]) / extent * bins);
+			return std::min(b, bins - 1);
+		};
+
+		uint32_t counts[bins] = {};
+		double lo[bins][3], hi[bins][3];
+		for (size_t b = 0; b < bins; ++b)
+		{
+			std::fill(lo[b], lo[b] + 3, inf);
+			std::fill(hi[b], hi[b] + 3, -inf);
+		}
+
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			auto t = order[i];
+			auto b = bin_of(t);
+
+			counts[b] += 1;
+			grow(lo[b], hi[b], boxes[t].lo, boxes[t].hi);
+		}
+
+		// cost of splitting after each bin, triangles times box area on either side
+		double right_cost[bins] = {};
+		double right_lo[3] = { inf, inf, inf }, right_hi[3] = { -inf, -inf, -inf };
+		uint32_t right_count = 0;
+
+		for (size_t b = bins - 1; b > 0; --b)
+		{
+			right_count += counts[b];
+			grow(right_lo, right_hi, lo[b], hi[b]);
+			right_cost[b - 1] = right_count ? right_count * area(right_lo, right_hi) : 0;
+		}
+
+		double left_lo[3] = { inf, inf, inf }, left_hi[3] = { -inf, -inf, -inf };
+		uint32_t left_count = 0;
+		double best_cost = inf;
+		size_t best = 0;
+
+		for (size_t b = 0; b + 1 < bins; ++b)
+		{
+			left_count += counts[b];
+			grow(left_lo, left_hi, lo[b], hi[b]);
+
+			if (left_count == 0 || left_count == count)
+				continue;
+
+			double cost = left_count * area(left_lo, left_hi) + right_cost[b];
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best = b;
+			}
+		}
+
+		// a small node is cheaper left whole than split badly
+		if (count <= max_leaf && best_cost >= count * area(node.lo, node.hi))
+			return 0;
+
+		if (best_cost < inf)
+		{
+			auto it = std::partition(order.begin() + first, order.begin() + first + count,
+				[&](uint32_t t) { return bin_of(t) <= best; });
+
+			mid = static_cast<uint32_t>(it - order.begin());
+		}
+	}
+
+	// every centroid in the one spot, or all in one bin, halve it
+	if (mid == 0)
+	{
+		mid = first + count / 2;
+
+		std::nth_element(order.begin() + first, order.begin() + mid, order.begin() + first + count,
+			[&](uint32_t s, uint32_t t) { return boxes[s].center[axis] < boxes[t].center[axis]; });
+	}
+
+	node.count = 0;
+	node.axis = axis;
+
+	return mid;
+}
+
+void bvh_builder::build_into(std::vector<bvh_node> &nodes, uint32_t first, uint32_t count, size_t depth)
+{
+	size_t index = nodes.size();
+	nodes.emplace_back();
+
+	uint32_t mid = split(nodes[index], first, count, depth);
+	if (!mid)
+		return;
+
+	build_into(nodes, first, mid - first, depth + 1);
+	nodes[index].right = static_cast<uint32_t>(nodes.size());
+	build_into(nodes, mid, first + count - mid, depth + 1);
+}
+
+// appends the nodes of a subtree, moving its rights to where it ends up
+static void append(std::vector<bvh_node> &nodes, const std::vector<bvh_node> &subtree)
+{
+	auto offset = static_cast<uint32_t>(nodes.size());
+
+	for (auto node : subtree)
+	{
+		if (node.count == 0)
+			node.right += offset;
+
+		nodes.push_back(node);
+	}
+}
+
+std::vector<bvh_node> bvh_builder::build(uint32_t first, uint32_t count, size_t depth, size_t split_levels)
+{
+	std::vector<bvh_node> nodes;
+
+	if (split_levels == 0 || count < parallel_min)
+	{
+		build_into(nodes, first, count, depth);
+		return nodes;
+	}
+
+	bvh_node node;
+	uint32_t mid = split(node, first, count, depth);
+	if (!mid)
+		return { node };
+
+	// the two halves sort disjoint ranges of order, so they don't get in each other's way
+	auto second = std::async(std::launch::async, [&]() { return build(mid, first + count - mid, depth + 1, split_levels - 1); });
+	auto left = build(first, mid - first, depth + 1, split_levels - 1);
+	auto right = second.get();
+
+	nodes.reserve(1 + left.size() + right.size());
+	nodes.push_back(node);
+	append(nodes, left);
+	nodes[0].right = static_cast<uint32_t>(nodes.size());
+	append(nodes, right);
+
+	return nodes;
+}
+
+std::vector<bvh_node> build_bvh(const std::vector<primitive_box> &boxes, std::vector<uint32_t> &order, size_t threads)
+{
+	order.clear();
+	if (boxes.empty())
+		return {};
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// a couple more levels than threads, so one slow half doesn't leave the rest waiting
+	size_t split_levels = 0;
+	while ((size_t(1) << split_levels) < threads)
+		++split_levels;
+	if (threads > 1)
+		split_levels += 2;
+
+	bvh_builder builder(boxes);
+	auto nodes = builder.build(0, static_cast<uint32_t>(boxes.size()), 0, split_levels);
+
+	order = std::move(builder.order);
+	return nodes;
+}
@@ -0,0 +1,97 @@
+#ifndef A4_BVH_HPP
+#define A4_BVH_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "mapped_array.hpp"
+
+// node of a bounding volume hierarchy, covers the primitives [first, first + count) when it's a leaf
+// the first child is the next node, the second is right, both are ordered along axis
+// 64 bytes, a cache line each
+struct bvh_node
+{
+	double lo[3], hi[3]; // bounds of the primitives under it
+	uint32_t first, count; // count is 0 for inner nodes
+	uint32_t right;
+	uint32_t axis;
+};
+
+// box and centroid of a primitive, what a hierarchy is built from
+struct primitive_box
+{
+	double lo[3], hi[3];
+	double center[3];
+};
+
+// deepest a hierarchy goes, which sizes the stack of traverse(), anything left over at this depth is a leaf
+const size_t bvh_max_depth = 64;
+
+// builds a hierarchy over boxes, the top levels are split between threads (one per core by default)
+// order gets the primitives in the order of the leaves, a leaf's first and count are into it
+std::vector<bvh_node> build_bvh(const std::vector<primitive_box> &boxes, std::vector<uint32_t> &order, size_t threads = 0);
+
+// whether the ray from o with 1 / its direction inv_d enters the node between 0 and t_max
+inline bool enters(const bvh_node &node, const double *o, const double *inv_d, double t_max)
+{
+	double t0 = 0, t1 = t_max;
+
+	for (size_t k = 0; k < 3; ++k)
+	{
+		double ta = (node.lo[k] - o[k]) * inv_d[k];
+		double tb = (node.hi[k] - o[k]) * inv_d[k];
+		if (ta > tb)
+			std::swap(ta, tb);
+
+		// written so a NaN, from a ray in the plane of a side, leaves the range as it was
+		t0 = ta > t0 ? ta : t0;
+		t1 = tb < t1 ? tb : t1;
+	}
+
+	return t0 <= t1;
+}
+
+// calls leaf(first, count) for every leaf the ray from o along d enters before t_max, nearer children first
+// leaf lowers t_max as it finds hits, which prunes the rest
+template<typename F>
+void traverse(const mapped_array<bvh_node> &nodes, const double *o, const double *d, double &t_max, F leaf)
+{
+	if (nodes.empty())
+		return;
+
+	const double inv_d[3] = { 1 / d[0], 1 / d[1], 1 / d[2] };
+
+	uint32_t stack[bvh_max_depth];
+	size_t top = 0;
+	uint32_t n = 0;
+
+	for (;;)
+	{
+		const auto &node = nodes[n];
+
+		if (enters(node, o, inv_d, t_max))
+		{
+			if (node.count == 0)
+			{
+				// the farther one is likely skipped once something is hit
+				uint32_t nearer = n + 1, farther = node.right;
+				if (d[node.axis] < 0)
+					std::swap(nearer, farther);
+
+				stack[top++] = farther;
+				n = nearer;
+				continue;
+			}
+
+			leaf(node.first, node.count);
+		}
+
+		if (top == 0)
+			break;
+
+		n = stack[--top];
+	}
+}
+
+#endif //A4_BVH_HPP
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+
+#include "camera.hpp"
+#include "matrix_utils.hpp"
+
+// pitch is kept this far from straight up or down, where up and the view direction would line up
+static const double max_pitch = 1.55;
+
+fly_camera::fly_camera(const vec3d &eye, const vec3d &gaze, const vec3d &up) :
+	position(eye),
+	world_up(norm(up))
+{
+	auto d = norm(gaze - eye);
+
+	pitch = std::asin(std::clamp(d.y(), -1.0, 1.0));
+	yaw = std::atan2(-d.x(), -d.z());
+}
+
+void fly_camera::move(double right, double up, double forward)
+{
+	auto f = this->forward();
+	auto r = norm(cross(f, world_up));
+
+	position = position + r * right + world_up * up + f * forward;
+	changes += 1;
+}
+
+void fly_camera::turn(double yaw, double pitch)
+{
+	this->yaw += yaw;
+	this->pitch = std::clamp(this->pitch + pitch, -max_pitch, max_pitch);
+	changes += 1;
+}
+
+const vec3d &fly_camera::eye() const
+{
+	return position;
+}
+
+vec3d fly_camera::gaze() const
+{
+	return position + forward();
+}
+
+const vec3d &fly_camera::up() const
+{
+	return world_up;
+}
+
+mat4d fly_camera::view() const
+{
+	return camera<double>(position, gaze(), world_up);
+}
+
+uint64_t fly_camera::version() const
+{
+	return changes;
+}
+
+vec3d fly_camera::forward() const
+{
+	// yaw 0 looks down -z, turning left goes towards -x
+	return vec3d{{
+		-std::cos(pitch) * std::sin(yaw),
+		std::sin(pitch),
+		-std::cos(pitch) * std::cos(yaw)
+	}};
+}
+
+resolution_scaler::resolution_scaler(double target_ms) :
+	target_ms(target_ms)
+{}
+
+void resolution_scaler::record(double frame_ms)
+{
+	double ideal = scale * std::sqrt(target_ms / std::max(frame_ms, 0.01));
+
+	// only go halfway, so one odd frame doesn't swing it back and forth
+	scale = std::clamp(scale + 0.5 * (ideal - scale), min_scale, 1.0);
+}
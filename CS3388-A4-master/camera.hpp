@@ -0,0 +1,55 @@
+#ifndef A4_CAMERA_HPP
+#define A4_CAMERA_HPP
+
+#include <cstdint>
+
+#include "matrix.hpp"
+#include "vector.hpp"
+
+// a camera that flies around, turning with yaw and pitch and moving along where it looks
+// version() changes whenever it moves or turns, so matrices built from it only need rebuilding when it does
+class fly_camera
+{
+public:
+	// starts at eye looking at gaze
+	fly_camera(const vec3d &eye, const vec3d &gaze, const vec3d &up);
+
+	// moves by right, up, and forward along the view, in world units
+	void move(double right, double up, double forward);
+
+	// turns by yaw (to the left) and pitch (up) in radians, pitch stops short of straight up or down
+	void turn(double yaw, double pitch);
+
+	const vec3d &eye() const;
+	vec3d gaze() const; // a point it looks at, for camera()
+	const vec3d &up() const;
+
+	// world to camera matrix
+	mat4d view() const;
+
+	uint64_t version() const;
+
+private:
+	vec3d position;
+	vec3d world_up;
+	double yaw, pitch;
+	uint64_t changes = 0;
+
+	vec3d forward() const;
+};
+
+// picks how much of the full resolution to render at, so frames take about target_ms
+// frame time goes with the pixel count, the square of the scale, so the scale follows the root of how far off a frame was
+struct resolution_scaler
+{
+	double target_ms;
+	double min_scale = 1.0 / 16;
+	double scale = 0.25; // a guess for the first frame
+
+	explicit resolution_scaler(double target_ms);
+
+	// feeds the time a frame took at the current scale
+	void record(double frame_ms);
+};
+
+#endif //A4_CAMERA_HPP
@@ -1,6 +1,8 @@
 #include <iostream>
 #include <cmath>
 #include <optional>
+#include <limits>
+#include <algorithm>
 
 #include "cone.hpp"
 #include "matrix_utils.hpp"
@@ -12,10 +14,9 @@ vec4d normal(const vec3d &v)
 	return roty(atan2(v.x(), v.z())) * vec4d{{ 0, 1, 1, 1 }};
 }
 
-std::optional<hit> cone::intersect(const vec4d &ray_start, const vec4d &ray_end)
+std::optional<hit> cone::intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double)
 {
 	// warp ray into model space
-	auto inv = invert(transforms);
 	auto start = cart(inv * ray_start);
 	auto end = cart(inv * ray_end);
 	auto dir = norm(end - start);
@@ -96,3 +97,119 @@ std::optional<hit> cone::intersect(const vec4d &ray_start, const vec4d &ray_end)
 
 	return hit1;
 }
+
+bounds cone::model_bounds() const
+{
+	return { vec3d{{ -1, 0, -1 }}, vec3d{{ 1, 1, 1 }} }; // tip at y = 1, unit base on y = 0
+}
+
+// as a solid, the cone is closed by its base
+bool cone::model_spans(const vec3d &start, const vec3d &dir, span_list &out)
+{
+	const double inf = std::numeric_limits<double>::infinity();
+
+	// between the base and the tip, 0 <= y <= 1
+	double slab_in = -inf, slab_out = inf;
+	vec3d base_in{{ 0, -1, 0 }}, base_out{{ 0, -1, 0 }};
+
+	if (dir.y() != 0)
+	{
+		slab_in = -start.y() / dir.y();
+		slab_out = (1 - start.y()) / dir.y();
+
+		// going down, in through the tip and out through the base
+		if (slab_in > slab_out)
+		{
+			std::swap(slab_in, slab_out);
+			base_in = vec3d{{ 0, 1, 0 }};
+		}
+		else
+		{
+			base_out = vec3d{{ 0, 1, 0 }};
+		}
+	}
+	else if (start.y() < 0 || start.y() > 1)
+	{
+		return true;
+	}
+
+	// inside the double cone, x^2 + z^2 <= (1 - y)^2, is where a quadratic in t is <= 0
+	double k = 1 - start.y();
+	double a = dir.x() * dir.x() + dir.z() * dir.z() - dir.y() * dir.y();
+	double b = 2 * (start.x() * dir.x() + start.z() * dir.z() + k * dir.y());
+	double c = start.x() * start.x() + start.z() * start.z() - k * k;
+
+	// at most two pieces, the one that's not between the base and the tip ends up empty below
+	double pieces[2][2];
+	size_t count = 0;
+
+	auto piece = [&](double lo, double hi)
+	{
+		pieces[count][0] = lo;
+		pieces[count][1] = hi;
+		++count;
+	};
+
+	if (a == 0)
+	{
+		// along the side of the cone, the quadratic is a line
+		if (b > 0)
+			piece(-inf, -c / b);
+		else if (b < 0)
+			piece(-c / b, inf);
+		else if (c <= 0)
+			piece(-inf, inf);
+	}
+	else
+	{
+		double discrim = b * b - 4 * a * c;
+
+		if (discrim < 0)
+		{
+			// never inside when it opens up, always when it opens down
+			if (a < 0)
+				piece(-inf, inf);
+		}
+		else
+		{
+			double t1 = (-b - std::sqrt(discrim)) / (2 * a);
+			double t2 = (-b + std::sqrt(discrim)) / (2 * a);
+			if (t1 > t2)
+				std::swap(t1, t2);
+
+			if (a > 0)
+			{
+				piece(t1, t2);
+			}
+			else
+			{
+				piece(-inf, t1);
+				piece(t2, inf);
+			}
+		}
+	}
+
+	// the side's normal is the gradient of the quadratic
+	auto side_normal = [&](double t)
+	{
+		auto p = start + dir * t;
+		return vec3d{{ p.x(), 1 - p.y(), p.z() }};
+	};
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		double t_in = std::max(pieces[i][0], slab_in);
+		double t_out = std::min(pieces[i][1], slab_out);
+		if (t_in >= t_out)
+			continue;
+
+		out.push({
+			t_in, t_out,
+			t_in == slab_in ? base_in : side_normal(t_in),
+			t_out == slab_out ? base_out : side_normal(t_out),
+			this, this
+		});
+	}
+
+	return true;
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <limits>
+
+#include "csg.hpp"
+#include "vector.hpp"
+
+// box around s as a solid, where its transforms put it
+static bounds placed(const surface &s)
+{
+	auto corners = s.solid_bounds().corners();
+
+	auto first = cart(s.transforms * homo(corners[0]));
+	bounds box{ first, first };
+
+	for (size_t i = 1; i < 8; ++i)
+		box.add(cart(s.transforms * homo(corners[i])));
+
+	return box;
+}
+
+// whether the line from start along dir goes through box, anywhere along it
+static bool crosses(const bounds &box, const vec3d &start, const vec3d &dir)
+{
+	double t0 = -std::numeric_limits<double>::infinity(), t1 = std::numeric_limits<double>::infinity();
+
+	for (size_t k = 0; k < 3; ++k)
+	{
+		double s = start.at(k, 0), d = dir.at(k, 0);
+		double lo = box.lo.at(k, 0), hi = box.hi.at(k, 0);
+
+		if (d == 0)
+		{
+			if (s < lo || s > hi)
+				return false;
+
+			continue;
+		}
+
+		double ta = (lo - s) / d, tb = (hi - s) / d;
+		if (ta > tb)
+			std::swap(ta, tb);
+
+		t0 = std::max(t0, ta);
+		t1 = std::min(t1, tb);
+	}
+
+	return t0 <= t1;
+}
+
+// spans of an operand, with the line moved into its model space and the normals brought back out
+// t stays the same, the direction isn't normalized on the way in
+static void operand_spans(surface &s, const mat4d &inv, const vec3d &start, const vec3d &dir, span_list &out)
+{
+	auto s_start = cart(inv * homo(start));
+	auto s_dir = cart(inv * homo(start + dir)) - s_start;
+
+	s.model_spans(s_start, s_dir, out);
+
+	for (size_t i = 0; i < out.count; ++i)
+	{
+		auto &sp = out.items[i];
+		sp.n_in = cart(dir_to_world(s.transforms, homo(sp.n_in)));
+		sp.n_out = cart(dir_to_world(s.transforms, homo(sp.n_out)));
+	}
+}
+
+// walks the boundaries of both lists in order, keeping track of being inside each, and adds a span wherever
+// being inside the result starts and stops
+static void combine(const span_list &a, const span_list &b, csg_op op, span_list &out)
+{
+	const double inf = std::numeric_limits<double>::infinity();
+
+	// boundaries passed in each list, two a span
+	size_t i = 0, j = 0;
+	const size_t a_end = 2 * a.count, b_end = 2 * b.count;
+
+	bool in_a = false, in_b = false, inside = false;
+	span current{};
+
+	while (i < a_end || j < b_end)
+	{
+		double ta = i < a_end ? (i % 2 ? a.items[i / 2].t_out : a.items[i / 2].t_in) : inf;
+		double tb = j < b_end ? (j % 2 ? b.items[j / 2].t_out : b.items[j / 2].t_in) : inf;
+
+		bool from_a = j == b_end || (i < a_end && ta <= tb);
+		size_t &passed = from_a ? i : j;
+
+		const span &s = from_a ? a.items[passed / 2] : b.items[passed / 2];
+		bool entering = passed % 2 == 0;
+		++passed;
+
+		(from_a ? in_a : in_b) = entering;
+
+		bool now = op == csg_op::unite ? in_a || in_b : op == csg_op::intersect ? in_a && in_b : in_a && !in_b;
+		if (now == inside)
+			continue;
+
+		inside = now;
+
+		double t = from_a ? ta : tb;
+		auto normal = entering ? s.n_in : s.n_out;
+		auto obj = entering ? s.in : s.out;
+
+		// where the result ends on the solid taken away, it faces into it
+		if (op == csg_op::subtract && !from_a)
+			normal = normal * -1.0;
+
+		if (now)
+		{
+			current.t_in = t;
+			current.n_in = normal;
+			current.in = obj;
+		}
+		else
+		{
+			current.t_out = t;
+			current.n_out = normal;
+			current.out = obj;
+
+			if (current.t_out > current.t_in)
+				out.push(current);
+		}
+	}
+}
+
+void csg::build()
+{
+	if (!left || !right)
+		return;
+
+	left_inverse = invert(left->transforms);
+	right_inverse = invert(right->transforms);
+
+	left_box = placed(*left);
+	right_box = placed(*right);
+
+	apart = false;
+	for (size_t k = 0; k < 3; ++k)
+		if (left_box.hi.at(k, 0) < right_box.lo.at(k, 0) || right_box.hi.at(k, 0) < left_box.lo.at(k, 0))
+			apart = true;
+}
+
+bool csg::reflects() const
+{
+	return (left && left->reflects()) || (right && right->reflects());
+}
+
+bounds csg::model_bounds() const
+{
+	switch (op)
+	{
+	case csg_op::unite:
+	{
+		auto box = left_box;
+		box.add(right_box);
+		return box;
+	}
+	case csg_op::intersect:
+	{
+		if (apart)
+			return { left_box.lo, left_box.lo };
+
+		bounds box;
+		for (size_t k = 0; k < 3; ++k)
+		{
+			box.lo.at(k, 0) = std::max(left_box.lo.at(k, 0), right_box.lo.at(k, 0));
+			box.hi.at(k, 0) = std::min(left_box.hi.at(k, 0), right_box.hi.at(k, 0));
+		}
+		return box;
+	}
+	default:
+		return left_box;
+	}
+}
+
+bool csg::model_spans(const vec3d &start, const vec3d &dir, span_list &out)
+{
+	if (!left || !right)
+		return true;
+
+	bool through_left = crosses(left_box, start, dir);
+	bool through_right = crosses(right_box, start, dir);
+
+	// nothing to take from or to keep
+	if (!through_left && op != csg_op::unite)
+		return true;
+
+	if (op == csg_op::intersect && (apart || !through_right))
+		return true;
+
+	span_list a, b;
+	if (through_left)
+		operand_spans(*left, left_inverse, start, dir, a);
+
+	// an intersection or a difference of nothing is nothing, the other side is never looked at
+	if (a.count == 0 && op != csg_op::unite)
+		return true;
+
+	if (through_right)
+		operand_spans(*right, right_inverse, start, dir, b);
+
+	combine(a, b, op, out);
+	return true;
+}
+
+std::optional<hit> csg::intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double)
+{
+	auto start = cart(inv * ray_start);
+	auto dir = cart(inv * ray_end) - start;
+
+	span_list spans;
+	model_spans(start, dir, spans);
+
+	// the first boundary in front of the start, which is where the ray leaves when it starts inside
+	for (size_t i = 0; i < spans.count; ++i)
+	{
+		auto &sp = spans.items[i];
+
+		bool enters = sp.t_in >= 0;
+		if (!enters && sp.t_out < 0)
+			continue;
+
+		double t = enters ? sp.t_in : sp.t_out;
+		if (t == std::numeric_limits<double>::infinity())
+			return {};
+
+		return {{
+			norm(cart(dir_to_world(transforms, homo(enters ? sp.n_in : sp.n_out)))),
+			cart(transforms * homo(start + dir * t)),
+			enters ? sp.in : sp.out
+		}};
+	}
+
+	return {};
+}
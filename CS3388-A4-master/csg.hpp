@@ -0,0 +1,35 @@
+#ifndef A4_CSG_HPP
+#define A4_CSG_HPP
+
+#include <cstdint>
+
+#include "surface.hpp"
+
+enum class csg_op : uint32_t { unite, intersect, subtract };
+
+// the union, intersection, or difference of two surfaces taken as solids, spheres, cones, planes, or other csg nodes
+// spans of the ray through each operand are combined, hits are where the first of the result starts, on the operand there
+// a ray only has an operand's spans found when it goes through its box, so most rays only find one side's
+// the node's transforms go on top of its operands'
+struct csg : surface
+{
+	csg_op op = csg_op::unite;
+	surface *left = nullptr, *right = nullptr; // not owned, and not drawn unless they're in the scene too
+
+	// set by build()
+	mat4d left_inverse = identity(), right_inverse = identity(); // of the operands' transforms
+	bounds left_box, right_box; // around the operands as solids, where their transforms put them
+	bool apart = false; // whether the boxes don't overlap, an intersection is then empty
+
+	// once the operands are placed, and built if they're csg nodes
+	void build();
+
+	virtual bounds model_bounds() const;
+	virtual bool model_spans(const vec3d &start, const vec3d &dir, span_list &out);
+	virtual bool reflects() const; // hits carry the operands' materials
+
+protected:
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time);
+};
+
+#endif //A4_CSG_HPP
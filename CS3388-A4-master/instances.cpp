@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "instances.hpp"
+#include "vector.hpp"
+
+bounds instance_look::model_bounds() const
+{
+	return { vec3d{{ 0, 0, 0 }}, vec3d{{ 0, 0, 0 }} };
+}
+
+std::optional<hit> instance_look::intersect_model(const mat4d &, const vec4d &, const vec4d &, double)
+{
+	return {};
+}
+
+uint32_t instance_set::add_look(const ::material &mat)
+{
+	for (size_t i = 0; i < looks.size(); ++i)
+		if (std::memcmp(&looks[i].material, &mat, sizeof(mat)) == 0)
+			return static_cast<uint32_t>(i);
+
+	looks.emplace_back().material = mat;
+	return static_cast<uint32_t>(looks.size() - 1);
+}
+
+void instance_set::add(const mat4d &transform, uint32_t look)
+{
+	instances.push_back({ transform, invert(transform), look, instance::still });
+}
+
+void instance_set::add(const mat4d &transform, const mat4d &end, uint32_t look)
+{
+	instances.push_back({ transform, invert(transform), look, static_cast<uint32_t>(instance_motion.size()) });
+
+	instance_motion.resize(instance_motion.size() + motion_steps + 1);
+	motion_to_start(transform, end, instance_motion.writable() + instances.back().motion);
+}
+
+void instance_set::build(size_t threads)
+{
+	nodes.clear();
+	if (!shape || instances.empty())
+		return;
+
+	shape_inverse = invert(shape->transforms);
+
+	// the shape where it ends up in each instance
+	auto corners = shape->world_bounds().corners();
+
+	std::vector<primitive_box> boxes(instances.size());
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		auto first = cart(instances[i].transform * homo(corners[0]));
+		bounds box{ first, first };
+
+		for (size_t k = 1; k < 8; ++k)
+			box.add(cart(instances[i].transform * homo(corners[k])));
+
+		if (instances[i].motion != instance::still)
+			box = swept_bounds(box, &instance_motion[instances[i].motion]);
+
+		for (size_t k = 0; k < 3; ++k)
+		{
+			boxes[i].lo[k] = box.lo.at(k, 0);
+			boxes[i].hi[k] = box.hi.at(k, 0);
+			boxes[i].center[k] = 0.5 * (box.lo.at(k, 0) + box.hi.at(k, 0));
+		}
+	}
+
+	std::vector<uint32_t> order;
+	nodes = build_bvh(boxes, order, threads);
+
+	std::vector<instance> sorted(instances.size());
+	for (size_t i = 0; i < sorted.size(); ++i)
+		sorted[i] = instances[order[i]];
+
+	instances.swap(sorted);
+}
+
+bool instance_set::moving() const
+{
+	return surface::moving() || !instance_motion.empty();
+}
+
+bool instance_set::reflects() const
+{
+	return std::any_of(looks.begin(), looks.end(), [](const instance_look &l) { return l.material.k_reflect > 0; });
+}
+
+bounds instance_set::model_bounds() const
+{
+	if (nodes.empty())
+		return { vec3d{{ 0, 0, 0 }}, vec3d{{ 0, 0, 0 }} };
+
+	return { vec3d{{ nodes[0].lo[0], nodes[0].lo[1], nodes[0].lo[2] }}, vec3d{{ nodes[0].hi[0], nodes[0].hi[1], nodes[0].hi[2] }} };
+}
+
+std::optional<hit> instance_set::intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time)
+{
+	if (nodes.empty())
+		return {};
+
+	// ray in the space of the set, t runs from 0 at the start to 1 at the end
+	auto set_start = inv * ray_start;
+	auto set_end = inv * ray_end;
+	auto start = cart(set_start);
+	auto dir = cart(set_end) - start;
+
+	const double o[3] = { start.x(), start.y(), start.z() };
+	const double d[3] = { dir.x(), dir.y(), dir.z() };
+	const double dd = dot(dir, dir);
+
+	double best_t = std::numeric_limits<double>::infinity();
+	std::optional<hit> best; // in the space of the set
+	uint32_t best_look = 0;
+
+	traverse(nodes, o, d, best_t, [&](uint32_t first, uint32_t count)
+	{
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			auto &inst = instances[i];
+
+			if (inst.motion != instance::still)
+			{
+				// moved back to where the copy is at time 0, and the hit put back on the ray as it is
+				auto to_start = motion_at(&instance_motion[inst.motion], time);
+				auto h = shape->intersect_model(shape_inverse, inst.inverse * (to_start * set_start), inst.inverse * (to_start * set_end), time);
+				if (!h)
+					continue;
+
+				h = moved_hit(to_start, set_start, set_end, hit{ cart(dir_to_world(inst.transform, homo(h->normal))),
+					cart(inst.transform * homo(h->world_pt)), nullptr });
+
+				double t = dot(h->world_pt - start, dir) / dd;
+				if (t < 0 || t >= best_t)
+					continue;
+
+				best_t = t;
+				best = h;
+				best_look = inst.look;
+				continue;
+			}
+
+			// the shape puts its hit where its own transforms take it, the instance's go on top
+			auto h = shape->intersect_model(shape_inverse, inst.inverse * set_start, inst.inverse * set_end, time);
+			if (!h)
+				continue;
+
+			auto pt = cart(inst.transform * homo(h->world_pt));
+
+			// the same t as along the ray in the instance, transforms keep straight lines straight
+			double t = dot(pt - start, dir) / dd;
+			if (t < 0 || t >= best_t)
+				continue;
+
+			best_t = t;
+			best = hit{ cart(dir_to_world(inst.transform, homo(h->normal))), pt, nullptr };
+			best_look = inst.look;
+		}
+	});
+
+	if (!best)
+		return {};
+
+	return {{
+		norm(cart(dir_to_world(transforms, homo(best->normal)))),
+		cart(transforms * homo(best->world_pt)),
+		&looks[best_look]
+	}};
+}
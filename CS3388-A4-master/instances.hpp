@@ -0,0 +1,70 @@
+#ifndef A4_INSTANCES_HPP
+#define A4_INSTANCES_HPP
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "bvh.hpp"
+#include "mapped_array.hpp"
+#include "surface.hpp"
+
+// carries the material of some of the instances of an instance_set, hits on them come back as being on it
+// never intersected itself
+struct instance_look : surface
+{
+	virtual bounds model_bounds() const;
+
+protected:
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time);
+};
+
+// one copy of the shape of an instance_set
+struct instance
+{
+	static constexpr uint32_t still = ~0u;
+
+	mat4d transform; // goes on top of the shape's own transforms, at time 0 when it moves
+	mat4d inverse; // of transform, so rays don't invert it every time
+	uint32_t look; // index into the set's looks
+	uint32_t motion; // index of its first step in the set's instance_motion, still if it doesn't move
+};
+
+// many copies of one shared surface, each only a transform and a material, so memory goes with the number of copies
+// and not with how much the shape is made of
+// a hierarchy over the instances finds the ones a ray could hit, the ray is then moved into each and handed to the shape,
+// which goes through its own hierarchy if it's a mesh
+// the set's own transforms go on top of every instance's
+// the instances, their steps and the hierarchy point straight into the scene cache when it's read from one
+struct instance_set : surface
+{
+	surface *shape = nullptr; // not owned, and not drawn unless it's in the scene too
+	mapped_array<instance> instances; // in the order of the leaves once built
+	std::deque<instance_look> looks; // the materials the instances pick from
+	mapped_array<mat4d> instance_motion; // motion_steps + 1 steps for each instance that moves, see motion_to_start()
+
+	mapped_array<bvh_node> nodes; // the hierarchy, empty until build()
+	mat4d shape_inverse = identity(); // of the shape's transforms, set by build()
+
+	// index of the look with that material, added if there's none yet
+	uint32_t add_look(const ::material &mat);
+
+	void add(const mat4d &transform, uint32_t look);
+
+	// a copy moving from transform at time 0 to end at time 1
+	void add(const mat4d &transform, const mat4d &end, uint32_t look);
+
+	// builds the hierarchy once every instance is in, see build_bvh()
+	// the box of a moving instance is around it over the whole shutter, and so are the nodes above it
+	void build(size_t threads = 0);
+
+	virtual bounds model_bounds() const;
+	virtual bool moving() const;
+	virtual bool reflects() const; // hits carry the looks
+
+protected:
+	// copies that move are moved back to time 0 for the ray, the rest cost what they always did
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time);
+};
+
+#endif //A4_INSTANCES_HPP
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numbers>
+
+#include "lens.hpp"
+
+std::pair<double, double> concentric_disk(double u, double v)
+{
+	// the square [-1, 1]^2, each of its concentric squares onto a circle, by Shirley and Chiu
+	double a = 2 * u - 1, b = 2 * v - 1;
+	if (a == 0 && b == 0)
+		return { 0, 0 };
+
+	double r, phi;
+	if (std::abs(a) > std::abs(b))
+	{
+		r = a;
+		phi = std::numbers::pi / 4 * (b / a);
+	}
+	else
+	{
+		r = b;
+		phi = std::numbers::pi / 2 - std::numbers::pi / 4 * (a / b);
+	}
+
+	return { r * std::cos(phi), r * std::sin(phi) };
+}
+
+std::string lens_stats::summary() const
+{
+	char line[128];
+	std::string text;
+
+	size_t sharp = 0, total_samples = 0, total_pixels = 0;
+	for (size_t i = 0; i < samples.size(); ++i)
+	{
+		sharp += samples[i] == pixels[i] ? 1 : 0;
+		total_samples += samples[i];
+		total_pixels += pixels[i];
+	}
+
+	std::snprintf(line, sizeof(line), "lens  %zu tiles sharp, %zu blurred, samples/pixel %.3f\n", sharp, samples.size() - sharp,
+		total_pixels ? 1.0 * total_samples / total_pixels : 0.0);
+	text += line;
+
+	// samples a pixel of every tile, laid out like the screen
+	for (size_t ty = 0; ty < tiles_y; ++ty)
+	{
+		for (size_t tx = 0; tx < tiles_x; ++tx)
+		{
+			size_t i = ty * tiles_x + tx;
+			std::snprintf(line, sizeof(line), "%3.0f", pixels[i] ? 1.0 * samples[i] / pixels[i] : 0.0);
+			text += line;
+		}
+
+		text += "\n";
+	}
+
+	return text;
+}
+
+thin_lens::thin_lens(const vec3d &eye, const vec3d &gaze, const vec3d &up, const mat4d &inv, size_t width, size_t height,
+	const lens_options &options) :
+	center(eye),
+	screen_inv(inv),
+	rays(eye, inv, width, height),
+	width(width),
+	height(height),
+	lens(options)
+{
+	// the same frame camera() builds, the lens lies in the plane of right and up
+	forward = norm(gaze - eye);
+	right = norm(cross(forward, up));
+	this->up = norm(cross(right, forward));
+
+	if (lens.focus <= 0)
+		lens.focus = dot(gaze - eye, forward);
+
+	// a pixel's step one unit along the view, the smaller way if they aren't square, so blur is never underestimated
+	auto step = [&](size_t x, size_t y)
+	{
+		vec3d a = cart(rays.end(0, 0)) - center, b = cart(rays.end(x, y)) - center;
+		vec3d d = b / dot(b, forward) - a / dot(a, forward);
+		return std::sqrt(dot(d, d));
+	};
+
+	double step_x = width > 1 ? step(1, 0) : std::numeric_limits<double>::infinity();
+	double step_y = height > 1 ? step(0, 1) : std::numeric_limits<double>::infinity();
+
+	pitch = std::min(step_x, step_y);
+}
+
+std::pair<vec4d, vec4d> thin_lens::ray(size_t x, size_t y, double s, double t) const
+{
+	auto end = rays.end(x, y);
+	if (s == 0 && t == 0)
+		return { homo(center), end };
+
+	// where the pinhole ray crosses the plane in focus, which every ray of the pixel goes through
+	vec3d d = cart(end) - center;
+	vec3d focal = center + d * (lens.focus / dot(d, forward));
+	vec3d from = center + right * (s * lens.aperture) + up * (t * lens.aperture);
+
+	return { homo(from), homo(focal) };
+}
+
+double thin_lens::blur(double depth) const
+{
+	// the rays of a pixel leave the lens over a disk of the aperture and meet at the focus, so depth along the view they're
+	// spread over aperture |depth - focus| / focus, which the screen shows pitch depth to a pixel
+	return lens.aperture * std::abs(depth - lens.focus) / (lens.focus * depth * pitch);
+}
+
+tile_mask thin_lens::blurred_tiles(const gbuffer &g) const
+{
+	tile_mask mask(g.width, g.height);
+
+	if (lens.aperture <= 0)
+		return mask;
+
+	for (size_t ty = 0; ty < mask.tiles_y; ++ty)
+	{
+		for (size_t tx = 0; tx < mask.tiles_x; ++tx)
+		{
+			size_t x0 = tx * tile_size, y0 = ty * tile_size;
+			size_t x1 = std::min(x0 + tile_size, g.width), y1 = std::min(y0 + tile_size, g.height);
+
+			// how deep the surfaces seen in the tile go along the view
+			double nearest = std::numeric_limits<double>::infinity(), farthest = -nearest;
+
+			for (size_t y = y0; y < y1; ++y)
+			{
+				for (size_t x = x0; x < x1; ++x)
+				{
+					size_t i = y * g.width + x;
+					if (!g.obj[i])
+						continue;
+
+					double depth = (g.px[i] - center.x()) * forward.x() + (g.py[i] - center.y()) * forward.y() + (g.pz[i] - center.z()) * forward.z();
+
+					nearest = std::min(nearest, depth);
+					farthest = std::max(farthest, depth);
+				}
+			}
+
+			if (nearest > farthest)
+				continue; // nothing hit
+
+			// blur only grows away from the focus, so the most is at the near or the far side
+			double r = std::max(blur(nearest), blur(farthest));
+			if (r <= lens.sharp)
+				continue;
+
+			mask.mark(x0 - r, y0 - r, x1 - 1 + r, y1 - 1 + r);
+		}
+	}
+
+	return mask;
+}
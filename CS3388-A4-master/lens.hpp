@@ -0,0 +1,226 @@
+#ifndef A4_LENS_HPP
+#define A4_LENS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "light.hpp"
+#include "render.hpp"
+#include "surface.hpp"
+#include "vector.hpp"
+
+// depth of field, the eye taken as a thin lens instead of a pinhole
+// every ray of a pixel goes through the same point on the plane in focus, each from a different point on the lens,
+// so what's on that plane stays sharp and the rest blurs over a disk that grows with the aperture and how far off it is
+// the samples are spread over the shutter too, so surfaces that move while it's open blur along where they go
+
+struct lens_options
+{
+	double aperture = 0; // radius of the lens in world units, 0 is a pinhole
+	double focus = 0; // distance from the eye along the view to the plane in focus, 0 focuses on the gaze point
+	size_t samples = 16; // rays a pixel gets in tiles where something could be out of focus or moving
+	double sharp = 0.5; // radius in pixels a point can blur to and still count as in focus
+};
+
+// point of the unit disk for the uniform numbers u and v, squares of (u, v) go to wedges of rings of the same area,
+// so a stratified pattern of (u, v) stays stratified over the disk
+std::pair<double, double> concentric_disk(double u, double v);
+
+// samples spent on each screen tile by render_lens()
+struct lens_stats
+{
+	size_t tiles_x = 0, tiles_y = 0;
+	std::vector<size_t> samples, pixels; // of each tile, row by row
+
+	// tiles sharp and blurred, samples a pixel over the image, then a row of samples a pixel per row of tiles
+	std::string summary() const;
+};
+
+// a camera with a lens, inv takes screen coords back to world space as for render()
+class thin_lens
+{
+public:
+	thin_lens(const vec3d &eye, const vec3d &gaze, const vec3d &up, const mat4d &inv, size_t width, size_t height,
+		const lens_options &options);
+
+	const lens_options &options() const { return lens; }
+	const vec3d &eye() const { return center; }
+	const mat4d &inv() const { return screen_inv; }
+
+	// the ray through pixel (x, y) from the point (s, t) of the unit disk on the lens, its start and homogeneous end
+	// the center of the lens is the pinhole ray, exactly
+	std::pair<vec4d, vec4d> ray(size_t x, size_t y, double s, double t) const;
+
+	// radius in pixels a point depth along the view from the eye blurs to
+	double blur(double depth) const;
+
+	// tiles where something could blur by more than options().sharp, from the depths the pinhole rays of each found in g
+	// a tile that blurs takes in its neighbours as far as it blurs, what's in it can spread over them
+	// tiles where every ray missed only blur by what spreads into them
+	tile_mask blurred_tiles(const gbuffer &g) const;
+
+private:
+	vec3d center, right, up, forward; // forward is along the view, right and up span the lens
+	mat4d screen_inv;
+	ray_generator rays;
+	size_t width, height;
+	lens_options lens;
+	double pitch; // size of a pixel one unit along the view
+};
+
+// ray traces a scene into image through a thin lens, which has to be made for the size of image
+// a visibility pass of pinhole rays first finds how deep the scene is in each tile, see thin_lens::blurred_tiles(), and
+// the tiles where something moves are added, see moving_tiles()
+// pixels of the tiles left are sharp and shaded from the pass, as render() would, the rest take options().samples rays
+// from a stratified pattern over the lens, each at its own time in the shutter, traced shadow_packet at a time since the
+// rays of a pixel all meet at one point and mostly hit the same surfaces
+// sample_counts, if given, is made a grey image of how many samples each pixel took, white being options().samples
+template<typename C>
+draw_counts render_lens(const C &scene, const light_list &lights, const thin_lens &lens, sf::Image &image,
+	const render_options &options = {}, ray_stats *stats = nullptr, lens_stats *lstats = nullptr, sf::Image *sample_counts = nullptr)
+{
+	TRACE_ZONE("lens render");
+
+	const size_t width = image.getSize().x, height = image.getSize().y;
+	const size_t max_samples = std::max<size_t>(lens.options().samples, 1);
+
+	gbuffer g;
+	visibility_pass(scene, lens.eye(), lens.inv(), width, height, g, stats);
+
+	tile_mask blurred = lens.blurred_tiles(g);
+	tile_mask moving = moving_tiles(scene, lights, invert(lens.inv()), width, height);
+
+	for (size_t i = 0; i < blurred.size(); ++i)
+		blurred.dirty[i] |= moving.dirty[i];
+
+	if (lstats)
+	{
+		lstats->tiles_x = blurred.tiles_x;
+		lstats->tiles_y = blurred.tiles_y;
+		lstats->samples.assign(blurred.size(), 0);
+		lstats->pixels.assign(blurred.size(), 0);
+	}
+
+	if (sample_counts)
+		sample_counts->create(width, height, sf::Color::Black);
+
+	draw_counts counts;
+
+	std::array<vec4d, shadow_packet> starts, ends;
+	std::array<std::optional<hit>, shadow_packet> closest;
+	std::array<double, shadow_packet> times;
+
+	for_each_tile(width, height, [&](size_t x, size_t y)
+	{
+		size_t tile = (y / tile_size) * blurred.tiles_x + x / tile_size;
+		size_t samples = blurred.dirty[tile] ? max_samples : 1;
+
+		if (stats)
+		{
+			stats->pixels += 1;
+			stats->samples += samples;
+			stats->refined += samples > 1 ? 1 : 0;
+		}
+
+		if (lstats)
+		{
+			lstats->samples[tile] += samples;
+			lstats->pixels[tile] += 1;
+		}
+
+		if (sample_counts)
+		{
+			auto level = static_cast<uint8_t>(std::round(255.0 * samples / max_samples));
+			sample_counts->setPixel(x, y, sf::Color(level, level, level));
+		}
+
+		// sharp, the pinhole ray is the pixel
+		if (samples == 1)
+		{
+			auto first = g.at(y * width + x);
+			if (!first)
+				return;
+
+			auto start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+			auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0);
+			auto sample = follow_ray(scene, lights, lens.eye(), first.value(), options, stats, key, start);
+
+			image.setPixel(x, y, pixel_color(sample.color));
+			counts.pixels += 1;
+			return;
+		}
+
+		auto seed = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0);
+
+		// a different scramble for every pixel, so neighbours don't blur along the same pattern
+		uint32_t scramble_s = random_bits(seed ^ 0x27d4eb2f, 0);
+		uint32_t scramble_t = random_bits(seed ^ 0x27d4eb2f, 1);
+
+		// times step by the golden ratio from somewhere different in every pixel, any run of them is spread over the
+		// shutter, and in a way that has nothing to do with where the Sobol points of the lens fall
+		double shutter = random_unit(seed ^ 0x27d4eb2f, 2);
+
+		vec3d sum{{ 0, 0, 0 }};
+		size_t hits = 0;
+
+		for (size_t first = 0; first < samples; first += shadow_packet)
+		{
+			size_t n = std::min(shadow_packet, samples - first);
+			auto start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+
+			for (size_t k = 0; k < n; ++k)
+			{
+				double s = 0, t = 0;
+				if (lens.options().aperture > 0)
+				{
+					auto [u, v] = sobol_2d(static_cast<uint32_t>(first + k), scramble_s, scramble_t);
+					std::tie(s, t) = concentric_disk(u, v);
+				}
+
+				std::tie(starts[k], ends[k]) = lens.ray(x, y, s, t);
+
+				double time = shutter + 0.6180339887498949 * (first + k);
+				times[k] = time - std::floor(time);
+			}
+
+			find_intersections(scene, starts.data(), ends.data(), n, closest.data(), times.data());
+
+			if (stats)
+				stats->rays[0] += n;
+
+			for (size_t k = 0; k < n; ++k)
+			{
+				if (!closest[k])
+					continue;
+
+				auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(first + k));
+				auto sample = follow_ray(scene, lights, cart(starts[k]), closest[k].value(), options, stats, key, start, times[k]);
+
+				sum = sum + sample.color;
+				hits += 1;
+
+				// the packet's time went to the first hit shaded, the rest only count their own
+				start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+			}
+		}
+
+		if (hits == 0)
+			return;
+
+		image.setPixel(x, y, pixel_color(sum * (1.0 / hits), 1.0 * hits / samples));
+		counts.pixels += 1;
+	});
+
+	return counts;
+}
+
+#endif //A4_LENS_HPP
@@ -0,0 +1,229 @@
+#define _USE_MATH_DEFINES
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <type_traits>
+
+#include "light.hpp"
+
+light_list::light_list(std::initializer_list<light> lights)
+{
+	for (auto &l : lights)
+		add(l);
+}
+
+void light_list::add(const light &l)
+{
+	auto p = cart(l.position);
+
+	x.push_back(p.x());
+	y.push_back(p.y());
+	z.push_back(p.z());
+	intensity.push_back(l.intensity);
+	shapes.push_back(l.shape);
+}
+
+size_t light_list::size() const
+{
+	return intensity.size();
+}
+
+vec3d light_list::position(size_t i) const
+{
+	return vec3d{{ x[i], y[i], z[i] }};
+}
+
+std::array<vec3d, 8> light_list::corners(size_t i) const
+{
+	const auto &shape = shapes[i];
+	auto center = position(i);
+
+	vec3d half{{ 0, 0, 0 }};
+	if (shape.kind == light_kind::rect)
+	{
+		for (size_t a = 0; a < 3; ++a)
+			half.at(a, 0) = 0.5 * (std::abs(shape.u.at(a, 0)) + std::abs(shape.v.at(a, 0)));
+	}
+	else if (shape.kind == light_kind::sphere)
+	{
+		half = vec3d{{ shape.radius, shape.radius, shape.radius }};
+	}
+
+	std::array<vec3d, 8> result;
+	for (size_t k = 0; k < 8; ++k)
+	{
+		result[k] = center + vec3d{{
+			k & 1 ? half.x() : -half.x(),
+			k & 2 ? half.y() : -half.y(),
+			k & 4 ? half.z() : -half.z()
+		}};
+	}
+
+	return result;
+}
+
+vec3d light_list::sample_point(size_t i, const vec3d &p, double s, double t) const
+{
+	const auto &shape = shapes[i];
+	auto center = position(i);
+
+	switch (shape.kind)
+	{
+	case light_kind::rect:
+		return center + shape.u * (s - 0.5) + shape.v * (t - 0.5);
+
+	case light_kind::sphere:
+	{
+		// disc through the center facing p, the same area is sampled evenly with the sqrt
+		auto w = norm(p - center);
+		auto a = std::abs(w.x()) > 0.9 ? vec3d{{ 0, 1, 0 }} : vec3d{{ 1, 0, 0 }};
+		auto e1 = norm(cross(a, w));
+		auto e2 = cross(w, e1);
+
+		double r = shape.radius * std::sqrt(s);
+		double phi = 2 * M_PI * t;
+
+		return center + e1 * (r * std::cos(phi)) + e2 * (r * std::sin(phi));
+	}
+
+	default:
+		return center;
+	}
+}
+
+// adds the node over ids[first, last) and everything under it, returns its index
+static uint32_t build_node(const light_list &lights, std::vector<uint32_t> &ids, uint32_t first, uint32_t last, std::vector<light_node> &nodes)
+{
+	uint32_t index = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({});
+
+	light_node node{};
+	node.lo = lights.position(ids[first]);
+	node.hi = node.lo;
+	node.first = first;
+	node.count = last - first;
+
+	for (uint32_t i = first; i < last; ++i)
+	{
+		auto p = lights.position(ids[i]);
+		for (size_t a = 0; a < 3; ++a)
+		{
+			node.lo.at(a, 0) = std::min(node.lo.at(a, 0), p.at(a, 0));
+			node.hi.at(a, 0) = std::max(node.hi.at(a, 0), p.at(a, 0));
+		}
+		node.intensity += lights.intensity[ids[i]];
+	}
+
+	if (node.count > 1)
+	{
+		// split the widest axis at the median
+		auto extent = node.hi - node.lo;
+		size_t axis = 0;
+		for (size_t a = 1; a < 3; ++a)
+			if (extent.at(a, 0) > extent.at(axis, 0))
+				axis = a;
+
+		uint32_t mid = first + node.count / 2;
+		std::nth_element(ids.begin() + first, ids.begin() + mid, ids.begin() + last, [&](uint32_t a, uint32_t b)
+		{
+			return lights.position(a).at(axis, 0) < lights.position(b).at(axis, 0);
+		});
+
+		build_node(lights, ids, first, mid, nodes);
+		node.right = build_node(lights, ids, mid, last, nodes);
+	}
+
+	nodes[index] = node;
+	return index;
+}
+
+void light_list::build_tree()
+{
+	nodes.clear();
+	if (size() == 0)
+		return;
+
+	std::vector<uint32_t> ids(size());
+	std::iota(ids.begin(), ids.end(), 0);
+
+	nodes.reserve(2 * size() - 1);
+	build_node(*this, ids, 0, static_cast<uint32_t>(size()), nodes);
+
+	// put the arrays in tree order, so a node's lights are next to each other
+	auto reorder = [&](auto &values)
+	{
+		std::remove_reference_t<decltype(values)> sorted(values.size());
+		for (size_t i = 0; i < ids.size(); ++i)
+			sorted[i] = values[ids[i]];
+		values.swap(sorted);
+	};
+
+	reorder(x);
+	reorder(y);
+	reorder(z);
+	reorder(intensity);
+	reorder(shapes);
+}
+
+// how much a node could light p at most, up to a constant
+// lights have no falloff, so it's the node's intensity times the best cosine any point in its bounding sphere
+// can make with n. back facing lights still add specular, so they keep a little weight and nothing is ever
+// left out of the sampling
+static double importance(const light_node &node, const vec3d &p, const vec3d &n)
+{
+	auto center = (node.lo + node.hi) * 0.5;
+	double radius = 0.5 * magnitude(node.hi - node.lo);
+
+	auto d = center - p;
+	double dist = magnitude(d);
+
+	double cos_bound = 1;
+	if (dist > radius)
+	{
+		double theta = std::acos(std::clamp(dot(d, n) / dist, -1.0, 1.0)); // angle to the center
+		double alpha = std::asin(radius / dist); // angle the sphere takes up
+
+		cos_bound = theta <= alpha ? 1 : std::cos(theta - alpha);
+	}
+
+	return node.intensity * std::max(cos_bound, 0.1);
+}
+
+std::pair<size_t, double> light_list::sample(const vec3d &p, const vec3d &n, double u) const
+{
+	if (nodes.empty())
+	{
+		size_t i = std::min(static_cast<size_t>(u * size()), size() - 1);
+		return { i, 1.0 / size() };
+	}
+
+	size_t node = 0;
+	double pdf = 1;
+
+	while (nodes[node].count > 1)
+	{
+		size_t left = node + 1, right = nodes[node].right;
+
+		double wl = importance(nodes[left], p, n);
+		double wr = importance(nodes[right], p, n);
+		double pl = wl + wr > 0 ? wl / (wl + wr) : 0.5;
+
+		// reuse u for the next level by stretching the part that was picked back over [0, 1)
+		if (u < pl)
+		{
+			u = u / pl;
+			pdf *= pl;
+			node = left;
+		}
+		else
+		{
+			u = (u - pl) / (1 - pl);
+			pdf *= 1 - pl;
+			node = right;
+		}
+
+		u = std::min(u, std::nextafter(1.0, 0.0));
+	}
+
+	return { nodes[node].first, pdf };
+}
@@ -1,12 +1,75 @@
 #ifndef LIGHT_HPP
 #define LIGHT_HPP
 
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
 #include "vector.hpp"
 
+// what a light is shaped like, point lights cast hard shadows and the others soft ones
+enum class light_kind : uint8_t { point, rect, sphere };
+
+struct light_shape
+{
+	light_kind kind = light_kind::point;
+	vec3d u{}, v{}; // rect: its two edges, centered on the position
+	double radius = 0; // sphere
+};
+
 struct light
 {
-	vec4d position;
+	vec4d position; // center of area lights
 	double intensity;
+	light_shape shape = {};
+};
+
+// node of the hierarchy over a light_list, covers the lights [first, first + count)
+// the first child is the next node, the second is right
+struct light_node
+{
+	vec3d lo, hi; // bounds of the positions under it
+	double intensity; // total of the lights under it
+	uint32_t first, count;
+	uint32_t right;
+};
+
+// every light of a scene, point lights and the rect and sphere area lights, with the tree that samples them
+// kept as one array per field so the shading loop over lights reads plain contiguous doubles, the shape of each apart
+struct light_list
+{
+	std::vector<double> x, y, z;
+	std::vector<double> intensity;
+	std::vector<light_shape> shapes;
+
+	std::vector<light_node> nodes; // hierarchy for sampling, empty until build_tree()
+
+	light_list() = default;
+	light_list(std::initializer_list<light> lights);
+
+	void add(const light &l);
+
+	size_t size() const;
+
+	vec3d position(size_t i) const;
+
+	// corners of the box around light i, all its position for a point light
+	std::array<vec3d, 8> corners(size_t i) const;
+
+	// point on light i for the shadow sample (s, t) in [0, 1)^2, seen from p
+	// rects map the square onto themselves, spheres map it onto the disc they show p
+	vec3d sample_point(size_t i, const vec3d &p, double s, double t) const;
+
+	// builds a binary tree over the lights, splitting the widest axis at the median down to one light per leaf
+	// reorders the arrays so every node covers a contiguous run of them, call again after adding lights
+	void build_tree();
+
+	// picks one light for the point p with normal n, walking down the tree and choosing a child with probability
+	// proportional to how much it could light p, u is uniform in [0, 1)
+	// returns the light and the probability it was picked with, which is > 0 for every light with any intensity
+	std::pair<size_t, double> sample(const vec3d &p, const vec3d &n, double u) const;
 };
 
 #endif
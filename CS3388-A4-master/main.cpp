@@ -5,58 +5,202 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <algorithm>
 #include <vector>
 #include <utility>
 #include <limits>
+#include <memory>
+#include <optional>
+#include <string>
 
 #include <SFML/Graphics.hpp>
 
+#include "camera.hpp"
 #include "matrix.hpp"
 #include "vector.hpp"
 #include "matrix_utils.hpp"
+#include "lens.hpp"
 #include "light.hpp"
-#include "plane.hpp"
-#include "cone.hpp"
-#include "sphere.hpp"
-
-// trims a value between a max and a min
-double clamp(double v, double max, double min);
-
-template<typename T, size_t N>
-vec<T, N> clamp(const vec<T, N> &v, double max, double min);
-
-// find intersections in a scene given a ray
-template<typename C>
-std::optional<hit> find_intersection(const C &scene, const vec4d &ray_start, const vec4d &ray_end)
+#include "path.hpp"
+#include "../common/profiler.hpp"
+#include "progressive.hpp"
+#include "render.hpp"
+#include "scene.hpp"
+#include "../common/trace.hpp"
+#include "wavefront.hpp"
+
+// stages of a frame, for the profiler
+enum stage : size_t { trace, lighting, upload, present };
+
+// the A4 scene, when there's no --scene
+const char *a4_scene = R"(
+eye 0 40 80
+gaze 0 0 0
+up 0 1 0
+
+light 40 80 0 1
+
+cone
+	name dunce
+	translate 40 0 0
+	scale 20
+	scale 1 2 1
+	color 0 180 180
+	ambient 0.12
+	diffuse 1
+	specular 255
+	reflect 0
+	fallout 256
+
+plane
+	name ground
+	scale 100
+	rotx -90
+	color 180 180 180
+	ambient 0.1
+	diffuse 1
+	specular 255
+	reflect 0
+	fallout 256
+
+sphere
+	name ball
+	translate -20 20 0
+	scale 20
+	color 255 150 0
+	ambient 0.08
+	diffuse 1
+	specular 255
+	reflect 0
+	fallout 256
+)";
+
+// flying speeds for --interactive
+const double move_speed = 40; // world units a second
+const double turn_speed = 1.5; // radians a second
+const double look_speed = 0.005; // radians a pixel the mouse is dragged
+
+// usage: A4 [--scene <file>] [--profile <frames.csv>] [--trace <trace.json>] [--trace-stride <n>] [--depth <n>] [--cutoff <weight>]
+//    [--light-cutoff <level>] [--light-samples <n>] [--light-size <side> | --light-radius <r>] [--shadow-samples <n>]
+//    [--aa <n>] [--aa-threshold <level>] [--aa-counts <counts.png>] [--sdf-steps <steps.png>] [--progressive] [--threads <n>]
+//    [--interactive] [--target-ms <ms>] [--path <samples>] [--bounces <n>] [--path-out <image.png>] [--wavefront]
+//    [--aperture <r>] [--focus <distance>] [--lens-samples <n>]
+// --scene reads the scene from a file instead (see scene.hpp for the format), caching it compiled next to it as <file>.bin
+// P toggles the frame stats overlay
+// arrows move the first light, +/- change its brightness and R toggles a mirror floor (the surface named ground),
+// which only redoes the shading pass, IJKL move the surface named ball, which only traces the tiles it or its shadow could have covered before or after again
+// (anti-aliased frames are traced again in full)
+// --trace needs a build with ENABLE_TRACING defined, per-ray zones are kept in every n-th tile (8 by default)
+// --depth and --cutoff limit how far reflections are followed, rays per pixel and time per depth are printed after the frame
+// --light-cutoff is how much (0 to 255) the faintest lights of a hit can add together before they get shadow rays,
+// they get them anyway when they could still round a channel up, or no light has reached the hit yet
+// --light-samples shades each hit with n lights picked from the light tree instead of every light, 0 (default) uses them all
+// --light-size makes the light a square facing down, --light-radius a ball, both cast soft shadows traced with up to
+// --shadow-samples rays (16 by default)
+// --aa gives pixels along edges up to n samples, where neighbours differ by more than --aa-threshold (0 to 255, 16 by default)
+// --aa-counts saves how many samples each pixel took, white being n, or --lens-samples through a lens
+// --sdf-steps saves how many steps tracing distance fields took for each pixel's first ray, white being the most
+// --progressive shows a blocky preview right away and refines it while --threads workers (one per core by default) trace,
+// Q stops them straight away
+// --path traces paths of light bouncing around the scene instead, lit by the lights at every bounce, samples of every pixel
+// added up a pass at a time on --threads workers so the image clears up as it goes, 0 samples keeps going until it's closed
+// --bounces is the most a path takes (8 by default), samples a second a thread are printed once it stops
+// --path-out saves the image, waiting for every sample even if the window is closed first
+// --wavefront traces frames a stage at a time over batches of pixels, with a queue for each type of surface, and prints
+// the rays, queues, kernel times and packet lanes filled of every stage after the first (see wavefront.hpp), it doesn't
+// anti-alias, or take a lens
+// --aperture traces frames through a thin lens of that radius instead of a pinhole, focused --focus along the view
+// (on the gaze point by default), pixels of tiles where something could blur take --lens-samples rays over the lens
+// (16 by default) and the rest just the one, the samples a pixel of every tile are printed after the first frame
+// scenes with surfaces that move (see moving in scene.hpp) are traced that way too, the samples spread over the shutter,
+// and so are paths, --interactive, --progressive and --wavefront show where everything is when the shutter opens
+// --interactive flies the camera with WASD, Space and left shift to rise and sink, arrows or dragging the mouse to look
+// while moving, frames are traced at whatever resolution keeps them near --target-ms (25 by default),
+// and once it stops the full resolution is brought back progressively
+int main(int argc, char **argv)
 {
-	std::vector<hit> hits;
-
-	// get the intersections of this ray and every object in the scene
-	for (auto &obj : scene)
+	std::string csv_path, trace_path, counts_path, scene_path, steps_path, path_out;
+	render_options options;
+	path_options paths;
+	lens_options lens_opts;
+	light_shape bulb_shape;
+	bool progressive = false, interactive = false, path = false, wavefront = false;
+	size_t threads = 0, path_samples = 0;
+	double target_ms = 25;
+
+	for (int i = 1; i < argc; ++i)
 	{
-		auto intersection = obj->intersect(ray_start, ray_end);
-
-		if (intersection)
-			hits.push_back(intersection.value());
+		if (std::string(argv[i]) == "--progressive")
+			progressive = true;
+		else if (std::string(argv[i]) == "--interactive")
+			interactive = true;
+		else if (std::string(argv[i]) == "--wavefront")
+			wavefront = true;
+
+		if (i + 1 >= argc)
+			break;
+
+		if (std::string(argv[i]) == "--scene")
+			scene_path = argv[i + 1];
+		else if (std::string(argv[i]) == "--profile")
+			csv_path = argv[i + 1];
+		else if (std::string(argv[i]) == "--trace")
+			trace_path = argv[i + 1];
+		else if (std::string(argv[i]) == "--trace-stride")
+			trace_fine_stride = std::stoi(argv[i + 1]);
+		else if (std::string(argv[i]) == "--depth")
+			options.max_depth = std::stoul(argv[i + 1]);
+		else if (std::string(argv[i]) == "--cutoff")
+			options.cutoff = std::stod(argv[i + 1]);
+		else if (std::string(argv[i]) == "--light-cutoff")
+			options.light_cutoff = std::stod(argv[i + 1]);
+		else if (std::string(argv[i]) == "--light-samples")
+			options.light_samples = std::stoul(argv[i + 1]);
+		else if (std::string(argv[i]) == "--light-size")
+		{
+			double side = std::stod(argv[i + 1]);
+			bulb_shape = { light_kind::rect, vec3d{{ side, 0, 0 }}, vec3d{{ 0, 0, side }} };
+		}
+		else if (std::string(argv[i]) == "--light-radius")
+			bulb_shape = { light_kind::sphere, {}, {}, std::stod(argv[i + 1]) };
+		else if (std::string(argv[i]) == "--shadow-samples")
+			options.shadow_samples = std::stoul(argv[i + 1]);
+		else if (std::string(argv[i]) == "--aa")
+			options.aa_samples = std::stoul(argv[i + 1]);
+		else if (std::string(argv[i]) == "--aa-threshold")
+			options.aa_threshold = std::stod(argv[i + 1]);
+		else if (std::string(argv[i]) == "--aa-counts")
+			counts_path = argv[i + 1];
+		else if (std::string(argv[i]) == "--sdf-steps")
+			steps_path = argv[i + 1];
+		else if (std::string(argv[i]) == "--threads")
+			threads = std::stoul(argv[i + 1]);
+		else if (std::string(argv[i]) == "--target-ms")
+			target_ms = std::stod(argv[i + 1]);
+		else if (std::string(argv[i]) == "--path")
+		{
+			path = true;
+			path_samples = std::stoul(argv[i + 1]);
+		}
+		else if (std::string(argv[i]) == "--bounces")
+			paths.max_bounces = std::stoul(argv[i + 1]);
+		else if (std::string(argv[i]) == "--path-out")
+			path_out = argv[i + 1];
+		else if (std::string(argv[i]) == "--aperture")
+			lens_opts.aperture = std::stod(argv[i + 1]);
+		else if (std::string(argv[i]) == "--focus")
+			lens_opts.focus = std::stod(argv[i + 1]);
+		else if (std::string(argv[i]) == "--lens-samples")
+			lens_opts.samples = std::stoul(argv[i + 1]);
 	}
 
-	if (hits.size() < 1)
-		return {};
+#if defined(ENABLE_TRACING)
+	trace_start("a4"); // before the workers and the hierarchy builds start threads of their own
+#endif
 
-	// return the shortest
-	return *std::min_element(hits.begin(), hits.end(), [&](const hit &a, const hit &b)
-	{
-		auto ra = a.world_pt - cart(ray_start);
-		auto rb = b.world_pt - cart(ray_start);
-
-		return dot(ra, ra) < dot(rb, rb);
-	});
-}
-
-int main()
-{
 	const size_t window_width = 1000, window_height = 600;
 	sf::RenderWindow window(sf::VideoMode(window_width, window_height), "pew pew pew");
 
@@ -65,10 +209,28 @@ int main()
 	sf::Texture texture; // need a texture to make a sprite
 	sf::Sprite sprite; // SFML can draw sprites
 
+	scene_data world;
+	std::string error;
+	bool cached = false;
+
+	if (scene_path.empty() ? !parse_scene(a4_scene, world, error) : !load_scene(scene_path, world, error, &cached))
+	{
+		std::cerr << error << std::endl;
+		return 1;
+	}
+
+	if (!scene_path.empty())
+		std::cout << "loaded " << scene_path << (cached ? " from its cache" : "") << ", " << world.objects.size() << " surfaces, "
+			<< world.lights.size() << " lights" << std::endl;
+
+	// reshaping changes none of the positions, the light tree stays as it is
+	if (bulb_shape.kind != light_kind::point)
+		std::fill(world.lights.shapes.begin(), world.lights.shapes.end(), bulb_shape);
+
 	// camera params
-	auto eye = vec3d{{ 0, 40, 80 }};
-	auto gaze = vec3d{{ 0, 0, 0 }};
-	auto up = vec3d{{ 0, 1, 0 }};
+	auto eye = world.eye;
+	auto gaze = world.gaze;
+	auto up = world.up;
 
 	// window, camera, perspective matrices
 	auto ms = screen( 1.0 * window_width, 1.0 * window_height );
@@ -77,135 +239,537 @@ int main()
 	auto mvp = ms * mp * mc;
 	auto inv = invert(mvp);
 
-	light bulb{ {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 };
-
-	sphere ball;
-	ball.transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
-	ball.material = {
-		.color = vec3d{{ 255, 150, 0 }},
-		.k_ambient = 0.08,
-		.k_diffuse = 1,
-		.k_specular = 255,
-		.fallout = 256
-	};
-
-	plane ground;
-	ground.transforms = scale(100.0) * rotx(-M_PI / 2);
-	ground.material = {
-		.color = vec3d{{ 180, 180, 180 }},
-		.k_ambient = 0.1,
-		.k_diffuse = 1,
-		.k_specular = 255,
-		.fallout = 256
-	};
-
-	cone dunce;
-	dunce.transforms = translate(40.0, 0.0, 0.0) * scale(20.0) * scale(1.0, 2.0, 1.0);
-	dunce.material = {
-		.color = vec3d{{ 0, 180, 180 }},
-		.k_ambient = 0.12,
-		.k_diffuse = 1,
-		.k_specular = 255,
-		.fallout = 256
-	};
-
-	std::array<surface *, 3> scene{{ &dunce, &ground, &ball }};
-
-	image.create(window_width, window_height, sf::Color(0, 0, 0, 0)); // init to 100% transparent
-	window.clear(sf::Color::White);
-
-	// trace those rays!
-	for (size_t x = 0; x < window_width; ++x)
+	auto &lights = world.lights;
+	auto &scene = world.objects;
+
+	// lookdev edits these when the scene has them
+	surface *ball = world.find("ball");
+	surface *ground = world.find("ground");
+
+	ray_stats rays;
+	sf::Image sample_counts; // samples per pixel, for --aa-counts
+	profiler prof({ "trace", "lighting", "upload", "present" });
+	stats_overlay overlay;
+	bool show_stats = false;
+
+	if (interactive)
 	{
-		for (size_t y = 0; y < window_height; ++y)
+		fly_camera cam(eye, gaze, up);
+		resolution_scaler scaler(target_ms);
+
+		// what mvp and inv were last built for, they're only rebuilt when one of these changes
+		uint64_t built_version = cam.version();
+		size_t built_width = window_width, built_height = window_height;
+
+		auto rebuild = [&](size_t width, size_t height)
+		{
+			if (cam.version() == built_version && width == built_width && height == built_height)
+				return;
+
+			mvp = screen(1.0 * width, 1.0 * height) * mp * cam.view();
+			inv = invert(mvp);
+
+			built_version = cam.version();
+			built_width = width;
+			built_height = height;
+		};
+
+		// full resolution render in the background once the camera stops
+		auto start_still = [&]()
 		{
-			// screen space
-			vec4d ray_end{{ 1.0 * x, 1.0 * y, 1, 1 }};
+			rebuild(window_width, window_height);
+
+			return std::make_unique<progressive_render>(window_width, window_height,
+				[&scene, &lights, &options, eye = cam.eye(), inv = inv](size_t x, size_t y) -> std::optional<sf::Color>
+				{
+					auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0);
+					auto sample = trace_ray(scene, lights, eye, inv, 1.0 * x, 1.0 * y, options, nullptr, key);
+
+					if (!sample.obj)
+						return {};
+
+					return pixel_color(sample.color);
+				}, threads);
+		};
+
+		auto still = start_still();
+		uint64_t shown_version = cam.version(); // camera the image on screen was traced for
+		bool still_shown = false; // the texture holds the full resolution image
+
+		std::vector<sf::Uint8> pixels;
+		bool dragging = false;
+		sf::Vector2i mouse;
+
+		window.setFramerateLimit(60);
+		auto last = std::chrono::steady_clock::now();
+
+		while (window.isOpen())
+		{
+			prof.begin_frame();
+
+			auto now = std::chrono::steady_clock::now();
+			double dt = std::chrono::duration<double>(now - last).count();
+			last = now;
+
+			sf::Event event;
+			while (window.pollEvent(event))
+			{
+				if (event.type == sf::Event::Closed ||
+				   (event.type == sf::Event::KeyPressed &&
+					event.key.code == sf::Keyboard::Q))
+				{
+					still.reset(); // stops its workers
+					window.close();
+				}
+
+				if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+					show_stats = !show_stats;
+
+				// dragging with the left button looks around
+				if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left)
+				{
+					dragging = true;
+					mouse = { event.mouseButton.x, event.mouseButton.y };
+				}
+
+				if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left)
+					dragging = false;
+
+				if (event.type == sf::Event::MouseMoved && dragging)
+				{
+					cam.turn(-look_speed * (event.mouseMove.x - mouse.x), -look_speed * (event.mouseMove.y - mouse.y));
+					mouse = { event.mouseMove.x, event.mouseMove.y };
+				}
+			}
 
-			// world space
-			auto ray_start_w = homo(eye);
-			auto ray_end_w = inv * ray_end;
+			if (!window.isOpen())
+				break;
 
-			// find intersection
-			auto intersection = find_intersection(scene, ray_start_w, ray_end_w);
-			if (!intersection)
-				continue;
+			// held keys fly
+			auto held = [](sf::Keyboard::Key key) { return sf::Keyboard::isKeyPressed(key) ? 1.0 : 0.0; };
 
-			auto hit = intersection.value();
+			double right = held(sf::Keyboard::D) - held(sf::Keyboard::A);
+			double rise = held(sf::Keyboard::Space) - held(sf::Keyboard::LShift);
+			double forward = held(sf::Keyboard::W) - held(sf::Keyboard::S);
+			if (right != 0 || rise != 0 || forward != 0)
+				cam.move(right * move_speed * dt, rise * move_speed * dt, forward * move_speed * dt);
 
-			// lighting computation
-			double ambient = hit.obj->material.k_ambient;
+			double yaw = held(sf::Keyboard::Left) - held(sf::Keyboard::Right);
+			double pitch = held(sf::Keyboard::Up) - held(sf::Keyboard::Down);
+			if (yaw != 0 || pitch != 0)
+				cam.turn(yaw * turn_speed * dt, pitch * turn_speed * dt);
 
-			vec3d s = norm(cart(bulb.position) - hit.world_pt);
-			double diffuse = bulb.intensity * hit.obj->material.k_diffuse * std::max(0.0, dot(s, hit.normal));
+			if (cam.version() != shown_version)
+			{
+				// moving, trace a frame small enough to keep up, and drop the full resolution one
+				still.reset();
+				still_shown = false;
+
+				size_t width = std::max<size_t>(1, static_cast<size_t>(std::round(window_width * scaler.scale)));
+				size_t height = std::max<size_t>(1, static_cast<size_t>(std::round(window_height * scaler.scale)));
+				rebuild(width, height);
 
-			vec3d ref = -s + hit.normal * 2 * dot(s, hit.normal);
-			vec3d v = norm(eye - hit.world_pt);
+				image.create(width, height, sf::Color(0, 0, 0, 0));
 
-			double specular = bulb.intensity * hit.obj->material.k_specular * std::pow(std::max(0.0, dot(ref, v)), hit.obj->material.fallout);
+				{
+					auto timer = prof.time(trace);
+					auto start = std::chrono::steady_clock::now();
 
-			auto r = static_cast<uint8_t>(clamp(std::round(diffuse * hit.obj->material.color.x() + ambient + specular), 255.0, 0.0));
-			auto g = static_cast<uint8_t>(clamp(std::round(diffuse * hit.obj->material.color.y() + ambient + specular), 255.0, 0.0));
-			auto b = static_cast<uint8_t>(clamp(std::round(diffuse * hit.obj->material.color.z() + ambient + specular), 255.0, 0.0));
+					prof.count(render(scene, lights, cam.eye(), inv, image, options));
+					scaler.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+				}
 
-			// trace those shadows!
-			auto obstruction = find_intersection(scene, bulb.position, homo(hit.world_pt));
-			if (obstruction)
+				{
+					auto timer = prof.time(upload);
+					texture.loadFromImage(image);
+					sprite.setTexture(texture, true);
+					sprite.setScale(1.0f * window_width / width, 1.0f * window_height / height);
+				}
+
+				shown_version = cam.version();
+			}
+			else if (!still)
+			{
+				still = start_still();
+			}
+
+			// keep the small frame up until the full resolution one has its first pass
+			if (still && still->passes_done() > 0)
 			{
-				auto pt = obstruction.value();
-				auto d = hit.world_pt - pt.world_pt;
-				if (dot(d, d) > std::numeric_limits<double>::epsilon())
+				auto timer = prof.time(upload);
+
+				if (still->snapshot(pixels) || !still_shown)
 				{
-					// obstructed
-					r = ambient * hit.obj->material.color.x();
-					g = ambient * hit.obj->material.color.y();
-					b = ambient * hit.obj->material.color.z();
+					if (!still_shown)
+					{
+						texture.create(window_width, window_height);
+						sprite.setTexture(texture, true);
+						sprite.setScale(1, 1);
+						still_shown = true;
+					}
+
+					texture.update(pixels.data());
 				}
 			}
 
-			// for debugging
-			// how that colorful sphere was made, I was checking its normals
-//		    uint8_t r = static_cast<uint8_t>(clamp(hit.normal.x() * 255, 255, 0));
-//		    uint8_t g = static_cast<uint8_t>(clamp(hit.normal.y() * 255, 255, 0));
-//		    uint8_t b = static_cast<uint8_t>(clamp(hit.normal.z() * 255, 255, 0));
+			{
+				auto timer = prof.time(present);
+				window.clear(sf::Color::White);
+				window.draw(sprite);
+				if (show_stats)
+					overlay.draw(window, prof);
+				window.display();
+			}
 
-			image.setPixel(x, y, sf::Color{ r, g, b, 255 });
+			prof.end_frame();
 		}
 	}
+	else if (path)
+	{
+		// a pixel's samples are jittered over it, and each gets its own random numbers from where it is and its number
+		progressive_accumulator job(window_width, window_height, [&](size_t x, size_t y, uint32_t n)
+		{
+			path_rng rng{ pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), n) };
+			double jx = rng.next(), jy = rng.next();
+
+			// the time is off the path's own numbers, so a scene that doesn't move traces the same paths as always
+			double time = random_unit(rng.key ^ 0x27d4eb2f, 0);
+
+			return follow_path(scene, lights, eye, inv, x + jx - 0.5, y + jy - 0.5, options, paths, rng, nullptr, time);
+		}, threads, path_samples);
+
+		texture.create(window_width, window_height);
+		sprite.setTexture(texture);
+		window.setFramerateLimit(30);
+
+		std::vector<sf::Uint8> pixels;
+		size_t shown_passes = 0;
+
+		while (window.isOpen())
+		{
+			prof.begin_frame();
+
+			sf::Event event;
+			while (window.pollEvent(event))
+			{
+				if (event.type == sf::Event::Closed ||
+				   (event.type == sf::Event::KeyPressed &&
+					event.key.code == sf::Keyboard::Q))
+					window.close();
+
+				if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+					show_stats = !show_stats;
+			}
+
+			if (!window.isOpen())
+				break;
+
+			{
+				auto timer = prof.time(upload);
+				if (job.snapshot(pixels))
+					texture.update(pixels.data());
+			}
+
+			if (job.passes_done() != shown_passes)
+			{
+				shown_passes = job.passes_done();
+				window.setTitle("pew pew pew (" + std::to_string(shown_passes) + " samples a pixel)");
+			}
+
+			{
+				auto timer = prof.time(present);
+				window.clear(sf::Color::White);
+				window.draw(sprite);
+				if (show_stats)
+					overlay.draw(window, prof);
+				window.display();
+			}
+
+			prof.end_frame();
+		}
+
+		if (!path_out.empty() && path_samples > 0)
+			job.wait();
+		else
+			job.cancel();
+
+		double seconds = job.seconds();
+		double per_second = job.samples_traced() / std::max(seconds, 1e-9);
 
-	texture.loadFromImage(image); // convert to texture
-	sprite.setTexture(texture); // convert to sprite
-	window.draw(sprite);
-	window.display();
+		char line[160];
+		std::snprintf(line, sizeof(line), "path traced %zu samples a pixel in %.2f s, %.0f samples/s, %.0f samples/s a thread (%zu threads)\n",
+			job.passes_done(), seconds, per_second, per_second / job.threads(), job.threads());
+		std::cout << line;
 
-	while (window.isOpen()) // poll for input while window is open
+		if (!path_out.empty())
+		{
+			job.snapshot(pixels);
+			image.create(window_width, window_height, pixels.data());
+
+			if (!image.saveToFile(path_out))
+				std::cerr << "can't write " << path_out << std::endl;
+		}
+	}
+	else if (progressive)
 	{
-		sf::Event event;
-		while (window.pollEvent(event))
+		// same rays as render(), without the anti-aliasing or the ray stats, they're not made for many threads
+		progressive_render job(window_width, window_height, [&](size_t x, size_t y) -> std::optional<sf::Color>
+		{
+			auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0);
+			auto sample = trace_ray(scene, lights, eye, inv, 1.0 * x, 1.0 * y, options, nullptr, key);
+
+			if (!sample.obj)
+				return {};
+
+			return pixel_color(sample.color);
+		}, threads);
+
+		texture.create(window_width, window_height);
+		sprite.setTexture(texture);
+		window.setFramerateLimit(30); // the workers need the cores more than the window does
+
+		std::vector<sf::Uint8> pixels;
+		size_t shown_passes = 0;
+
+		while (window.isOpen())
 		{
-			// if close button, or Q button pressed, close window gracefully
-			if (event.type == sf::Event::Closed ||
-			   (event.type == sf::Event::KeyPressed &&
-				event.key.code == sf::Keyboard::Q))
-				window.close();
+			prof.begin_frame();
+
+			sf::Event event;
+			while (window.pollEvent(event))
+			{
+				// closing stops the workers after the pixel they're on
+				if (event.type == sf::Event::Closed ||
+				   (event.type == sf::Event::KeyPressed &&
+					event.key.code == sf::Keyboard::Q))
+				{
+					job.cancel();
+					window.close();
+				}
+
+				if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::P)
+					show_stats = !show_stats;
+			}
+
+			if (!window.isOpen())
+				break;
+
+			{
+				auto timer = prof.time(upload);
+				if (job.snapshot(pixels))
+					texture.update(pixels.data());
+			}
+
+			if (job.passes_done() != shown_passes)
+			{
+				shown_passes = job.passes_done();
+				window.setTitle("pew pew pew (pass " + std::to_string(shown_passes) + "/" + std::to_string(job.passes()) + ")");
+			}
+
+			{
+				auto timer = prof.time(present);
+				window.clear(sf::Color::White);
+				window.draw(sprite);
+				if (show_stats)
+					overlay.draw(window, prof);
+				window.display();
+			}
+
+			prof.end_frame();
 		}
 	}
-	
-	return 0;
-}
+	else
+	{
+		// the primary rays, kept so lookdev edits only need the shading pass, anti-aliasing, wavefronts and lenses trace them every time instead
+		gbuffer gbuf;
+		bool blurred = lens_opts.aperture > 0 || std::any_of(scene.begin(), scene.end(), [](surface *obj) { return obj->moving(); });
+		bool deferred = options.aa_samples <= 1 && !wavefront && !blurred;
+		wavefront_stats waves;
+		lens_stats focus;
+		thin_lens lens(eye, gaze, up, inv, window_width, window_height, lens_opts);
+
+		// draws the frame, tracing the primary rays too if first, or only the dirty tiles, keeping the rest from the last frame
+		auto draw_frame = [&](bool first, const tile_mask *dirty = nullptr)
+		{
+			prof.begin_frame();
+			rays = {};
+			waves = {};
+			focus = {};
 
-double clamp(double v, double max, double min)
-{
-	return std::max(std::min(v, max), min);
-}
+			if (!dirty || !deferred)
+				image.create(window_width, window_height, sf::Color(0, 0, 0, 0)); // init to 100% transparent
 
-template<typename T, size_t N>
-vec<T, N> clamp(const vec<T, N> &v, double max, double min)
-{
-	vec<T, N> result;
+			if (wavefront)
+			{
+				auto timer = prof.time(trace);
+				prof.count(render_wavefront(scene, lights, eye, inv, image, options, &rays, &waves));
+			}
+			else if (blurred)
+			{
+				auto timer = prof.time(trace);
+				prof.count(render_lens(scene, lights, lens, image, options, &rays, &focus, counts_path.empty() ? nullptr : &sample_counts));
+			}
+			else if (!deferred)
+			{
+				auto timer = prof.time(trace);
+				prof.count(render(scene, lights, eye, inv, image, options, &rays, counts_path.empty() ? nullptr : &sample_counts));
+			}
+			else if (dirty)
+			{
+				auto timer = prof.time(trace);
+				prof.count(render_tiles(scene, lights, eye, inv, gbuf, image, *dirty, options, &rays));
+			}
+			else
+			{
+				if (first)
+				{
+					auto timer = prof.time(trace);
+					visibility_pass(scene, eye, inv, window_width, window_height, gbuf, &rays);
+				}
 
-	for (size_t i = 0; i < N; ++i)
-		result.at(i, 0) = clamp(v.at(i, 0), max, min);
+				auto timer = prof.time(lighting);
+				prof.count(shading_pass(scene, lights, eye, gbuf, image, options, &rays));
+			}
+
+			{
+				auto timer = prof.time(upload);
+				texture.loadFromImage(image); // convert to texture
+				sprite.setTexture(texture); // convert to sprite
+			}
+
+			{
+				auto timer = prof.time(present);
+				window.clear(sf::Color::White);
+				window.draw(sprite);
+				if (show_stats)
+					overlay.draw(window, prof);
+				window.display();
+			}
+
+			prof.end_frame();
+		};
+
+		auto frame_start = std::chrono::steady_clock::now();
+		draw_frame(true);
+		double full_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+
+		std::cout << rays.summary();
+		if (wavefront)
+			std::cout << waves.summary();
+		if (blurred)
+			std::cout << focus.summary();
+
+		if (!counts_path.empty() && !sample_counts.saveToFile(counts_path))
+			std::cerr << "can't write " << counts_path << std::endl;
+
+		if (!steps_path.empty())
+		{
+			sf::Image steps;
+			uint64_t total = steps_heatmap(scene, eye, inv, window_width, window_height, steps);
+
+			std::cout << "sdf steps " << total << ", " << 1.0 * total / (window_width * window_height) << " a pixel" << std::endl;
+			if (!steps.saveToFile(steps_path))
+				std::cerr << "can't write " << steps_path << std::endl;
+		}
+
+		while (window.isOpen()) // poll for input while window is open
+		{
+			sf::Event event;
+			while (window.pollEvent(event))
+			{
+				// if close button, or Q button pressed, close window gracefully
+				if (event.type == sf::Event::Closed ||
+				   (event.type == sf::Event::KeyPressed &&
+					event.key.code == sf::Keyboard::Q))
+					window.close();
+
+				if (event.type != sf::Event::KeyPressed)
+					continue;
+
+				// the scene is static, only redraw when the overlay is toggled
+				if (event.key.code == sf::Keyboard::P)
+				{
+					show_stats = !show_stats;
+
+					window.clear(sf::Color::White);
+					window.draw(sprite);
+					if (show_stats)
+						overlay.draw(window, prof);
+					window.display();
+				}
 
-	return result;
+				// lookdev, arrows move the light, +/- make it brighter or dimmer, R makes the ground a mirror or not
+				bool edited = true;
+				switch (event.key.code)
+				{
+				case sf::Keyboard::Left: lights.x[0] -= 10; break;
+				case sf::Keyboard::Right: lights.x[0] += 10; break;
+				case sf::Keyboard::Up: lights.z[0] -= 10; break;
+				case sf::Keyboard::Down: lights.z[0] += 10; break;
+				case sf::Keyboard::Add: lights.intensity[0] *= 1.25; break;
+				case sf::Keyboard::Subtract: lights.intensity[0] /= 1.25; break;
+				case sf::Keyboard::R:
+					if (!ground)
+						continue;
+					ground->material.k_reflect = ground->material.k_reflect > 0 ? 0 : 0.4;
+					break;
+				default: edited = false;
+				}
+
+				if (edited)
+				{
+					lights.build_tree();
+					draw_frame(false);
+					std::cout << rays.summary();
+				}
+
+				// IJKL move the ball, only the tiles it could show up or have been in are traced again
+				vec3d step{{ 0, 0, 0 }};
+				switch (event.key.code)
+				{
+				case sf::Keyboard::J: step = vec3d{{ -5, 0, 0 }}; break;
+				case sf::Keyboard::L: step = vec3d{{ 5, 0, 0 }}; break;
+				case sf::Keyboard::I: step = vec3d{{ 0, 0, -5 }}; break;
+				case sf::Keyboard::K: step = vec3d{{ 0, 0, 5 }}; break;
+				default: continue;
+				}
+
+				if (!ball)
+					continue;
+
+				auto before = ball->world_bounds();
+				ball->transforms = translate(step.x(), step.y(), step.z()) * ball->transforms;
+				if (ball->moving())
+					ball->move_to(translate(step.x(), step.y(), step.z()) * ball->end_transforms);
+				auto dirty = dirty_tiles(scene, lights, mvp, window_width, window_height, before, ball->world_bounds());
+
+				auto edit_start = std::chrono::steady_clock::now();
+				draw_frame(false, &dirty);
+				double edit_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - edit_start).count();
+
+				if (deferred)
+				{
+					char line[128];
+					std::snprintf(line, sizeof(line), "re-traced %zu of %zu tiles (%.1f%% reused) in %.2f ms, %.2f ms saved\n",
+						dirty.count(), dirty.size(), 100.0 * (dirty.size() - dirty.count()) / dirty.size(), edit_ms, full_ms - edit_ms);
+					std::cout << line;
+				}
+
+				std::cout << rays.summary();
+			}
+		}
+	}
+
+	if (!csv_path.empty() && !prof.dump_csv(csv_path))
+		std::cerr << "can't write " << csv_path << std::endl;
+
+#if defined(ENABLE_TRACING)
+	if (!trace_path.empty() && !write_trace(trace_path))
+		std::cerr << "can't write " << trace_path << std::endl;
+#else
+	if (!trace_path.empty())
+		std::cerr << "tracing is compiled out, rebuild with ENABLE_TRACING defined" << std::endl;
+#endif
+	
+	return 0;
 }
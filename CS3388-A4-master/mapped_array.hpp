@@ -0,0 +1,130 @@
+#ifndef A4_MAPPED_ARRAY_HPP
+#define A4_MAPPED_ARRAY_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// an array of Ts that's either its own, or points at ones kept somewhere else that outlive it, like a mapped scene cache
+// reading is the same either way and never copies, only the calls that change it first copy what it points at into one
+// of its own, so those can't be made while other threads read it
+template<typename T>
+class mapped_array
+{
+public:
+	mapped_array() = default;
+
+	mapped_array(const mapped_array &other) : owned(other.owned), items(other.items), count(other.count), pointing(other.pointing)
+	{
+		if (!pointing)
+			sync();
+	}
+
+	mapped_array(mapped_array &&other) noexcept : owned(std::move(other.owned)), items(other.items), count(other.count), pointing(other.pointing)
+	{
+		if (!pointing)
+			sync();
+
+		other.pointing = false;
+		other.sync();
+	}
+
+	mapped_array &operator=(mapped_array other) noexcept
+	{
+		owned.swap(other.owned);
+		items = other.items;
+		count = other.count;
+		pointing = other.pointing;
+
+		if (!pointing)
+			sync();
+
+		return *this;
+	}
+
+	mapped_array &operator=(std::vector<T> &&v)
+	{
+		owned = std::move(v);
+		pointing = false;
+		sync();
+		return *this;
+	}
+
+	// points at count Ts from data on instead of holding any, they have to stay there for as long as this does
+	void point_at(const T *data, size_t n)
+	{
+		std::vector<T>().swap(owned);
+		items = data;
+		count = n;
+		pointing = true;
+	}
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const T *data() const { return items; }
+
+	const T &operator[](size_t i) const { return items[i]; }
+	const T &back() const { return items[count - 1]; }
+
+	const T *begin() const { return items; }
+	const T *end() const { return items + count; }
+
+	void push_back(const T &item)
+	{
+		own();
+		owned.push_back(item);
+		sync();
+	}
+
+	void resize(size_t n)
+	{
+		own();
+		owned.resize(n);
+		sync();
+	}
+
+	void clear()
+	{
+		std::vector<T>().swap(owned);
+		pointing = false;
+		sync();
+	}
+
+	void swap(std::vector<T> &v)
+	{
+		own();
+		owned.swap(v);
+		sync();
+	}
+
+	// its own Ts, to be written in place
+	T *writable()
+	{
+		own();
+		return owned.data();
+	}
+
+private:
+	std::vector<T> owned;
+	const T *items = nullptr;
+	size_t count = 0;
+	bool pointing = false; // at Ts it doesn't own
+
+	void sync()
+	{
+		items = owned.data();
+		count = owned.size();
+	}
+
+	void own()
+	{
+		if (!pointing)
+			return;
+
+		owned.assign(items, items + count);
+		pointing = false;
+		sync();
+	}
+};
+
+#endif //A4_MAPPED_ARRAY_HPP
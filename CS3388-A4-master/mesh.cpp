@@ -0,0 +1,295 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "mesh.hpp"
+#include "vector.hpp"
+
+size_t mesh::vertex_count() const
+{
+	return x.size();
+}
+
+size_t mesh::triangle_count() const
+{
+	return a.size();
+}
+
+uint32_t mesh::add_vertex(const vec3d &p)
+{
+	x.push_back(p.x());
+	y.push_back(p.y());
+	z.push_back(p.z());
+
+	return static_cast<uint32_t>(x.size() - 1);
+}
+
+uint32_t mesh::add_vertex(const vec3d &p, const vec3d &n)
+{
+	nx.push_back(n.x());
+	ny.push_back(n.y());
+	nz.push_back(n.z());
+
+	return add_vertex(p);
+}
+
+void mesh::add_triangle(uint32_t i, uint32_t j, uint32_t k)
+{
+	a.push_back(i);
+	b.push_back(j);
+	c.push_back(k);
+}
+
+void mesh::build(size_t threads)
+{
+	nodes.clear();
+	if (a.empty())
+		return;
+
+	std::vector<primitive_box> boxes(a.size());
+	const double *coords[3] = { x.data(), y.data(), z.data() };
+
+	for (size_t t = 0; t < boxes.size(); ++t)
+	{
+		auto &box = boxes[t];
+
+		for (size_t k = 0; k < 3; ++k)
+		{
+			double p = coords[k][a[t]], q = coords[k][b[t]], r = coords[k][c[t]];
+
+			box.lo[k] = std::min({ p, q, r });
+			box.hi[k] = std::max({ p, q, r });
+			box.center[k] = (p + q + r) / 3;
+		}
+	}
+
+	std::vector<uint32_t> order;
+	nodes = build_bvh(boxes, order, threads);
+
+	// triangles in leaf order, so a leaf reads its triangles in a row
+	auto reorder = [&](mapped_array<uint32_t> &v)
+	{
+		std::vector<uint32_t> sorted(v.size());
+		for (size_t i = 0; i < v.size(); ++i)
+			sorted[i] = v[order[i]];
+
+		v.swap(sorted);
+	};
+
+	reorder(a);
+	reorder(b);
+	reorder(c);
+}
+
+bounds mesh::model_bounds() const
+{
+	if (!nodes.empty())
+		return { vec3d{{ nodes[0].lo[0], nodes[0].lo[1], nodes[0].lo[2] }}, vec3d{{ nodes[0].hi[0], nodes[0].hi[1], nodes[0].hi[2] }} };
+
+	if (x.empty())
+		return { vec3d{{ 0, 0, 0 }}, vec3d{{ 0, 0, 0 }} };
+
+	bounds box{ vec3d{{ x[0], y[0], z[0] }}, vec3d{{ x[0], y[0], z[0] }} };
+	for (size_t i = 1; i < x.size(); ++i)
+		box.add(vec3d{{ x[i], y[i], z[i] }});
+
+	return box;
+}
+
+std::optional<hit> mesh::intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double)
+{
+	if (nodes.empty())
+		return {};
+
+	// ray warped into model space, t runs from 0 at the start to 1 at the end
+	auto start = cart(inv * ray_start);
+	auto dir = cart(inv * ray_end) - start;
+
+	const double o[3] = { start.x(), start.y(), start.z() };
+	const double d[3] = { dir.x(), dir.y(), dir.z() };
+
+	double best_t = std::numeric_limits<double>::infinity();
+	double best_u = 0, best_v = 0;
+	uint32_t best = 0;
+	bool found = false;
+
+	traverse(nodes, o, d, best_t, [&](uint32_t first, uint32_t count)
+	{
+		// Moller-Trumbore
+		for (uint32_t t = first; t < first + count; ++t)
+		{
+			uint32_t i = a[t], j = b[t], k = c[t];
+
+			double e1[3] = { x[j] - x[i], y[j] - y[i], z[j] - z[i] };
+			double e2[3] = { x[k] - x[i], y[k] - y[i], z[k] - z[i] };
+
+			double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+			double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+
+			// ray in the plane of the triangle
+			if (det == 0)
+				continue;
+
+			double inv_det = 1 / det;
+			double s[3] = { o[0] - x[i], o[1] - y[i], o[2] - z[i] };
+
+			double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+			if (u < 0 || u > 1)
+				continue;
+
+			double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+
+			double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+			if (v < 0 || u + v > 1)
+				continue;
+
+			double dist = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+			if (dist < 0 || dist >= best_t)
+				continue;
+
+			best_t = dist;
+			best_u = u;
+			best_v = v;
+			best = t;
+			found = true;
+		}
+	});
+
+	if (!found)
+		return {};
+
+	uint32_t i = a[best], j = b[best], k = c[best];
+	vec3d normal;
+
+	if (!nx.empty())
+	{
+		double w = 1 - best_u - best_v;
+		normal = vec3d{{
+			w * nx[i] + best_u * nx[j] + best_v * nx[k],
+			w * ny[i] + best_u * ny[j] + best_v * ny[k],
+			w * nz[i] + best_u * nz[j] + best_v * nz[k]
+		}};
+	}
+	else
+	{
+		vec3d e1{{ x[j] - x[i], y[j] - y[i], z[j] - z[i] }};
+		vec3d e2{{ x[k] - x[i], y[k] - y[i], z[k] - z[i] }};
+
+		// flat triangles have no outside, the side the ray came from is lit
+		normal = cross(e1, e2);
+		if (dot(normal, dir) > 0)
+			normal = normal * -1.0;
+	}
+
+	auto intersection = start + dir * best_t;
+
+	return {{
+		norm(cart(dir_to_world(transforms, homo(normal)))),
+		cart(transforms * homo(intersection)),
+		this
+	}};
+}
+
+void tessellate_sphere(mesh &out, size_t lat_divs, size_t long_divs)
+{
+	lat_divs = std::max<size_t>(lat_divs, 3);
+	long_divs = std::max<size_t>(long_divs, 2);
+
+	// rings of lat_divs vertices from pole to pole, the poles are a ring of the one point over and over
+	auto first = static_cast<uint32_t>(out.vertex_count());
+
+	for (size_t i = 0; i <= long_divs; ++i)
+	{
+		double phi = M_PI * i / long_divs;
+
+		for (size_t j = 0; j < lat_divs; ++j)
+		{
+			double theta = 2 * M_PI * j / lat_divs;
+			vec3d p{{ std::cos(theta) * std::sin(phi), std::sin(theta) * std::sin(phi), std::cos(phi) }};
+
+			out.add_vertex(p, p); // the normal of the unit sphere is the point
+		}
+	}
+
+	auto at = [&](size_t i, size_t j) { return first + static_cast<uint32_t>(i * lat_divs + j % lat_divs); };
+
+	for (size_t i = 0; i < long_divs; ++i)
+	{
+		for (size_t j = 0; j < lat_divs; ++j)
+		{
+			// the quads touching a pole are triangles
+			if (i != 0)
+				out.add_triangle(at(i, j), at(i + 1, j), at(i, j + 1));
+
+			if (i + 1 != long_divs)
+				out.add_triangle(at(i, j + 1), at(i + 1, j), at(i + 1, j + 1));
+		}
+	}
+}
+
+void tessellate_cone(mesh &out, size_t divs, size_t rings)
+{
+	divs = std::max<size_t>(divs, 3);
+	rings = std::max<size_t>(rings, 1);
+
+	// rings of divs vertices from the tip down, the normals are the ones of the cone surface
+	auto first = static_cast<uint32_t>(out.vertex_count());
+
+	for (size_t i = 0; i <= rings; ++i)
+	{
+		double r = 1.0 * i / rings;
+
+		for (size_t j = 0; j < divs; ++j)
+		{
+			double theta = 2 * M_PI * j / divs;
+			out.add_vertex(vec3d{{ r * std::sin(theta), 1 - r, r * std::cos(theta) }}, norm(vec3d{{ std::sin(theta), 1, std::cos(theta) }}));
+		}
+	}
+
+	auto at = [&](size_t i, size_t j) { return first + static_cast<uint32_t>(i * divs + j % divs); };
+
+	for (size_t i = 0; i < rings; ++i)
+	{
+		for (size_t j = 0; j < divs; ++j)
+		{
+			if (i != 0)
+				out.add_triangle(at(i, j), at(i + 1, j), at(i, j + 1));
+
+			out.add_triangle(at(i, j + 1), at(i + 1, j), at(i + 1, j + 1));
+		}
+	}
+}
+
+void tessellate_torus(mesh &out, double r_torus, double r_tube, size_t torus_divs, size_t tube_divs)
+{
+	torus_divs = std::max<size_t>(torus_divs, 3);
+	tube_divs = std::max<size_t>(tube_divs, 3);
+
+	// circles of tube_divs vertices around the tube, one after another around the ring
+	auto first = static_cast<uint32_t>(out.vertex_count());
+
+	for (size_t i = 0; i < torus_divs; ++i)
+	{
+		double u = 2 * M_PI * i / torus_divs;
+
+		for (size_t j = 0; j < tube_divs; ++j)
+		{
+			double v = 2 * M_PI * j / tube_divs;
+			vec3d n{{ std::cos(v) * std::cos(u), std::sin(v), std::cos(v) * std::sin(u) }};
+
+			out.add_vertex(vec3d{{ r_torus * std::cos(u), 0, r_torus * std::sin(u) }} + n * r_tube, n);
+		}
+	}
+
+	auto at = [&](size_t i, size_t j) { return first + static_cast<uint32_t>(i % torus_divs * tube_divs + j % tube_divs); };
+
+	for (size_t i = 0; i < torus_divs; ++i)
+	{
+		for (size_t j = 0; j < tube_divs; ++j)
+		{
+			out.add_triangle(at(i, j), at(i, j + 1), at(i + 1, j));
+			out.add_triangle(at(i + 1, j), at(i, j + 1), at(i + 1, j + 1));
+		}
+	}
+}
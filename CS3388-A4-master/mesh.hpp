@@ -0,0 +1,50 @@
+#ifndef A4_MESH_HPP
+#define A4_MESH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "bvh.hpp"
+#include "mapped_array.hpp"
+#include "surface.hpp"
+
+// a surface made of triangles, traced through a bounding volume hierarchy over them
+// vertices are kept one array per coordinate, triangles as three arrays of vertex indices
+// hits get the vertex normals interpolated across the triangle when there are some, the flat normal facing the ray otherwise
+// the arrays point straight into the scene cache when it's read from one
+struct mesh : surface
+{
+	mapped_array<double> x, y, z; // vertex positions
+	mapped_array<double> nx, ny, nz; // vertex normals, empty for flat triangles
+	mapped_array<uint32_t> a, b, c; // the vertices of each triangle, in the order of the leaves once built
+
+	mapped_array<bvh_node> nodes; // the hierarchy, empty until build()
+
+	size_t vertex_count() const;
+	size_t triangle_count() const;
+
+	// returns the index of the new vertex, either every vertex has a normal or none does
+	uint32_t add_vertex(const vec3d &p);
+	uint32_t add_vertex(const vec3d &p, const vec3d &n);
+
+	void add_triangle(uint32_t i, uint32_t j, uint32_t k);
+
+	// builds the hierarchy once every triangle is in, the top levels are split between threads (one per core by default)
+	void build(size_t threads = 0);
+
+	virtual bounds model_bounds() const;
+
+protected:
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time);
+};
+
+// adds the unit sphere as lat_divs x long_divs quads, with smooth normals
+void tessellate_sphere(mesh &out, size_t lat_divs, size_t long_divs);
+
+// adds the cone of the cone surface, tip at y = 1 and a base of radius 1 at y = 0, as divs slices of rings quads
+void tessellate_cone(mesh &out, size_t divs, size_t rings);
+
+// adds the torus of the torus surface as torus_divs slices around the ring of tube_divs quads around the tube
+void tessellate_torus(mesh &out, double r_torus, double r_tube, size_t torus_divs, size_t tube_divs);
+
+#endif //A4_MESH_HPP
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include "path.hpp"
+
+vec3d tint(const vec3d &a, const vec3d &b)
+{
+	return vec3d{{ a.x() * b.x(), a.y() * b.y(), a.z() * b.z() }};
+}
+
+// two directions square to n and each other, without a branch where n points along an axis, by Duff et al.
+static void basis(const vec3d &n, vec3d &a, vec3d &b)
+{
+	double sign = std::copysign(1.0, n.z());
+	double p = -1 / (sign + n.z());
+	double q = n.x() * n.y() * p;
+
+	a = vec3d{{ 1 + sign * n.x() * n.x() * p, sign * q, -sign * n.x() }};
+	b = vec3d{{ q, sign + n.y() * n.y() * p, -n.y() }};
+}
+
+// direction at cos_theta from axis, turned 2pi v around it
+static vec3d around(const vec3d &axis, double cos_theta, double v)
+{
+	vec3d a, b;
+	basis(axis, a, b);
+
+	double sin_theta = std::sqrt(std::max(0.0, 1 - cos_theta * cos_theta));
+	double phi = 2 * std::numbers::pi * v;
+
+	return a * (sin_theta * std::cos(phi)) + b * (sin_theta * std::sin(phi)) + axis * cos_theta;
+}
+
+vec3d sample_cosine(const vec3d &n, double u, double v)
+{
+	return around(n, std::sqrt(1 - u), v);
+}
+
+vec3d sample_lobe(const vec3d &r, double e, double u, double v)
+{
+	return around(r, std::pow(u, 1 / (e + 1)), v);
+}
+
+// d mirrored about n
+static vec3d mirrored(const vec3d &d, const vec3d &n)
+{
+	return n * (2 * dot(d, n)) - d;
+}
+
+path_material::path_material(const material &m) :
+	diffuse(clamp(m.color * (m.k_diffuse / 255), 1.0, 0.0)),
+	specular(clamp(m.k_specular / 255, 1.0, 0.0)),
+	mirror(clamp(m.k_reflect, 1.0, 0.0)),
+	exponent(std::max(m.fallout, 0.0))
+{
+	// the Phong terms of shade() aren't made to add up to 1, the A4 ones reflect twice what comes in
+	double total = std::max({ diffuse.x(), diffuse.y(), diffuse.z() }) + specular + mirror;
+	if (total > 1)
+	{
+		diffuse = diffuse / total;
+		specular /= total;
+		mirror /= total;
+	}
+}
+
+vec3d path_material::reflected(const vec3d &n, const vec3d &wi, const vec3d &wo) const
+{
+	double cos_i = dot(n, wi);
+	if (cos_i <= 0)
+		return vec3d{{ 0, 0, 0 }};
+
+	double lobe = 0;
+	if (specular > 0)
+	{
+		double c = std::max(0.0, dot(mirrored(wi, n), wo));
+		lobe = specular * (exponent + 2) / (2 * std::numbers::pi) * std::pow(c, exponent);
+	}
+
+	vec3d f = diffuse / std::numbers::pi + vec3d{{ lobe, lobe, lobe }};
+	return f * cos_i;
+}
+
+std::optional<path_bounce> sample_bounce(const path_material &m, const vec3d &n, const vec3d &wo, path_rng &rng)
+{
+	// a lobe is picked with the odds of what it reflects, and nothing with the odds of being absorbed
+	double p_diffuse = std::max({ m.diffuse.x(), m.diffuse.y(), m.diffuse.z() });
+	double pick = rng.next();
+	double u = rng.next(), v = rng.next();
+
+	if (pick < m.mirror)
+		return path_bounce{ mirrored(wo, n), vec3d{{ 1, 1, 1 }} };
+
+	pick -= m.mirror;
+	if (pick < p_diffuse)
+		return path_bounce{ sample_cosine(n, u, v), m.diffuse / p_diffuse };
+
+	pick -= p_diffuse;
+	if (pick < m.specular)
+	{
+		auto dir = sample_lobe(mirrored(wo, n), m.exponent, u, v);
+
+		// what the lobe reflects over its pdf leaves the cosine and a bit of the normalization
+		double cos_i = dot(dir, n);
+		if (cos_i <= 0)
+			return {};
+
+		double w = (m.exponent + 2) / (m.exponent + 1) * cos_i;
+		return path_bounce{ dir, vec3d{{ w, w, w }} };
+	}
+
+	return {};
+}
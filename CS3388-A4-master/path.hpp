@@ -0,0 +1,177 @@
+#ifndef A4_PATH_HPP
+#define A4_PATH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <numbers>
+#include <optional>
+
+#include "light.hpp"
+#include "material.hpp"
+#include "render.hpp"
+#include "surface.hpp"
+#include "vector.hpp"
+
+// Monte Carlo path tracing, light bouncing around the scene instead of a flat k_ambient
+// every hit is lit by the lights directly (next event estimation) and then the path bounces on in a direction picked from
+// the material, so light that reaches a surface off another one is counted too
+// lights aren't surfaces, no bounce can hit one, so their light only ever comes in through the direct part, once
+
+// how far paths go
+struct path_options
+{
+	size_t max_bounces = 8; // a path ends after this many bounces whatever the roulette says
+	size_t roulette_after = 3; // bounces every path gets before Russian roulette can end it
+};
+
+// random numbers of one path, counter based so a path gets the same numbers whichever thread traces it
+struct path_rng
+{
+	uint32_t key; // which pixel and sample, see pixel_seed()
+	uint32_t counter = 0;
+
+	double next() { return random_unit(key, counter++); }
+};
+
+// a and b multiplied channel by channel
+vec3d tint(const vec3d &a, const vec3d &b);
+
+// direction about n for the uniform numbers u and v, cosine weighted over the hemisphere, its pdf is cos / pi
+vec3d sample_cosine(const vec3d &n, double u, double v);
+
+// direction about r for the uniform numbers u and v, spread like cos^e of the angle to r, its pdf is (e + 1) / 2pi cos^e
+vec3d sample_lobe(const vec3d &r, double e, double u, double v);
+
+// a material as what it reflects, 0 to 1 of what comes in
+// a Lambert diffuse of k_diffuse times the color, a normalized Phong lobe of k_specular / 255 with fallout as its exponent,
+// and a mirror of k_reflect, all scaled down together where they'd add up to more light than came in
+struct path_material
+{
+	vec3d diffuse;
+	double specular, mirror;
+	double exponent;
+
+	explicit path_material(const material &m);
+
+	// what leaves along wo of light coming in from wi, cosine included, the mirror left out, n faces wo
+	vec3d reflected(const vec3d &n, const vec3d &wi, const vec3d &wo) const;
+};
+
+// a bounce picked from a material, the weight is what's reflected over the odds of picking the direction
+struct path_bounce
+{
+	vec3d dir;
+	vec3d weight;
+};
+
+// picks the direction a path leaving along wo came in from, one lobe chosen by how much it reflects, nothing when the
+// path ends there, absorbed or sent under the surface
+std::optional<path_bounce> sample_bounce(const path_material &m, const vec3d &n, const vec3d &wo, path_rng &rng);
+
+// light arriving at a hit from lights.sample_point(i), as the light at one point, and what of it leaves along wo
+// intensity I is taken to be pi I coming in face on, so a white diffuse surface facing a light of 1 is as bright as in shade()
+// the shadow ray is at time in the shutter
+template<typename C>
+vec3d light_from(const C &scene, const light_list &lights, size_t i, const vec3d &pt, const vec3d &n, const vec3d &wo,
+	const path_material &m, path_rng &rng, ray_stats *stats, double time = 0)
+{
+	double s = rng.next(), t = rng.next();
+	auto from = lights.shapes[i].kind == light_kind::point ? lights.position(i) : lights.sample_point(i, pt, s, t);
+
+	vec3d wi = norm(from - pt);
+	if (dot(wi, n) <= 0)
+		return vec3d{{ 0, 0, 0 }};
+
+	auto f = m.reflected(n, wi, wo);
+	if (std::max({ f.x(), f.y(), f.z() }) <= 0)
+		return vec3d{{ 0, 0, 0 }};
+
+	if (stats)
+		stats->shadow_rays += 1;
+
+	if (!reaches(scene, from, pt, time))
+		return vec3d{{ 0, 0, 0 }};
+
+	return f * (std::numbers::pi * lights.intensity[i]);
+}
+
+// light reaching a hit straight from the lights, a shadow ray for each
+// all of them, or options.light_samples picked from the light tree when it has one
+template<typename C>
+vec3d direct_light(const C &scene, const light_list &lights, const vec3d &pt, const vec3d &n, const vec3d &wo, const path_material &m,
+	const render_options &options, path_rng &rng, ray_stats *stats, double time = 0)
+{
+	vec3d sum{{ 0, 0, 0 }};
+
+	if (options.light_samples > 0 && !lights.nodes.empty())
+	{
+		for (size_t k = 0; k < options.light_samples; ++k)
+		{
+			auto [i, pdf] = lights.sample(pt, n, rng.next());
+			sum = sum + light_from(scene, lights, i, pt, n, wo, m, rng, stats, time) / (options.light_samples * pdf);
+		}
+
+		return sum;
+	}
+
+	for (size_t i = 0; i < lights.size(); ++i)
+		sum = sum + light_from(scene, lights, i, pt, n, wo, m, rng, stats, time);
+
+	return sum;
+}
+
+// light coming back along the ray through the screen coords (x, y), channels 0 to 255 like shade() but not clamped
+// the path bounces until it leaves the scene, is absorbed, reaches paths.max_bounces, or loses the Russian roulette,
+// which past paths.roulette_after bounces ends it with the odds it has of mattering, and makes up for that in the ones it keeps
+// every ray of the path is at time in the shutter
+template<typename C>
+vec3d follow_path(const C &scene, const light_list &lights, const vec3d &eye, const mat4d &inv, double x, double y,
+	const render_options &options, const path_options &paths, path_rng &rng, ray_stats *stats = nullptr, double time = 0)
+{
+	vec3d radiance{{ 0, 0, 0 }};
+	vec3d throughput{{ 1, 1, 1 }}; // what of the light found from here on makes it back to the eye
+
+	vec3d origin = eye;
+	auto current = find_intersection(scene, homo(eye), inv * vec4d{{ x, y, 1, 1 }}, time);
+
+	if (stats)
+		stats->rays[0] += 1;
+
+	for (size_t bounce = 0; current; ++bounce)
+	{
+		path_material m(current->obj->material);
+
+		vec3d wo = norm(origin - current->world_pt);
+		vec3d n = dot(wo, current->normal) < 0 ? -current->normal : current->normal;
+
+		radiance = radiance + tint(throughput, direct_light(scene, lights, current->world_pt, n, wo, m, options, rng, stats, time));
+
+		if (bounce == paths.max_bounces)
+			break;
+
+		auto next = sample_bounce(m, n, wo, rng);
+		if (!next)
+			break;
+
+		throughput = tint(throughput, next->weight);
+
+		if (bounce >= paths.roulette_after)
+		{
+			double keep = std::min(std::max({ throughput.x(), throughput.y(), throughput.z() }), 0.95);
+			if (rng.next() >= keep)
+				break;
+
+			throughput = throughput / keep;
+		}
+
+		origin = current->world_pt + n * reflect_offset;
+		current = find_intersection(scene, homo(origin), homo(origin + next->dir), time);
+
+		if (stats)
+			stats->rays[std::min(bounce + 1, ray_stats::max_depths - 1)] += 1;
+	}
+
+	return radiance * 255.0;
+}
+
+#endif //A4_PATH_HPP
@@ -1,11 +1,10 @@
+#include <limits>
 #include <vector>
 
 #include "plane.hpp"
 
-std::optional<hit> plane::intersect(const vec4d &ray_start, const vec4d &ray_end)
+std::optional<hit> plane::intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double)
 {
-	auto inv = invert(transforms);
-
 	// ray warped into model space
 	auto start = cart(inv * ray_start);
 	auto end = cart(inv * ray_end);
@@ -40,3 +39,40 @@ std::optional<hit> plane::intersect(const vec4d &ray_start, const vec4d &ray_end
 
 	return {};
 }
+
+bounds plane::model_bounds() const
+{
+	return { vec3d{{ -1, -1, 0 }}, vec3d{{ 1, 1, 0 }} }; // the 2x2 square on z = 0
+}
+
+// as a solid, a plane is the half space behind it, z <= 0
+bounds plane::solid_bounds() const
+{
+	// far enough to take in any scene, and finite so transforming the box doesn't make NaNs
+	const double far_away = 1e30;
+	return { vec3d{{ -far_away, -far_away, -far_away }}, vec3d{{ far_away, far_away, 0 }} };
+}
+
+bool plane::model_spans(const vec3d &start, const vec3d &dir, span_list &out)
+{
+	const double inf = std::numeric_limits<double>::infinity();
+	const vec3d up{{ 0, 0, 1 }};
+
+	// parallel, either always behind it or never
+	if (dir.z() == 0)
+	{
+		if (start.z() <= 0)
+			out.push({ -inf, inf, up, up, this, this });
+
+		return true;
+	}
+
+	double t = -start.z() / dir.z();
+
+	if (dir.z() > 0)
+		out.push({ -inf, t, up, up, this, this });
+	else
+		out.push({ t, inf, up, up, this, this });
+
+	return true;
+}
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "progressive.hpp"
+#include "../common/trace.hpp"
+
+static const size_t tile_size = 32;
+
+// passes of a block size, 8 goes 8, 4, 2, 1
+static size_t count_passes(size_t block)
+{
+	size_t n = 1;
+	for (; block > 1; block /= 2)
+		n += 1;
+
+	return n;
+}
+
+// threads 0 is one per core
+static size_t worker_count(size_t threads)
+{
+	return threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+progressive_render::progressive_render(size_t width, size_t height, trace_fn trace, size_t threads, size_t block) :
+	width(width),
+	height(height),
+	block(std::clamp<size_t>(std::bit_floor(std::max<size_t>(block, 1)), 1, tile_size)),
+	tiles_x((width + tile_size - 1) / tile_size),
+	tile_count(tiles_x * ((height + tile_size - 1) / tile_size)),
+	pass_count(count_passes(this->block)),
+	trace(std::move(trace)),
+	pixels(width * height),
+	sync(static_cast<std::ptrdiff_t>(worker_count(threads)), next_pass{ this })
+{
+	for (size_t i = 0; i < worker_count(threads); ++i)
+		workers.emplace_back([this] { work(); });
+}
+
+progressive_render::~progressive_render()
+{
+	cancel();
+}
+
+void progressive_render::cancel()
+{
+	cancelled = true;
+
+	for (auto &worker : workers)
+		if (worker.joinable())
+			worker.join();
+}
+
+size_t progressive_render::passes() const
+{
+	return pass_count;
+}
+
+size_t progressive_render::passes_done() const
+{
+	return std::min(pass.load(), pass_count);
+}
+
+bool progressive_render::done() const
+{
+	return pass >= pass_count;
+}
+
+bool progressive_render::snapshot(std::vector<sf::Uint8> &rgba)
+{
+	size_t now = traced;
+	if (now == copied && rgba.size() == 4 * pixels.size())
+		return false;
+
+	copied = now;
+	rgba.resize(4 * pixels.size());
+
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		uint32_t c = pixels[i].load(std::memory_order_relaxed);
+
+		rgba[4 * i] = static_cast<sf::Uint8>(c);
+		rgba[4 * i + 1] = static_cast<sf::Uint8>(c >> 8);
+		rgba[4 * i + 2] = static_cast<sf::Uint8>(c >> 16);
+		rgba[4 * i + 3] = static_cast<sf::Uint8>(c >> 24);
+	}
+
+	return true;
+}
+
+void progressive_render::next_pass::operator()() noexcept
+{
+	render->next_tile = 0;
+	render->pass += 1;
+}
+
+void progressive_render::work()
+{
+	for (size_t current = pass; current < pass_count; current = pass)
+	{
+		for (size_t tile = next_tile++; tile < tile_count; tile = next_tile++)
+		{
+			if (!trace_tile(tile, current))
+			{
+				// the others may be waiting on this one at the end of the pass
+				sync.arrive_and_drop();
+				return;
+			}
+
+			traced += 1;
+		}
+
+		sync.arrive_and_wait();
+	}
+}
+
+bool progressive_render::trace_tile(size_t tile, size_t current)
+{
+	TRACE_TILE(static_cast<int32_t>(tile));
+	TRACE_ZONE("progressive tile");
+
+	const size_t b = block >> current;
+	const size_t tx = (tile % tiles_x) * tile_size, ty = (tile / tiles_x) * tile_size;
+
+	for (size_t y = ty; y < std::min(ty + tile_size, height); y += b)
+	{
+		for (size_t x = tx; x < std::min(tx + tile_size, width); x += b)
+		{
+			// traced by a coarser pass already
+			if (current > 0 && x % (2 * b) == 0 && y % (2 * b) == 0)
+				continue;
+
+			if (cancelled)
+				return false;
+
+			auto color = trace(x, y);
+
+			uint32_t packed = 0;
+			if (color)
+				packed = color->r | color->g << 8 | color->b << 16 | static_cast<uint32_t>(color->a) << 24;
+
+			fill(x, y, b, packed);
+		}
+	}
+
+	return true;
+}
+
+void progressive_render::fill(size_t x, size_t y, size_t b, uint32_t color)
+{
+	for (size_t j = y; j < std::min(y + b, height); ++j)
+		for (size_t i = x; i < std::min(x + b, width); ++i)
+			pixels[j * width + i].store(color, std::memory_order_relaxed);
+}
+
+progressive_accumulator::progressive_accumulator(size_t width, size_t height, sample_fn sample, size_t threads, size_t samples) :
+	width(width),
+	height(height),
+	max_passes(samples),
+	tiles_x((width + tile_size - 1) / tile_size),
+	tile_count(tiles_x * ((height + tile_size - 1) / tile_size)),
+	sample(std::move(sample)),
+	sums(width * height, vec3d{{ 0, 0, 0 }}),
+	pixels(width * height),
+	sync(static_cast<std::ptrdiff_t>(worker_count(threads)), next_pass{ this })
+{
+	for (size_t i = 0; i < worker_count(threads); ++i)
+		workers.emplace_back([this] { work(); });
+}
+
+progressive_accumulator::~progressive_accumulator()
+{
+	cancel();
+}
+
+void progressive_accumulator::cancel()
+{
+	cancelled = true;
+	wait();
+}
+
+void progressive_accumulator::wait()
+{
+	for (auto &worker : workers)
+		if (worker.joinable())
+			worker.join();
+}
+
+size_t progressive_accumulator::threads() const
+{
+	return workers.size();
+}
+
+size_t progressive_accumulator::passes_done() const
+{
+	return max_passes ? std::min(pass.load(), max_passes) : pass.load();
+}
+
+bool progressive_accumulator::done() const
+{
+	return max_passes && pass >= max_passes;
+}
+
+size_t progressive_accumulator::samples_traced() const
+{
+	return traced;
+}
+
+double progressive_accumulator::seconds() const
+{
+	auto end = finished ? started + clock::duration(finished) : clock::now();
+
+	return std::chrono::duration<double>(end - started).count();
+}
+
+bool progressive_accumulator::snapshot(std::vector<sf::Uint8> &rgba)
+{
+	size_t now = traced;
+	if (now == copied && rgba.size() == 4 * pixels.size())
+		return false;
+
+	copied = now;
+	rgba.resize(4 * pixels.size());
+
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		uint32_t c = pixels[i].load(std::memory_order_relaxed);
+
+		rgba[4 * i] = static_cast<sf::Uint8>(c);
+		rgba[4 * i + 1] = static_cast<sf::Uint8>(c >> 8);
+		rgba[4 * i + 2] = static_cast<sf::Uint8>(c >> 16);
+		rgba[4 * i + 3] = static_cast<sf::Uint8>(c >> 24);
+	}
+
+	return true;
+}
+
+void progressive_accumulator::next_pass::operator()() noexcept
+{
+	render->next_tile = 0;
+	render->pass += 1;
+
+	if (render->pass == render->max_passes)
+		render->finished = (clock::now() - render->started).count();
+}
+
+void progressive_accumulator::work()
+{
+	for (size_t current = pass; !max_passes || current < max_passes; current = pass)
+	{
+		for (size_t tile = next_tile++; tile < tile_count; tile = next_tile++)
+		{
+			if (!trace_tile(tile, current))
+			{
+				sync.arrive_and_drop();
+				return;
+			}
+		}
+
+		sync.arrive_and_wait();
+	}
+}
+
+bool progressive_accumulator::trace_tile(size_t tile, size_t current)
+{
+	TRACE_TILE(static_cast<int32_t>(tile));
+	TRACE_ZONE("accumulate tile");
+
+	const size_t tx = (tile % tiles_x) * tile_size, ty = (tile / tiles_x) * tile_size;
+	const double scale = 1.0 / (current + 1);
+	size_t count = 0;
+
+	for (size_t y = ty; y < std::min(ty + tile_size, height); ++y)
+	{
+		for (size_t x = tx; x < std::min(tx + tile_size, width); ++x)
+		{
+			if (cancelled)
+			{
+				traced += count;
+				return false;
+			}
+
+			auto &sum = sums[y * width + x];
+			sum = sum + sample(x, y, static_cast<uint32_t>(current));
+
+			auto channel = [&](double v) { return static_cast<uint32_t>(std::clamp(std::round(v * scale), 0.0, 255.0)); };
+			uint32_t packed = channel(sum.x()) | channel(sum.y()) << 8 | channel(sum.z()) << 16 | 255u << 24;
+
+			pixels[y * width + x].store(packed, std::memory_order_relaxed);
+			count += 1;
+		}
+	}
+
+	traced += count;
+	return true;
+}
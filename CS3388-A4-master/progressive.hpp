@@ -0,0 +1,156 @@
+#ifndef A4_PROGRESSIVE_HPP
+#define A4_PROGRESSIVE_HPP
+
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "vector.hpp"
+
+// traces an image on worker threads in passes, so something shows up long before the whole frame is done
+// the first pass traces every block-th pixel and fills the block it starts, each pass after halves the blocks and
+// traces only the pixels the passes before didn't, down to single pixels, so the last pass leaves the full image
+// the pixels are kept in atomics, so the window can copy them out at any time while the workers keep going
+class progressive_render
+{
+public:
+	// color of the pixel (x, y), nothing if the ray hits nothing, called from the worker threads at the same time
+	using trace_fn = std::function<std::optional<sf::Color>(size_t x, size_t y)>;
+
+	// starts tracing right away, threads 0 is one per core, block has to be a power of 2 no bigger than 32
+	progressive_render(size_t width, size_t height, trace_fn trace, size_t threads = 0, size_t block = 8);
+
+	// cancels whatever is left
+	~progressive_render();
+
+	progressive_render(const progressive_render &) = delete;
+	progressive_render &operator=(const progressive_render &) = delete;
+
+	// stops every worker after the pixel it's on, and waits for them
+	void cancel();
+
+	size_t passes() const;
+
+	// passes every worker is done with
+	size_t passes_done() const;
+
+	bool done() const;
+
+	// copies the image so far into rgba, 4 bytes a pixel like sf::Texture::update() takes
+	// returns false, leaving rgba alone, if nothing was traced since the last copy
+	bool snapshot(std::vector<sf::Uint8> &rgba);
+
+private:
+	const size_t width, height, block;
+	const size_t tiles_x, tile_count, pass_count;
+	trace_fn trace;
+
+	std::vector<std::atomic<uint32_t>> pixels; // rgba packed r first, 0 is transparent
+	std::atomic<size_t> traced{ 0 }; // tiles traced, over every pass
+	size_t copied = 0; // traced at the last snapshot
+
+	std::atomic<size_t> next_tile{ 0 }; // next tile of the pass a worker should take
+	std::atomic<size_t> pass{ 0 };
+	std::atomic<bool> cancelled{ false };
+
+	// resets the tiles and moves on to the next pass once every worker is done with the current one
+	struct next_pass
+	{
+		progressive_render *render;
+		void operator()() noexcept;
+	};
+	std::barrier<next_pass> sync;
+
+	std::vector<std::thread> workers;
+
+	void work();
+
+	// traces the pixels of tile that are new in pass, returns false if cancelled partway
+	bool trace_tile(size_t tile, size_t pass);
+
+	// sets the pixels of the b x b block at (x, y)
+	void fill(size_t x, size_t y, size_t b, uint32_t color);
+};
+
+// traces an image on worker threads a sample a pixel at a time, adding every pass into a running sum per pixel
+// so it starts out noisy and clears up the longer it runs, what's shown is the average of the samples so far
+// the pixel sums are only touched by the worker with their tile, the averages are kept in atomics for the window
+class progressive_accumulator
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	// sample number n of the pixel (x, y), channels from 0 to 255 but allowed over, called from the worker threads at the same time
+	// what a sample comes to should only depend on x, y and n, so the image is the same however many threads trace it
+	using sample_fn = std::function<vec3d(size_t x, size_t y, uint32_t n)>;
+
+	// starts tracing right away, threads 0 is one per core, stops on its own after samples passes, or never if it's 0
+	progressive_accumulator(size_t width, size_t height, sample_fn sample, size_t threads = 0, size_t samples = 0);
+
+	// cancels whatever is left
+	~progressive_accumulator();
+
+	progressive_accumulator(const progressive_accumulator &) = delete;
+	progressive_accumulator &operator=(const progressive_accumulator &) = delete;
+
+	// stops every worker after the pixel it's on, and waits for them
+	void cancel();
+
+	// waits for the workers to finish every pass, only ever returns if there's a number of them
+	void wait();
+
+	size_t threads() const;
+
+	// samples every pixel has
+	size_t passes_done() const;
+
+	bool done() const;
+
+	// samples traced, over every pixel, and seconds from the start to now or to when the last pass was done
+	size_t samples_traced() const;
+	double seconds() const;
+
+	// copies the average so far into rgba, 4 bytes a pixel like sf::Texture::update() takes
+	// returns false, leaving rgba alone, if nothing was traced since the last copy
+	bool snapshot(std::vector<sf::Uint8> &rgba);
+
+private:
+	const size_t width, height, max_passes;
+	const size_t tiles_x, tile_count;
+	sample_fn sample;
+
+	std::vector<vec3d> sums;
+	std::vector<std::atomic<uint32_t>> pixels; // the averages, rgba packed r first, opaque
+	std::atomic<size_t> traced{ 0 }; // samples traced, over every pixel and pass
+	size_t copied = 0; // traced at the last snapshot
+
+	std::atomic<size_t> next_tile{ 0 };
+	std::atomic<size_t> pass{ 0 };
+	std::atomic<bool> cancelled{ false };
+
+	const clock::time_point started = clock::now();
+	std::atomic<clock::rep> finished{ 0 }; // ticks from started to the end of the last pass, 0 until then
+
+	struct next_pass
+	{
+		progressive_accumulator *render;
+		void operator()() noexcept;
+	};
+	std::barrier<next_pass> sync;
+
+	std::vector<std::thread> workers;
+
+	void work();
+
+	// adds sample pass of every pixel of tile, returns false if cancelled partway
+	bool trace_tile(size_t tile, size_t pass);
+};
+
+#endif //A4_PROGRESSIVE_HPP
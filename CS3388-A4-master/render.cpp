@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "render.hpp"
+
+double clamp(double v, double max, double min)
+{
+	return std::max(std::min(v, max), min);
+}
+
+std::pair<double, double> light_terms(const light_list &lights, size_t i, const hit &hit, const vec3d &v)
+{
+	const auto &mat = hit.obj->material;
+
+	vec3d s = norm(lights.position(i) - hit.world_pt);
+	double sn = dot(s, hit.normal);
+
+	vec3d ref = -s + hit.normal * 2 * sn;
+
+	double diffuse = lights.intensity[i] * mat.k_diffuse * std::max(0.0, sn);
+	double specular = lights.intensity[i] * mat.k_specular * std::pow(std::max(0.0, dot(ref, v)), mat.fallout);
+
+	return { diffuse, specular };
+}
+
+vec3d combine(const material &mat, const vec3d &lit, double spec, bool reached)
+{
+	double ambient = mat.k_ambient;
+
+	if (!reached)
+	{
+		return vec3d{{
+			std::trunc(ambient * mat.color.x()),
+			std::trunc(ambient * mat.color.y()),
+			std::trunc(ambient * mat.color.z())
+		}};
+	}
+
+	return vec3d{{
+		clamp(std::round(lit.x() + ambient + spec), 255.0, 0.0),
+		clamp(std::round(lit.y() + ambient + spec), 255.0, 0.0),
+		clamp(std::round(lit.z() + ambient + spec), 255.0, 0.0)
+	}};
+}
+
+bool rounds_up(const material &mat, const vec3d &lit, double spec, double extra)
+{
+	for (size_t c = 0; c < 3; ++c)
+	{
+		double level = lit.at(c, 0) + mat.k_ambient + spec;
+		if (std::min(std::round(level), 255.0) != std::min(std::round(level + extra), 255.0))
+			return true;
+	}
+
+	return false;
+}
+
+// lowbias32 integer hash by Chris Wellons
+static uint32_t hash32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+
+	return x;
+}
+
+uint32_t random_bits(uint32_t key, uint32_t counter)
+{
+	return hash32(key ^ hash32(counter + 0x9e3779b9));
+}
+
+double random_unit(uint32_t key, uint32_t counter)
+{
+	return random_bits(key, counter) * (1.0 / 4294967296.0);
+}
+
+std::pair<double, double> sobol_2d(uint32_t i, uint32_t scramble_s, uint32_t scramble_t)
+{
+	// first dimension is van der Corput, the bits of i mirrored
+	uint32_t s = i;
+	s = (s << 16) | (s >> 16);
+	s = ((s & 0x00ff00ff) << 8) | ((s & 0xff00ff00) >> 8);
+	s = ((s & 0x0f0f0f0f) << 4) | ((s & 0xf0f0f0f0) >> 4);
+	s = ((s & 0x33333333) << 2) | ((s & 0xcccccccc) >> 2);
+	s = ((s & 0x55555555) << 1) | ((s & 0xaaaaaaaa) >> 1);
+
+	// second dimension, its direction numbers are each the last one xored with itself shifted by one
+	uint32_t t = 0;
+	for (uint32_t v = 1u << 31; i; i >>= 1, v ^= v >> 1)
+		if (i & 1)
+			t ^= v;
+
+	return { (s ^ scramble_s) * (1.0 / 4294967296.0), (t ^ scramble_t) * (1.0 / 4294967296.0) };
+}
+
+uint32_t pixel_seed(uint32_t x, uint32_t y, uint32_t sample)
+{
+	return hash32(x ^ hash32(y ^ hash32(sample)));
+}
+
+sf::Color pixel_color(const vec3d &color, double coverage)
+{
+	auto c = clamp(color, 255.0, 0.0);
+
+	return sf::Color{
+		static_cast<uint8_t>(std::round(c.x())),
+		static_cast<uint8_t>(std::round(c.y())),
+		static_cast<uint8_t>(std::round(c.z())),
+		static_cast<uint8_t>(std::round(255 * coverage))
+	};
+}
+
+bool contrasts(const vec3d &a, const vec3d &b, double threshold)
+{
+	for (size_t i = 0; i < 3; ++i)
+		if (std::abs(a.at(i, 0) - b.at(i, 0)) > threshold)
+			return true;
+
+	return false;
+}
+
+tile_mask::tile_mask(size_t width, size_t height) :
+	tiles_x((width + tile_size - 1) / tile_size),
+	tiles_y((height + tile_size - 1) / tile_size),
+	dirty(tiles_x * tiles_y, 0)
+{}
+
+void tile_mask::mark_all()
+{
+	std::fill(dirty.begin(), dirty.end(), 1);
+}
+
+void tile_mask::mark(double x0, double y0, double x1, double y1)
+{
+	// a pixel of slack, a ray through the corner of a pixel can still catch an edge
+	double right = tiles_x * tile_size - 1.0, bottom = tiles_y * tile_size - 1.0;
+
+	x0 = clamp(std::floor(x0) - 1, right, 0.0);
+	y0 = clamp(std::floor(y0) - 1, bottom, 0.0);
+	x1 = clamp(std::ceil(x1) + 1, right, 0.0);
+	y1 = clamp(std::ceil(y1) + 1, bottom, 0.0);
+
+	for (size_t ty = static_cast<size_t>(y0) / tile_size; ty <= static_cast<size_t>(y1) / tile_size; ++ty)
+		for (size_t tx = static_cast<size_t>(x0) / tile_size; tx <= static_cast<size_t>(x1) / tile_size; ++tx)
+			dirty[ty * tiles_x + tx] = 1;
+}
+
+size_t tile_mask::count() const
+{
+	return std::count(dirty.begin(), dirty.end(), 1);
+}
+
+size_t tile_mask::size() const
+{
+	return dirty.size();
+}
+
+// how far along d a ray from p inside box goes before leaving it
+static double exit_distance(const bounds &box, const vec3d &p, const vec3d &d)
+{
+	double t = std::numeric_limits<double>::infinity();
+
+	for (size_t a = 0; a < 3; ++a)
+	{
+		if (d.at(a, 0) > 0)
+			t = std::min(t, (box.hi.at(a, 0) - p.at(a, 0)) / d.at(a, 0));
+		else if (d.at(a, 0) < 0)
+			t = std::min(t, (box.lo.at(a, 0) - p.at(a, 0)) / d.at(a, 0));
+	}
+
+	return std::max(t, 0.0);
+}
+
+static bool inside(const bounds &box, const vec3d &p)
+{
+	for (size_t a = 0; a < 3; ++a)
+		if (p.at(a, 0) < box.lo.at(a, 0) || p.at(a, 0) > box.hi.at(a, 0))
+			return false;
+
+	return true;
+}
+
+void mark_changed(tile_mask &mask, const mat4d &mvp, const bounds &box, const bounds &scene_box, const light_list &lights)
+{
+	auto corners = box.corners();
+
+	// the box, and where its shadows end
+	std::vector<vec3d> points(corners.begin(), corners.end());
+
+	for (size_t i = 0; i < lights.size(); ++i)
+	{
+		for (auto &l : lights.corners(i))
+		{
+			if (inside(box, l))
+			{
+				mask.mark_all();
+				return;
+			}
+
+			for (auto &c : corners)
+			{
+				auto d = norm(c - l);
+				points.push_back(c + d * exit_distance(scene_box, c, d));
+			}
+		}
+	}
+
+	// a box around everything on the screen, it holds the convex hull of the points, so their shadows too
+	double x0 = std::numeric_limits<double>::infinity(), y0 = x0;
+	double x1 = -x0, y1 = -x0;
+
+	for (auto &p : points)
+	{
+		auto s = mvp * homo(p);
+
+		// behind the eye, it can't be told where on the screen that ends up
+		if (s.at(3, 0) <= 1e-9)
+		{
+			mask.mark_all();
+			return;
+		}
+
+		double x = s.at(0, 0) / s.at(3, 0), y = s.at(1, 0) / s.at(3, 0);
+
+		x0 = std::min(x0, x);
+		y0 = std::min(y0, y);
+		x1 = std::max(x1, x);
+		y1 = std::max(y1, y);
+	}
+
+	mask.mark(x0, y0, x1, y1);
+}
+
+size_t camera_rays::size() const
+{
+	return pixels.size();
+}
+
+void camera_rays::clear()
+{
+	pixels.clear();
+	ends.clear();
+	dx.clear();
+	dy.clear();
+	dz.clear();
+	rx.clear();
+	ry.clear();
+	rz.clear();
+}
+
+ray_generator::ray_generator(const vec3d &eye, const mat4d &inv, size_t width, size_t height) :
+	eye(eye),
+	width(width),
+	height(height),
+	tiles_x((width + tile_size - 1) / tile_size),
+	columns(width),
+	rows(height)
+{
+	auto along_x = inv * vec4d{{ 1, 0, 0, 0 }};
+	auto along_y = inv * vec4d{{ 0, 1, 0, 0 }};
+	auto corner = inv * vec4d{{ 0, 0, 1, 1 }};
+
+	for (size_t x = 0; x < width; ++x)
+		columns[x] = along_x * (1.0 * x);
+
+	for (size_t y = 0; y < height; ++y)
+		rows[y] = corner + along_y * (1.0 * y);
+}
+
+size_t ray_generator::tiles() const
+{
+	return tiles_x * ((height + tile_size - 1) / tile_size);
+}
+
+// every other bit of v, from bit 0, packed together
+static uint32_t compact_bits(uint32_t v)
+{
+	v &= 0x55555555;
+	v = (v | v >> 1) & 0x33333333;
+	v = (v | v >> 2) & 0x0f0f0f0f;
+	v = (v | v >> 4) & 0x00ff00ff;
+	v = (v | v >> 8) & 0x0000ffff;
+
+	return v;
+}
+
+void ray_generator::generate(size_t tile, camera_rays &out, bool directions) const
+{
+	const size_t tx = (tile % tiles_x) * tile_size, ty = (tile / tiles_x) * tile_size;
+	const size_t w = std::min(tile_size, width - tx), h = std::min(tile_size, height - ty);
+
+	// sized once, so filling them is plain stores
+	const size_t count = w * h;
+	const size_t with_directions = directions ? count : 0;
+	out.pixels.resize(count);
+	out.ends.resize(count);
+	out.dx.resize(with_directions);
+	out.dy.resize(with_directions);
+	out.dz.resize(with_directions);
+	out.rx.resize(with_directions);
+	out.ry.resize(with_directions);
+	out.rz.resize(with_directions);
+
+	const double ex = eye.x(), ey = eye.y(), ez = eye.z();
+
+	size_t k = 0;
+	for (uint32_t i = 0; k < count; ++i)
+	{
+		size_t x = compact_bits(i), y = compact_bits(i >> 1);
+		if (x >= w || y >= h)
+			continue;
+
+		x += tx;
+		y += ty;
+
+		auto end = rows[y] + columns[x];
+
+		out.pixels[k] = static_cast<uint32_t>(y * width + x);
+		out.ends[k] = end;
+
+		if (!directions)
+		{
+			k += 1;
+			continue;
+		}
+
+		double to_w = 1 / end.at(3, 0);
+		double dx = end.at(0, 0) * to_w - ex, dy = end.at(1, 0) * to_w - ey, dz = end.at(2, 0) * to_w - ez;
+		double to_unit = 1 / std::sqrt(dx * dx + dy * dy + dz * dz);
+		dx *= to_unit;
+		dy *= to_unit;
+		dz *= to_unit;
+
+		out.dx[k] = dx;
+		out.dy[k] = dy;
+		out.dz[k] = dz;
+		out.rx[k] = 1 / dx;
+		out.ry[k] = 1 / dy;
+		out.rz[k] = 1 / dz;
+		k += 1;
+	}
+}
+
+void gbuffer::resize(size_t width, size_t height)
+{
+	this->width = width;
+	this->height = height;
+
+	size_t n = width * height;
+	obj.assign(n, nullptr);
+	px.assign(n, 0);
+	py.assign(n, 0);
+	pz.assign(n, 0);
+	nx.assign(n, 0);
+	ny.assign(n, 0);
+	nz.assign(n, 0);
+	depth.assign(n, std::numeric_limits<double>::infinity());
+}
+
+std::optional<hit> gbuffer::at(size_t i) const
+{
+	if (!obj[i])
+		return {};
+
+	return hit{ vec3d{{ nx[i], ny[i], nz[i] }}, vec3d{{ px[i], py[i], pz[i] }}, obj[i] };
+}
+
+void gbuffer::set(size_t i, const std::optional<hit> &h, const vec3d &eye)
+{
+	if (!h)
+	{
+		obj[i] = nullptr;
+		depth[i] = std::numeric_limits<double>::infinity();
+		return;
+	}
+
+	obj[i] = h->obj;
+	px[i] = h->world_pt.x();
+	py[i] = h->world_pt.y();
+	pz[i] = h->world_pt.z();
+	nx[i] = h->normal.x();
+	ny[i] = h->normal.y();
+	nz[i] = h->normal.z();
+	depth[i] = magnitude(h->world_pt - eye);
+}
+
+std::string ray_stats::summary() const
+{
+	char line[128];
+	std::string text;
+
+	size_t total = 0;
+	for (auto n : rays)
+		total += n;
+
+	std::snprintf(line, sizeof(line), "rays/pixel %.3f  (%zu rays, %zu shadow rays, %zu lights culled, %zu pixels)\n",
+		pixels ? 1.0 * (total + shadow_rays) / pixels : 0.0, total, shadow_rays, lights_culled, pixels);
+	text += line;
+
+	if (samples > pixels)
+	{
+		std::snprintf(line, sizeof(line), "samples/pixel %.3f  (%zu pixels refined)\n", pixels ? 1.0 * samples / pixels : 0.0, refined);
+		text += line;
+	}
+
+	for (size_t depth = 0; depth < max_depths && rays[depth] > 0; ++depth)
+	{
+		std::snprintf(line, sizeof(line), "depth %zu  %10zu rays %10.2f ms\n", depth, rays[depth], ms[depth]);
+		text += line;
+	}
+
+	return text;
+}
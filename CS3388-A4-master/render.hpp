@@ -0,0 +1,966 @@
+#ifndef A4_RENDER_HPP
+#define A4_RENDER_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <tuple>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "matrix.hpp"
+#include "vector.hpp"
+#include "light.hpp"
+#include "material.hpp"
+#include "surface.hpp"
+#include "sdf.hpp"
+#include "../common/profiler.hpp"
+#include "../common/trace.hpp"
+
+// trims a value between a max and a min
+double clamp(double v, double max, double min);
+
+// trims each component of a vector between a max and a min
+template<typename T, size_t N>
+vec<T, N> clamp(const vec<T, N> &v, double max, double min)
+{
+	vec<T, N> result;
+
+	for (size_t i = 0; i < N; ++i)
+		result.at(i, 0) = clamp(v.at(i, 0), max, min);
+
+	return result;
+}
+
+// how far reflections are followed, and which lights are worth a shadow ray
+struct render_options
+{
+	size_t max_depth = 4; // bounces after the primary ray
+	double cutoff = 0.5 / 255; // reflections weighted less than this can't move a channel by half a step, so aren't traced
+	double light_cutoff = 0.5; // the faintest lights are skipped while together they add less than this to a channel, even unshadowed,
+	                           // and couldn't round one up
+	size_t light_samples = 0; // lights sampled per hit from the light tree, 0 shades with every light
+	size_t shadow_samples = 16; // shadow rays to an area light, fewer where the first packet agrees
+	size_t aa_samples = 1; // most samples a pixel gets along edges, 1 traces one ray per pixel
+	double aa_threshold = 16; // difference (0 to 255) in a channel between neighbours that counts as an edge
+};
+
+// rays traced by a render, and where the time went
+struct ray_stats
+{
+	using clock = std::chrono::steady_clock;
+
+	constexpr static size_t max_depths = 16; // depth 0 is the primary rays
+
+	std::array<size_t, max_depths> rays{}; // rays traced at each depth
+	std::array<double, max_depths> ms{}; // time spent on the rays of each depth, shading and shadows included
+	size_t shadow_rays = 0;
+	size_t lights_culled = 0; // lights skipped without a shadow ray
+	size_t pixels = 0; // pixels traced, hit or not
+	size_t samples = 0; // primary rays, more than pixels with anti-aliasing
+	size_t refined = 0; // pixels that got more than the one sample
+
+	// rays per pixel, samples per pixel when anti-aliasing, then rays and time for every depth reached
+	std::string summary() const;
+};
+
+// counter based random bits, the same key always gives the same bits, whichever thread asks
+uint32_t random_bits(uint32_t key, uint32_t counter);
+
+// counter based random number in [0, 1)
+double random_unit(uint32_t key, uint32_t counter);
+
+// i-th point of the 2D Sobol sequence in [0, 1)^2, scrambled by xoring the bits of each coordinate
+// every power of 2 run of points from 0 is stratified, e.g. the first 4 fall one to a quadrant,
+// and scrambling keeps that, so the first points of a pixel are spread over the light however it's scrambled
+std::pair<double, double> sobol_2d(uint32_t i, uint32_t scramble_s, uint32_t scramble_t);
+
+// key for the random numbers of one sample of a pixel
+uint32_t pixel_seed(uint32_t x, uint32_t y, uint32_t sample);
+
+// distance a reflected ray starts off its surface
+constexpr double reflect_offset = 1e-4;
+
+// shadow rays to an area light are traced this many at a time
+constexpr size_t shadow_packet = 4;
+
+// find intersections in a scene given a ray, at time (0 to 1) in the shutter for surfaces that move
+template<typename C>
+std::optional<hit> find_intersection(const C &scene, const vec4d &ray_start, const vec4d &ray_end, double time = 0)
+{
+	TRACE_FINE_ZONE("find_intersection");
+
+	// keep only the closest so far, no list of every hit
+	std::optional<hit> closest;
+	double closest_d2 = 0;
+
+	// get the intersections of this ray and every object in the scene
+	[[maybe_unused]] size_t id = 0; // only counted when tracing is built in
+	for (auto &obj : scene)
+	{
+		TRACE_OBJECT_ZONE("intersect", id++);
+
+		auto intersection = obj->intersect(ray_start, ray_end, time);
+		if (!intersection)
+			continue;
+
+		auto r = intersection->world_pt - cart(ray_start);
+		double d2 = dot(r, r);
+
+		if (!closest || d2 < closest_d2)
+		{
+			closest = intersection;
+			closest_d2 = d2;
+		}
+	}
+
+	return closest;
+}
+
+// closest intersections of a packet of count rays in a scene, closest[i] for ray i at times[i], count is at most shadow_packet
+// goes object by object with the whole packet, so every object sets up once for all of the rays
+template<typename C>
+void find_intersections(const C &scene, const vec4d *ray_starts, const vec4d *ray_ends, size_t count, std::optional<hit> *closest,
+	const double *times = nullptr)
+{
+	TRACE_FINE_ZONE("find_intersections");
+
+	std::array<std::optional<hit>, shadow_packet> hits;
+	std::array<double, shadow_packet> closest_d2{};
+
+	for (size_t k = 0; k < count; ++k)
+		closest[k].reset();
+
+	[[maybe_unused]] size_t id = 0; // only counted when tracing is built in
+	for (auto &obj : scene)
+	{
+		TRACE_OBJECT_ZONE("intersect", id++);
+
+		obj->intersect(ray_starts, ray_ends, count, hits.data(), times);
+
+		for (size_t k = 0; k < count; ++k)
+		{
+			if (!hits[k])
+				continue;
+
+			auto r = hits[k]->world_pt - cart(ray_starts[k]);
+			double d2 = dot(r, r);
+
+			if (!closest[k] || d2 < closest_d2[k])
+			{
+				closest[k] = hits[k];
+				closest_d2[k] = d2;
+			}
+		}
+	}
+}
+
+// index of obj in the scene, for tagging traces
+template<typename C>
+int32_t object_id(const C &scene, const surface *obj)
+{
+	auto found = std::find(std::begin(scene), std::end(scene), obj);
+
+	return found == std::end(scene) ? -1 : static_cast<int32_t>(found - std::begin(scene));
+}
+
+// whether the light at from reaches pt, i.e. the first thing a ray from the light hits is pt itself
+template<typename C>
+bool reaches(const C &scene, const vec3d &from, const vec3d &pt, double time = 0)
+{
+	// trace those shadows!
+	TRACE_FINE_ZONE("shadow");
+
+	auto obstruction = find_intersection(scene, homo(from), homo(pt), time);
+	if (!obstruction)
+		return true;
+
+	auto d = pt - obstruction->world_pt;
+	return dot(d, d) <= std::numeric_limits<double>::epsilon();
+}
+
+// how much of light i pt sees, from 0 in full shadow to 1 fully lit
+// point lights take the one shadow ray, area lights up to options.shadow_samples spread over the light
+// the first packet of samples covers each quarter of the light, if they all agree pt is taken to be fully lit or
+// fully shadowed and the rest are skipped, so only the penumbra pays for every sample
+template<typename C>
+double visibility(const C &scene, const light_list &lights, size_t i, const vec3d &pt, const render_options &options,
+	ray_stats *stats, uint32_t seed, double time = 0)
+{
+	if (lights.shapes[i].kind == light_kind::point)
+	{
+		if (stats)
+			stats->shadow_rays += 1;
+
+		return reaches(scene, lights.position(i), pt, time) ? 1 : 0;
+	}
+
+	TRACE_FINE_ZONE("soft shadow");
+
+	const size_t samples = std::max<size_t>(options.shadow_samples, 1);
+
+	// a different scramble for every light of every pixel, so the samples don't line up into bands
+	uint32_t key = seed ^ 0x5bd1e995;
+	uint32_t scramble_s = random_bits(key, static_cast<uint32_t>(2 * i));
+	uint32_t scramble_t = random_bits(key, static_cast<uint32_t>(2 * i + 1));
+
+	std::array<vec4d, shadow_packet> starts, ends;
+	std::array<std::optional<hit>, shadow_packet> obstructions;
+	std::array<double, shadow_packet> times;
+	times.fill(time);
+
+	size_t visible = 0;
+	for (size_t first = 0; first < samples; first += shadow_packet)
+	{
+		size_t n = std::min(shadow_packet, samples - first);
+
+		for (size_t k = 0; k < n; ++k)
+		{
+			auto [s, t] = sobol_2d(static_cast<uint32_t>(first + k), scramble_s, scramble_t);
+
+			starts[k] = homo(lights.sample_point(i, pt, s, t));
+			ends[k] = homo(pt);
+		}
+
+		find_intersections(scene, starts.data(), ends.data(), n, obstructions.data(), times.data());
+
+		for (size_t k = 0; k < n; ++k)
+		{
+			if (!obstructions[k])
+			{
+				visible += 1;
+				continue;
+			}
+
+			auto d = pt - obstructions[k]->world_pt;
+			if (dot(d, d) <= std::numeric_limits<double>::epsilon())
+				visible += 1;
+		}
+
+		if (stats)
+			stats->shadow_rays += n;
+
+		// all lit or all blocked, not in a penumbra
+		if (first == 0 && (visible == 0 || visible == n))
+			return visible == 0 ? 0 : 1;
+	}
+
+	return static_cast<double>(visible) / samples;
+}
+
+// Phong diffuse and specular of light i on a hit seen along v, ignoring shadows
+std::pair<double, double> light_terms(const light_list &lights, size_t i, const hit &hit, const vec3d &v);
+
+// puts the lit sums and ambient together into a pixel color, channels are 0 to 255 and rounded
+// ambient is flat k_ambient where any light reaches, k_ambient times the color where none does
+vec3d combine(const material &mat, const vec3d &lit, double spec, bool reached);
+
+// whether adding up to extra to every channel of lit could change the channels combine() rounds them to where lights reach
+bool rounds_up(const material &mat, const vec3d &lit, double spec, double extra);
+
+// Phong lighting of a hit seen from origin by every light
+//
+// the unshadowed contribution of every light is worked out first, in one pass over the light arrays
+// shadow rays are then cast brightest light first, and stop once every channel is saturated or all the
+// lights left couldn't add options.light_cutoff between them even unshadowed
+// so only the faint tail is dropped, many faint lights that add up to something are still traced, and if the tail could
+// still round a channel to the next step all of it is, so the pixel comes out the same as if every light had been
+// the tail is only dropped once some light has reached the hit, until then lights are traced down to the last, as
+// the ambient of a hit no light reaches isn't the same as that of a lit one
+template<typename C>
+vec3d shade_all(const C &scene, const light_list &lights, const vec3d &origin, const hit &hit, const render_options &options,
+	ray_stats *stats, uint32_t seed, double time = 0)
+{
+	const auto &mat = hit.obj->material;
+	const size_t count = lights.size();
+
+	double ambient = mat.k_ambient;
+	double brightest = std::max({ mat.color.x(), mat.color.y(), mat.color.z() });
+
+	vec3d v = norm(origin - hit.world_pt);
+
+	// per light scratch, reused by every hit on this thread
+	thread_local std::vector<double> diffuse, specular, bound;
+	thread_local std::vector<uint32_t> order;
+	diffuse.resize(count);
+	specular.resize(count);
+	bound.resize(count);
+	order.clear();
+
+	double remaining = 0; // most the lights not traced yet could add to a channel
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::tie(diffuse[i], specular[i]) = light_terms(lights, i, hit, v);
+		bound[i] = diffuse[i] * brightest + specular[i];
+
+		if (bound[i] > 0)
+		{
+			order.push_back(static_cast<uint32_t>(i));
+			remaining += bound[i];
+		}
+	}
+
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bound[a] > bound[b]; });
+
+	if (stats)
+		stats->lights_culled += count - order.size();
+
+	// sums of the lights that reach the hit
+	vec3d lit{{ 0, 0, 0 }};
+	double spec = 0;
+	bool reached = false;
+	bool whole_tail = false; // the faint tail could round a channel up, so all of it is traced
+
+	for (size_t k = 0; k < order.size(); ++k)
+	{
+		// nothing left can show: every channel is already white, or the rest together are too faint
+		bool saturated = reached && std::min({ lit.x(), lit.y(), lit.z() }) + ambient + spec >= 255;
+		bool faint = reached && !whole_tail && remaining < options.light_cutoff;
+		if (faint && rounds_up(mat, lit, spec, remaining))
+		{
+			whole_tail = true;
+			faint = false;
+		}
+
+		if (saturated || faint)
+		{
+			if (stats)
+				stats->lights_culled += order.size() - k;
+
+			break;
+		}
+
+		size_t i = order[k];
+		remaining -= bound[i];
+
+		double seen = visibility(scene, lights, i, hit.world_pt, options, stats, seed, time);
+		if (seen <= 0)
+			continue; // obstructed
+
+		lit = lit + mat.color * (diffuse[i] * seen);
+		spec += specular[i] * seen;
+		reached = true;
+	}
+
+	return combine(mat, lit, spec, reached);
+}
+
+// Phong lighting of a hit seen from origin by options.light_samples lights picked from the light tree
+// each picked light is weighted by 1 / (samples * probability it was picked), so on average the sum is the same as
+// lighting by every light, at the cost of a few shadow rays no matter how many lights there are
+// seed makes the picks repeatable for a given pixel and bounce
+template<typename C>
+vec3d shade_sampled(const C &scene, const light_list &lights, const vec3d &origin, const hit &hit, const render_options &options,
+	ray_stats *stats, uint32_t seed, double time = 0)
+{
+	const auto &mat = hit.obj->material;
+	const size_t samples = options.light_samples;
+
+	vec3d v = norm(origin - hit.world_pt);
+
+	vec3d lit{{ 0, 0, 0 }};
+	double spec = 0;
+	bool reached = false;
+
+	for (size_t k = 0; k < samples; ++k)
+	{
+		auto [i, pdf] = lights.sample(hit.world_pt, hit.normal, random_unit(seed, static_cast<uint32_t>(k)));
+
+		auto [diffuse, specular] = light_terms(lights, i, hit, v);
+		if (diffuse <= 0 && specular <= 0)
+			continue;
+
+		double weight = visibility(scene, lights, i, hit.world_pt, options, stats, seed, time) / (samples * pdf);
+		if (weight <= 0)
+			continue;
+
+		lit = lit + mat.color * (diffuse * weight);
+		spec += specular * weight;
+		reached = true;
+	}
+
+	return combine(mat, lit, spec, reached);
+}
+
+// Phong lighting of a hit seen from origin, channels are 0 to 255 and rounded like a pixel
+// every light is considered unless light samples are asked for and the lights have a tree to sample from
+// shadow rays are at time, the same as the ray that found the hit
+template<typename C>
+vec3d shade(const C &scene, const light_list &lights, const vec3d &origin, const hit &hit, const render_options &options,
+	ray_stats *stats, uint32_t seed, double time = 0)
+{
+	// lighting computation
+	TRACE_OBJECT_ZONE("shade", object_id(scene, hit.obj));
+
+	if (options.light_samples > 0 && !lights.nodes.empty())
+		return shade_sampled(scene, lights, origin, hit, options, stats, seed, time);
+
+	return shade_all(scene, lights, origin, hit, options, stats, seed, time);
+}
+
+// what a ray through the screen found
+struct traced
+{
+	vec3d color; // 0 to 255, can go over where reflections add up
+	const surface *obj; // first thing hit, nullptr if nothing was
+};
+
+// the pixel for a color, coverage is how much of the pixel was covered by something
+sf::Color pixel_color(const vec3d &color, double coverage = 1);
+
+// whether two colors are far enough apart in any channel for an edge between them to show
+bool contrasts(const vec3d &a, const vec3d &b, double threshold);
+
+// shades a hit seen from origin, then follows its reflections
+// reflective surfaces add k_reflect times the color seen in their mirror direction, up to options.max_depth bounces
+// a reflection only ever spawns the one next ray, so the recursion is a loop carrying that ray and its weight
+// the first hit was found by the caller, which counts its ray, start is when it started on it
+// key seeds the random numbers of the ray and its bounces, which are all at time in the shutter, like the first
+template<typename C>
+traced follow_ray(const C &scene, const light_list &lights, const vec3d &from, const hit &first, const render_options &options,
+	ray_stats *stats, uint32_t key, ray_stats::clock::time_point start = {}, double time = 0)
+{
+	const size_t max_depth = std::min(options.max_depth, ray_stats::max_depths - 1);
+
+	traced result{ vec3d{{ 0, 0, 0 }}, first.obj };
+	double weight = 1; // how much the current ray adds to the pixel
+
+	vec3d origin = from;
+	hit current = first;
+
+	for (size_t depth = 0; ; ++depth)
+	{
+		result.color = result.color + shade(scene, lights, origin, current, options, stats, random_bits(key, static_cast<uint32_t>(depth)), time) * weight;
+
+		if (stats)
+		{
+			if (depth > 0)
+				stats->rays[depth] += 1;
+			stats->ms[depth] += std::chrono::duration<double, std::milli>(ray_stats::clock::now() - start).count();
+		}
+
+		// a ray this faint can't change the pixel anymore
+		weight *= current.obj->material.k_reflect;
+		if (weight < options.cutoff || depth == max_depth)
+			break;
+
+		// mirror the incoming direction about the normal facing it, start a little off the surface so it doesn't hit itself
+		vec3d d = norm(current.world_pt - origin);
+		vec3d n = dot(d, current.normal) > 0 ? -current.normal : current.normal;
+		vec3d r = d - n * 2 * dot(d, n);
+
+		origin = current.world_pt + n * reflect_offset;
+
+		start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+
+		auto next = find_intersection(scene, homo(origin), homo(origin + r), time);
+		if (!next)
+		{
+			if (stats)
+			{
+				stats->rays[depth + 1] += 1;
+				stats->ms[depth + 1] += std::chrono::duration<double, std::milli>(ray_stats::clock::now() - start).count();
+			}
+
+			break;
+		}
+
+		current = next.value();
+	}
+
+	return result;
+}
+
+// traces the ray through the screen coords (x, y) at time, see follow_ray()
+template<typename C>
+traced trace_ray(const C &scene, const light_list &lights, const vec3d &eye, const mat4d &inv, double x, double y,
+	const render_options &options, ray_stats *stats, uint32_t key, double time = 0)
+{
+	auto start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+
+	// screen space
+	vec4d ray_end{{ x, y, 1, 1 }};
+
+	// find intersection, in world space
+	auto intersection = find_intersection(scene, homo(eye), inv * ray_end, time);
+
+	if (stats)
+		stats->rays[0] += 1;
+
+	if (!intersection)
+	{
+		if (stats)
+			stats->ms[0] += std::chrono::duration<double, std::milli>(ray_stats::clock::now() - start).count();
+
+		return { vec3d{{ 0, 0, 0 }}, nullptr };
+	}
+
+	return follow_ray(scene, lights, eye, intersection.value(), options, stats, key, start, time);
+}
+
+// pixels a side of a screen tile
+constexpr size_t tile_size = 32;
+
+// which screen tiles of a width x height image need tracing again
+struct tile_mask
+{
+	size_t tiles_x, tiles_y;
+	std::vector<uint8_t> dirty;
+
+	tile_mask(size_t width, size_t height);
+
+	void mark_all();
+
+	// marks the tiles touching the pixels from (x0, y0) to (x1, y1), clamped to the screen
+	void mark(double x0, double y0, double x1, double y1);
+
+	// marked tiles, and all of them
+	size_t count() const;
+	size_t size() const;
+};
+
+// marks the tiles where a change inside box can show, box itself as mvp puts it on the screen, and the shadows it casts
+// shadows run from each corner of each light past each corner of box until they leave scene_box, which has to hold box
+// when that can't be told from the screen, like when part of it is behind the eye or a light is in box, everything is marked
+void mark_changed(tile_mask &mask, const mat4d &mvp, const bounds &box, const bounds &scene_box, const light_list &lights);
+
+// tiles that need tracing again after a surface of scene moved from before to after
+// every tile does when the scene has mirrors in it, anything could show up in those
+template<typename C>
+tile_mask dirty_tiles(const C &scene, const light_list &lights, const mat4d &mvp, size_t width, size_t height,
+	const bounds &before, const bounds &after)
+{
+	tile_mask mask(width, height);
+
+	bounds scene_box = before;
+	for (auto &obj : scene)
+	{
+		if (obj->reflects())
+		{
+			mask.mark_all();
+			return mask;
+		}
+
+		scene_box.add(obj->world_bounds());
+	}
+
+	mark_changed(mask, mvp, before, scene_box, lights);
+	mark_changed(mask, mvp, after, scene_box, lights);
+
+	return mask;
+}
+
+// tiles where a surface of scene that moves while the shutter is open can show, or its shadows, over the whole shutter
+// like dirty_tiles() with the box it sweeps as both before and after, every tile when the scene has mirrors in it
+template<typename C>
+tile_mask moving_tiles(const C &scene, const light_list &lights, const mat4d &mvp, size_t width, size_t height)
+{
+	tile_mask mask(width, height);
+
+	if (std::none_of(std::begin(scene), std::end(scene), [](auto &obj) { return obj->moving(); }))
+		return mask;
+
+	bounds scene_box = (*std::begin(scene))->world_bounds();
+	for (auto &obj : scene)
+	{
+		if (obj->reflects())
+		{
+			mask.mark_all();
+			return mask;
+		}
+
+		scene_box.add(obj->world_bounds());
+	}
+
+	for (auto &obj : scene)
+		if (obj->moving())
+			mark_changed(mask, mvp, obj->world_bounds(), scene_box, lights);
+
+	return mask;
+}
+
+// calls fn(x, y) for every pixel of a width x height image, in square tiles so a trace can tell which part of the screen is slow
+// only the pixels of the tiles marked in mask, if there is one
+template<typename F>
+void for_each_tile(size_t width, size_t height, F fn, const tile_mask *mask = nullptr)
+{
+	const size_t tiles_x = (width + tile_size - 1) / tile_size;
+
+	for (size_t ty = 0; ty < height; ty += tile_size)
+	{
+		for (size_t tx = 0; tx < width; tx += tile_size)
+		{
+			size_t tile = (ty / tile_size) * tiles_x + tx / tile_size;
+			if (mask && !mask->dirty[tile])
+				continue;
+
+			TRACE_TILE(tile);
+			TRACE_ZONE("tile");
+
+			for (size_t x = tx; x < std::min(tx + tile_size, width); ++x)
+				for (size_t y = ty; y < std::min(ty + tile_size, height); ++y)
+					fn(x, y);
+		}
+	}
+}
+
+// a batch of primary rays, one array per field so packets of them read plain runs of doubles
+// the ends are homogeneous, the same as inv * (x, y, 1, 1) without the multiply, and go with homo(eye) as the start
+struct camera_rays
+{
+	std::vector<uint32_t> pixels; // y * width + x
+	std::vector<vec4d> ends;
+	std::vector<double> dx, dy, dz; // unit direction, only when asked for
+	std::vector<double> rx, ry, rz; // one over the direction, for slab tests, only when asked for
+
+	size_t size() const;
+	void clear();
+};
+
+// primary rays of a camera, inv takes screen coords back to world space
+// inv * (x, y, 1, 1) is the sum of x times its first column, y times its second, and its last two, so those are kept for
+// every column and row of the screen, and a ray's end is one add of the two
+class ray_generator
+{
+public:
+	ray_generator(const vec3d &eye, const mat4d &inv, size_t width, size_t height);
+
+	// the end of the ray through pixel (x, y), for the intersect() calls
+	vec4d end(size_t x, size_t y) const { return rows[y] + columns[x]; }
+
+	// tiles of tile_size pixels a side, in the order for_each_tile() goes
+	size_t tiles() const;
+
+	// the rays of a tile into out, replacing what was there, along a Morton curve so rays next to each other in the
+	// batch are next to each other on the screen, in every power of 2 square
+	// the ends are an add a ray, the directions cost a sqrt and four divides more and are left empty unless directions is set
+	void generate(size_t tile, camera_rays &out, bool directions = false) const;
+
+private:
+	vec3d eye;
+	size_t width, height, tiles_x;
+	std::vector<vec4d> columns, rows;
+};
+
+// what the primary ray of every pixel hit, kept so the lighting can be redone without tracing them again
+// one array per field, so the shading pass reads each as a plain run of doubles
+struct gbuffer
+{
+	size_t width = 0, height = 0;
+
+	std::vector<surface *> obj; // nullptr where nothing was hit
+	std::vector<double> px, py, pz; // world point
+	std::vector<double> nx, ny, nz; // normal
+	std::vector<double> depth; // distance from the eye
+
+	void resize(size_t width, size_t height);
+
+	// the hit of pixel i, nothing if it didn't hit anything
+	std::optional<hit> at(size_t i) const;
+
+	void set(size_t i, const std::optional<hit> &h, const vec3d &eye);
+};
+
+// traces every primary ray of a width x height screen into g, no shading
+template<typename C>
+void visibility_pass(const C &scene, const vec3d &eye, const mat4d &inv, size_t width, size_t height, gbuffer &g, ray_stats *stats = nullptr)
+{
+	TRACE_ZONE("visibility pass");
+
+	g.resize(width, height);
+
+	auto ray_start = homo(eye);
+	ray_generator rays(eye, inv, width, height);
+	camera_rays batch;
+
+	for (size_t tile = 0; tile < rays.tiles(); ++tile)
+	{
+		TRACE_TILE(tile);
+		TRACE_ZONE("tile");
+
+		rays.generate(tile, batch);
+
+		for (size_t k = 0; k < batch.size(); ++k)
+		{
+			auto start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+
+			g.set(batch.pixels[k], find_intersection(scene, ray_start, batch.ends[k]), eye);
+
+			if (stats)
+			{
+				stats->rays[0] += 1;
+				stats->ms[0] += std::chrono::duration<double, std::milli>(ray_stats::clock::now() - start).count();
+			}
+		}
+	}
+}
+
+// how many sphere tracing steps the primary ray of each pixel took, into out as a grey image, white being the most any took
+// returns the steps of every pixel together
+template<typename C>
+uint64_t steps_heatmap(const C &scene, const vec3d &eye, const mat4d &inv, size_t width, size_t height, sf::Image &out)
+{
+	std::vector<uint64_t> steps(width * height);
+	auto ray_start = homo(eye);
+	ray_generator rays(eye, inv, width, height);
+
+	for_each_tile(width, height, [&](size_t x, size_t y)
+	{
+		// the count is per thread, so only this ray's steps are between the two reads
+		uint64_t before = sdf_steps();
+
+		find_intersection(scene, ray_start, rays.end(x, y));
+
+		steps[y * width + x] = sdf_steps() - before;
+	});
+
+	uint64_t most = std::max<uint64_t>(*std::max_element(steps.begin(), steps.end()), 1);
+	uint64_t total = 0;
+
+	out.create(width, height, sf::Color::Black);
+	for (size_t i = 0; i < steps.size(); ++i)
+	{
+		auto level = static_cast<uint8_t>(std::round(255.0 * steps[i] / most));
+		out.setPixel(i % width, i / width, sf::Color(level, level, level));
+		total += steps[i];
+	}
+
+	return total;
+}
+
+// lights the hits of g into image, casting the shadow and reflection rays but none of the primary ones
+// after a light or material changes only this needs to run again, as long as the camera and objects haven't moved
+template<typename C>
+draw_counts shading_pass(const C &scene, const light_list &lights, const vec3d &eye, const gbuffer &g, sf::Image &image,
+	const render_options &options = {}, ray_stats *stats = nullptr)
+{
+	TRACE_ZONE("shading pass");
+
+	draw_counts counts;
+
+	for_each_tile(g.width, g.height, [&](size_t x, size_t y)
+	{
+		size_t i = y * g.width + x;
+
+		if (stats)
+		{
+			stats->pixels += 1;
+			stats->samples += 1;
+		}
+
+		auto first = g.at(i);
+		if (!first)
+			return;
+
+		auto start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+		auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0);
+		auto sample = follow_ray(scene, lights, eye, first.value(), options, stats, key, start);
+
+		image.setPixel(x, y, pixel_color(sample.color));
+		counts.pixels += 1;
+	});
+
+	return counts;
+}
+
+// traces the tiles marked in mask again, both passes, into g and image, the rest of both are kept from the frame before
+// g has to be from the same camera and image size
+template<typename C>
+draw_counts render_tiles(const C &scene, const light_list &lights, const vec3d &eye, const mat4d &inv, gbuffer &g, sf::Image &image,
+	const tile_mask &mask, const render_options &options = {}, ray_stats *stats = nullptr)
+{
+	TRACE_ZONE("render tiles");
+
+	draw_counts counts;
+	auto ray_start = homo(eye);
+	ray_generator rays(eye, inv, g.width, g.height);
+
+	for_each_tile(g.width, g.height, [&](size_t x, size_t y)
+	{
+		size_t i = y * g.width + x;
+
+		auto start = stats ? ray_stats::clock::now() : ray_stats::clock::time_point{};
+
+		g.set(i, find_intersection(scene, ray_start, rays.end(x, y)), eye);
+
+		if (stats)
+		{
+			stats->rays[0] += 1;
+			stats->pixels += 1;
+			stats->samples += 1;
+		}
+
+		auto first = g.at(i);
+		if (!first)
+		{
+			if (stats)
+				stats->ms[0] += std::chrono::duration<double, std::milli>(ray_stats::clock::now() - start).count();
+
+			image.setPixel(x, y, sf::Color(0, 0, 0, 0));
+			return;
+		}
+
+		auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0);
+		auto sample = follow_ray(scene, lights, eye, first.value(), options, stats, key, start);
+
+		image.setPixel(x, y, pixel_color(sample.color));
+		counts.pixels += 1;
+	}, &mask);
+
+	return counts;
+}
+
+// ray traces a scene into image with adaptive anti-aliasing
+//
+// a first pass traces one ray per pixel, as without anti-aliasing, keeping its color and the object it hit
+// pixels next to one that hit something else, or that differs by more than options.aa_threshold, then get more samples
+// spread over the pixel: 4 first, and up to options.aa_samples only if those 4 don't agree either
+// so flat areas cost one ray a pixel, and only edges, shadow borders and highlights pay for the full count
+template<typename C>
+draw_counts render_adaptive(const C &scene, const light_list &lights, const vec3d &eye, const mat4d &inv, sf::Image &image,
+	const render_options &options, ray_stats *stats, sf::Image *sample_counts)
+{
+	const size_t width = image.getSize().x, height = image.getSize().y;
+	const size_t max_samples = options.aa_samples;
+	const size_t first_round = std::min<size_t>(4, max_samples);
+
+	// the pixel center is the first sample, the rest are spread around it in a stratified pattern
+	// the scramble moves the first Sobol point from the corner to the center of the square
+	const uint32_t center = 1u << 31;
+
+	std::vector<traced> base(width * height);
+
+	{
+		TRACE_ZONE("base pass");
+
+		for_each_tile(width, height, [&](size_t x, size_t y)
+		{
+			auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), 0);
+			base[y * width + x] = trace_ray(scene, lights, eye, inv, 1.0 * x, 1.0 * y, options, stats, key);
+		});
+	}
+
+	// mark both sides of every edge, looking right, up, and both diagonals covers each pair of neighbours once
+	std::vector<uint8_t> edge(width * height, 0);
+	for (size_t y = 0; y < height; ++y)
+	{
+		for (size_t x = 0; x < width; ++x)
+		{
+			const auto &a = base[y * width + x];
+
+			for (auto [dx, dy] : { std::pair{ 1, 0 }, std::pair{ 0, 1 }, std::pair{ 1, 1 }, std::pair{ 1, -1 } })
+			{
+				size_t nx = x + dx, ny = y + dy;
+				if (nx >= width || ny >= height) // unsigned, so this catches y - 1 below 0 too
+					continue;
+
+				const auto &b = base[ny * width + nx];
+				if (a.obj != b.obj || contrasts(a.color, b.color, options.aa_threshold))
+				{
+					edge[y * width + x] = 1;
+					edge[ny * width + nx] = 1;
+				}
+			}
+		}
+	}
+
+	if (sample_counts)
+		sample_counts->create(width, height, sf::Color::Black);
+
+	draw_counts counts;
+
+	TRACE_ZONE("refine pass");
+
+	for_each_tile(width, height, [&](size_t x, size_t y)
+	{
+		const auto &first = base[y * width + x];
+
+		vec3d sum = first.obj ? first.color : vec3d{{ 0, 0, 0 }};
+		size_t hits = first.obj ? 1 : 0;
+		size_t samples = 1;
+
+		if (edge[y * width + x])
+		{
+			// range of the samples so far, to tell if the first round agrees
+			vec3d lo = first.color, hi = first.color;
+			bool mixed = false;
+
+			for (; samples < max_samples; ++samples)
+			{
+				if (samples == first_round && !mixed && !contrasts(lo, hi, options.aa_threshold))
+					break;
+
+				auto [s, t] = sobol_2d(static_cast<uint32_t>(samples), center, center);
+				auto key = pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), static_cast<uint32_t>(samples));
+				auto sample = trace_ray(scene, lights, eye, inv, x + s - 0.5, y + t - 0.5, options, stats, key);
+
+				mixed = mixed || sample.obj != first.obj;
+				for (size_t c = 0; c < 3; ++c)
+				{
+					lo.at(c, 0) = std::min(lo.at(c, 0), sample.color.at(c, 0));
+					hi.at(c, 0) = std::max(hi.at(c, 0), sample.color.at(c, 0));
+				}
+
+				if (sample.obj)
+				{
+					sum = sum + sample.color;
+					hits += 1;
+				}
+			}
+
+			if (stats)
+				stats->refined += 1;
+		}
+
+		if (stats)
+		{
+			stats->pixels += 1;
+			stats->samples += samples;
+		}
+
+		if (sample_counts)
+		{
+			auto level = static_cast<uint8_t>(std::round(255.0 * samples / max_samples));
+			sample_counts->setPixel(x, y, sf::Color(level, level, level));
+		}
+
+		if (hits == 0)
+			return;
+
+		image.setPixel(x, y, pixel_color(sum * (1.0 / hits), 1.0 * hits / samples));
+		counts.pixels += 1;
+	});
+
+	return counts;
+}
+
+// ray traces a scene into image, inv takes screen coords back to world space
+// one ray per pixel, as a visibility pass then a shading pass, or adaptively more along edges when options.aa_samples is over 1
+// sample_counts, if given, is made a grey image of how many samples each pixel took, white being aa_samples
+template<typename C>
+draw_counts render(const C &scene, const light_list &lights, const vec3d &eye, const mat4d &inv, sf::Image &image,
+	const render_options &options = {}, ray_stats *stats = nullptr, sf::Image *sample_counts = nullptr)
+{
+	if (options.aa_samples > 1)
+		return render_adaptive(scene, lights, eye, inv, image, options, stats, sample_counts);
+
+	const size_t window_width = image.getSize().x, window_height = image.getSize().y;
+
+	if (sample_counts)
+		sample_counts->create(window_width, window_height, sf::Color::White);
+
+	gbuffer g;
+	visibility_pass(scene, eye, inv, window_width, window_height, g, stats);
+
+	return shading_pass(scene, lights, eye, g, image, options, stats);
+}
+
+#endif //A4_RENDER_HPP
@@ -0,0 +1,1157 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+
+#include "scene.hpp"
+#include "matrix_utils.hpp"
+
+// after the matrix headers, windows.h defines near and far, which perspective() has as parameters
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+surface &scene_data::add(surface_kind kind, uint32_t shape)
+{
+	surface *obj = nullptr;
+
+	switch (kind)
+	{
+	case surface_kind::sphere: obj = &spheres.emplace_back(); break;
+	case surface_kind::plane: obj = &planes.emplace_back(); break;
+	case surface_kind::cone: obj = &cones.emplace_back(); break;
+	case surface_kind::mesh: obj = &meshes.emplace_back(); break;
+	case surface_kind::instances: obj = &instance_sets.emplace_back(); break;
+	case surface_kind::torus: obj = &tori.emplace_back(); break;
+	case surface_kind::csg: obj = &csgs.emplace_back(); break;
+	case surface_kind::sdf: obj = sdfs.emplace_back(make_sdf(shape)).get(); break;
+	}
+
+	obj->material = {
+		.color = vec3d{{ 255, 255, 255 }},
+		.k_ambient = 0.1,
+		.k_diffuse = 1,
+		.k_specular = 255,
+		.k_reflect = 0,
+		.fallout = 256
+	};
+
+	surfaces.push_back(obj);
+	kinds.push_back(kind);
+
+	return *obj;
+}
+
+surface *scene_data::find(std::string_view name) const
+{
+	for (auto &entry : names)
+		if (entry.first == name)
+			return entry.second;
+
+	return nullptr;
+}
+
+// walks the text a token at a time, nothing is copied out of it
+struct scene_reader
+{
+	const char *at, *end;
+	size_t line = 1;
+
+	// past whitespace and comments
+	void skip()
+	{
+		while (at != end)
+		{
+			if (*at == '#')
+			{
+				while (at != end && *at != '\n')
+					++at;
+			}
+			else if (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n')
+			{
+				line += *at == '\n';
+				++at;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	bool done()
+	{
+		skip();
+		return at == end;
+	}
+
+	std::string_view word()
+	{
+		skip();
+
+		auto start = at;
+		while (at != end && *at != ' ' && *at != '\t' && *at != '\r' && *at != '\n' && *at != '#')
+			++at;
+
+		return std::string_view(start, at - start);
+	}
+
+	// reads the next token into value when it's a number, leaves it be otherwise
+	bool number(double &value)
+	{
+		skip();
+
+		auto [ptr, ec] = std::from_chars(at, end, value);
+		if (ec != std::errc() || (ptr != end && *ptr != ' ' && *ptr != '\t' && *ptr != '\r' && *ptr != '\n' && *ptr != '#'))
+			return false;
+
+		at = ptr;
+		return true;
+	}
+
+	bool numbers(double *values, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			if (!number(values[i]))
+				return false;
+
+		return true;
+	}
+};
+
+static bool surface_kind_of(std::string_view word, surface_kind &kind)
+{
+	if (word == "sphere")
+		kind = surface_kind::sphere;
+	else if (word == "plane")
+		kind = surface_kind::plane;
+	else if (word == "cone")
+		kind = surface_kind::cone;
+	else
+		return false;
+
+	return true;
+}
+
+// statements that go with a surface
+static bool surface_statement(std::string_view word)
+{
+	for (auto s : { "name", "translate", "scale", "rotx", "roty", "rotz", "color", "ambient", "diffuse", "specular", "reflect", "fallout", "moving" })
+		if (word == s)
+			return true;
+
+	return false;
+}
+
+// fills objects with every surface but the ones only drawn through copies or csg nodes
+static void collect_objects(scene_data &scene)
+{
+	std::vector<const surface *> hidden;
+	for (auto &set : scene.instance_sets)
+		hidden.push_back(set.shape);
+
+	for (auto &node : scene.csgs)
+	{
+		hidden.push_back(node.left);
+		hidden.push_back(node.right);
+	}
+
+	std::sort(hidden.begin(), hidden.end());
+
+	scene.objects.clear();
+
+	for (auto obj : scene.surfaces)
+		if (!std::binary_search(hidden.begin(), hidden.end(), obj))
+			scene.objects.push_back(obj);
+}
+
+// whether a surface of that kind can be an operand of a csg node
+static bool solid_kind(surface_kind kind)
+{
+	return kind == surface_kind::sphere || kind == surface_kind::plane || kind == surface_kind::cone || kind == surface_kind::csg;
+}
+
+// parse_scene() without building the light tree, the cache keeps the lights in the order they were written
+static bool parse_statements(std::string_view text, scene_data &out, std::string &error)
+{
+	scene_reader in{ text.data(), text.data() + text.size() };
+	surface *current = nullptr; // nullptr while on a copy, those can't be named
+
+	// where the transform and material statements go, the current surface's or the copy's
+	mat4d *transforms = nullptr;
+	material *look = nullptr;
+
+	// the copy being read, added to its set once the next surface or copy starts
+	instance_set *copying = nullptr;
+	mat4d copy_transforms;
+	material copy_look;
+
+	// where the surface or copy being read ends up when the shutter closes, once it's said to be moving
+	bool moves = false;
+	mat4d end_transforms;
+
+	// adds the copy being read to its set, and sets the surface or copy being read moving, once the next one starts
+	auto finish = [&]
+	{
+		if (copying && moves)
+			copying->add(copy_transforms, end_transforms, copying->add_look(copy_look));
+		else if (copying)
+			copying->add(copy_transforms, copying->add_look(copy_look));
+		else if (current && moves)
+			current->move_to(end_transforms);
+
+		copying = nullptr;
+		moves = false;
+	};
+
+	auto start = [&](surface &obj)
+	{
+		finish();
+
+		current = &obj;
+		transforms = &obj.transforms;
+		look = &obj.material;
+	};
+
+	while (!in.done())
+	{
+		size_t line = in.line;
+		auto key = in.word();
+
+		auto fail = [&](const char *what)
+		{
+			error = "line " + std::to_string(line) + ": " + what + " '" + std::string(key) + "'";
+			return false;
+		};
+
+		double v[6];
+		surface_kind kind;
+
+		if (key == "eye" || key == "gaze" || key == "up")
+		{
+			if (!in.numbers(v, 3))
+				return fail("expected x y z after");
+
+			(key == "eye" ? out.eye : key == "gaze" ? out.gaze : out.up) = vec3d{{ v[0], v[1], v[2] }};
+		}
+		else if (key == "light")
+		{
+			if (!in.numbers(v, 4))
+				return fail("expected x y z intensity after");
+
+			out.lights.add({ {{ v[0], v[1], v[2], 1.0 }}, v[3] });
+		}
+		else if (key == "rect" || key == "radius")
+		{
+			if (out.lights.size() == 0)
+				return fail("no light yet for");
+
+			auto &shape = out.lights.shapes.back();
+
+			if (key == "rect")
+			{
+				if (!in.numbers(v, 6))
+					return fail("expected ux uy uz vx vy vz after");
+
+				shape = { light_kind::rect, vec3d{{ v[0], v[1], v[2] }}, vec3d{{ v[3], v[4], v[5] }} };
+			}
+			else
+			{
+				if (!in.number(v[0]))
+					return fail("expected a radius after");
+
+				shape = { light_kind::sphere, {}, {}, v[0] };
+			}
+		}
+		else if (surface_kind_of(key, kind))
+		{
+			start(out.add(kind));
+		}
+		else if (key == "sphere_mesh" || key == "cone_mesh")
+		{
+			if (!in.numbers(v, 2) || v[0] < 1 || v[1] < 1)
+				return fail("expected two counts after");
+
+			auto &m = static_cast<mesh &>(out.add(surface_kind::mesh));
+			if (key == "sphere_mesh")
+				tessellate_sphere(m, static_cast<size_t>(v[0]), static_cast<size_t>(v[1]));
+			else
+				tessellate_cone(m, static_cast<size_t>(v[0]), static_cast<size_t>(v[1]));
+
+			m.build();
+			start(m);
+		}
+		else if (key == "torus" || key == "torus_mesh")
+		{
+			bool meshed = key == "torus_mesh";
+			if (!in.numbers(v, meshed ? 4 : 2) || v[0] < 0 || v[1] <= 0 || (meshed && (v[2] < 1 || v[3] < 1)))
+				return fail(meshed ? "expected R r divs tube_divs after" : "expected R r after");
+
+			if (!meshed)
+			{
+				auto &t = static_cast<torus &>(out.add(surface_kind::torus));
+				t.r_torus = v[0];
+				t.r_tube = v[1];
+				start(t);
+			}
+			else
+			{
+				auto &m = static_cast<mesh &>(out.add(surface_kind::mesh));
+				tessellate_torus(m, v[0], v[1], static_cast<size_t>(v[2]), static_cast<size_t>(v[3]));
+				m.build();
+				start(m);
+			}
+		}
+		else if (key == "sdf")
+		{
+			auto name = in.word();
+			auto found = std::find(sdf_shapes.begin(), sdf_shapes.end(), name);
+			if (found == sdf_shapes.end())
+				return fail("expected the name of a built in field after");
+
+			auto &field = static_cast<sdf_base &>(out.add(surface_kind::sdf, static_cast<uint32_t>(found - sdf_shapes.begin())));
+
+			if (in.number(v[0]))
+			{
+				if (v[0] < 1)
+					return fail("expected at least 1 step for");
+
+				field.limits.max_steps = static_cast<size_t>(v[0]);
+
+				if (in.number(v[1]))
+				{
+					if (v[1] < 1 || v[1] >= 2)
+						return fail("expected a relax from 1 to 2 for");
+
+					field.limits.relax = v[1];
+				}
+			}
+
+			start(field);
+		}
+		else if (key == "csg")
+		{
+			auto op_name = in.word();
+			csg_op op;
+
+			if (op_name == "union")
+				op = csg_op::unite;
+			else if (op_name == "intersection")
+				op = csg_op::intersect;
+			else if (op_name == "difference")
+				op = csg_op::subtract;
+			else
+				return fail("expected union, intersection, or difference after");
+
+			surface *operands[2] = { out.find(in.word()), out.find(in.word()) };
+
+			// the last surface is set moving before it's looked at, and before the node's bounds are built from it
+			finish();
+
+			for (auto obj : operands)
+			{
+				if (!obj)
+					return fail("expected the names of two surfaces after");
+
+				auto at = std::find(out.surfaces.begin(), out.surfaces.end(), obj) - out.surfaces.begin();
+				if (!solid_kind(out.kinds[at]))
+					return fail("only spheres, planes, cones, and csg nodes can be operands of");
+
+				if (obj->moving())
+					return fail("surfaces that move can't be operands of");
+			}
+
+			auto &node = static_cast<csg &>(out.add(surface_kind::csg));
+			node.op = op;
+			node.left = operands[0];
+			node.right = operands[1];
+			node.build();
+
+			start(node);
+		}
+		else if (key == "instance")
+		{
+			auto name = in.word();
+			auto shape = out.find(name);
+			if (!shape)
+				return fail("no surface by that name for");
+
+			finish();
+
+			if (shape->moving())
+				return fail("surfaces that move can't be copied by");
+
+			auto set = std::find_if(out.instance_sets.begin(), out.instance_sets.end(), [&](auto &s) { return s.shape == shape; });
+			if (set == out.instance_sets.end())
+			{
+				auto &added = static_cast<instance_set &>(out.add(surface_kind::instances));
+				added.shape = shape;
+				set = out.instance_sets.end() - 1;
+			}
+
+			copying = &*set;
+			copy_transforms = identity();
+			copy_look = shape->material;
+
+			current = nullptr;
+			transforms = &copy_transforms;
+			look = &copy_look;
+		}
+		else if (!surface_statement(key))
+		{
+			return fail("unknown statement");
+		}
+		else if (!transforms)
+		{
+			return fail("no surface yet for");
+		}
+		else if (key == "name")
+		{
+			if (!current)
+				return fail("copies can't take");
+
+			auto name = in.word();
+			if (name.empty())
+				return fail("expected a name after");
+
+			out.names.emplace_back(std::string(name), current);
+		}
+		else if (key == "moving")
+		{
+			if (moves)
+				return fail("already");
+
+			// the transforms that follow go on top of where it is by then, to where it ends up
+			moves = true;
+			end_transforms = *transforms;
+			transforms = &end_transforms;
+		}
+		else if (key == "translate")
+		{
+			if (!in.numbers(v, 3))
+				return fail("expected x y z after");
+
+			*transforms = *transforms * translate(v[0], v[1], v[2]);
+		}
+		else if (key == "scale")
+		{
+			if (!in.number(v[0]))
+				return fail("expected k or x y z after");
+
+			// one number scales evenly
+			if (!in.number(v[1]))
+				*transforms = *transforms * scale(v[0]);
+			else if (in.number(v[2]))
+				*transforms = *transforms * scale(v[0], v[1], v[2]);
+			else
+				return fail("expected k or x y z after");
+		}
+		else if (key == "rotx" || key == "roty" || key == "rotz")
+		{
+			if (!in.number(v[0]))
+				return fail("expected degrees after");
+
+			double rad = v[0] / 180 * M_PI;
+			*transforms = *transforms * (key == "rotx" ? rotx(rad) : key == "roty" ? roty(rad) : rotz(rad));
+		}
+		else if (key == "color")
+		{
+			if (!in.numbers(v, 3))
+				return fail("expected r g b after");
+
+			look->color = vec3d{{ v[0], v[1], v[2] }};
+		}
+		else if (key == "ambient" || key == "diffuse" || key == "specular" || key == "reflect" || key == "fallout")
+		{
+			if (!in.number(v[0]))
+				return fail("expected a number after");
+
+			auto &mat = *look;
+			(key == "ambient" ? mat.k_ambient : key == "diffuse" ? mat.k_diffuse : key == "specular" ? mat.k_specular :
+				key == "reflect" ? mat.k_reflect : mat.fallout) = v[0];
+		}
+	}
+
+	finish();
+
+	for (auto &set : out.instance_sets)
+		set.build();
+
+	collect_objects(out);
+	return true;
+}
+
+bool parse_scene(std::string_view text, scene_data &out, std::string &error)
+{
+	if (!parse_statements(text, out, error))
+		return false;
+
+	out.lights.build_tree();
+	return true;
+}
+
+// a file mapped read only into memory
+class mapped_file
+{
+public:
+	explicit mapped_file(const std::string &path);
+	~mapped_file();
+
+	mapped_file(const mapped_file &) = delete;
+	mapped_file &operator=(const mapped_file &) = delete;
+
+	bool is_open() const { return opened; }
+	const char *data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	bool opened = false;
+	const char *bytes = nullptr; // stays nullptr for an empty file, those can't be mapped
+	size_t length = 0;
+
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+};
+
+#if defined(_WIN32)
+mapped_file::mapped_file(const std::string &path)
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+		return;
+
+	length = static_cast<size_t>(size.QuadPart);
+	if (length == 0)
+	{
+		opened = true;
+		return;
+	}
+
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+		return;
+
+	bytes = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	opened = bytes != nullptr;
+}
+
+mapped_file::~mapped_file()
+{
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+#else
+mapped_file::mapped_file(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat info;
+	if (fstat(fd, &info) == 0)
+	{
+		length = static_cast<size_t>(info.st_size);
+
+		if (length == 0)
+		{
+			opened = true;
+		}
+		else
+		{
+			void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p != MAP_FAILED)
+			{
+				bytes = static_cast<const char *>(p);
+				opened = true;
+			}
+		}
+	}
+
+	close(fd); // the mapping holds on to the file
+}
+
+mapped_file::~mapped_file()
+{
+	if (bytes)
+		munmap(const_cast<char *>(bytes), length);
+}
+#endif
+
+// hash of the text a cache was compiled from, 8 bytes a step so checking it costs next to nothing next to parsing
+static uint64_t text_hash(const char *data, size_t size)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+
+	auto mix = [&h](uint64_t word)
+	{
+		h = (h ^ word) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	};
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		mix(word);
+	}
+
+	uint64_t tail = 0;
+	if (i < size)
+		std::memcpy(&tail, data + i, size - i);
+	mix(tail);
+
+	// murmur3's finalizer
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+
+	return h;
+}
+
+// the compiled form of a scene: cache_header, then its cache_lights, cache_surfaces, and cache_names,
+// then the arrays of every surface that has any, built, and last the characters of the names
+// every record and array is padded to a multiple of 8 bytes, so they all stay aligned in the mapping
+const uint32_t cache_version = 8;
+
+struct cache_header
+{
+	char magic[8]; // "A4SCENE"
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t text_hash;
+	uint64_t text_size;
+	double eye[3], gaze[3], up[3];
+	uint64_t lights, surfaces, names, name_chars;
+};
+
+struct cache_light
+{
+	double position[3];
+	double intensity;
+	uint32_t kind;
+	uint32_t reserved;
+	double u[3], v[3];
+	double radius;
+};
+
+struct cache_surface
+{
+	uint32_t kind;
+	uint32_t reserved;
+	double transforms[16];
+	double color[3];
+	double k_ambient, k_diffuse, k_specular, k_reflect, fallout;
+	uint64_t vertices, triangles, nodes; // meshes only, but nodes for instance sets too
+	uint64_t normals; // 1 when the mesh has vertex normals
+	uint64_t shape, instances, looks; // instance sets only, shape is the index of a surface before it
+	uint64_t moves; // instance sets only, steps of the instances that move
+	double r_torus, r_tube; // tori only
+	uint64_t left, right, op; // csg nodes only, left and right are indices of surfaces before it
+	uint64_t field, max_steps; // sdfs only, field is the shape number
+	double relax;
+	uint64_t moving; // 1 when it moves over the shutter, its end_transforms are the first of its arrays
+};
+
+struct cache_name
+{
+	uint64_t object;
+	uint64_t first, length; // in the characters at the end
+};
+
+static void put(const vec3d &v, double *out)
+{
+	for (size_t i = 0; i < 3; ++i)
+		out[i] = v.at(i, 0);
+}
+
+static vec3d get(const double *in)
+{
+	return vec3d{{ in[0], in[1], in[2] }};
+}
+
+static uint64_t padded(uint64_t bytes)
+{
+	return (bytes + 7) / 8 * 8;
+}
+
+// whether a hierarchy read from a cache is one traverse() can walk without reading past the end of it or of its stack
+// every inner node's children come after it, so walking it ends, and every leaf is within the items primitives
+static bool sound_tree(const mapped_array<bvh_node> &nodes, uint64_t items)
+{
+	if (nodes.empty())
+		return true;
+
+	std::vector<std::pair<uint64_t, size_t>> open{ { 0, 0 } }; // node and how deep it is
+	while (!open.empty())
+	{
+		auto [n, depth] = open.back();
+		open.pop_back();
+
+		auto &node = nodes[n];
+		if (node.count > 0)
+		{
+			if (node.first > items || node.count > items - node.first)
+				return false;
+
+			continue;
+		}
+
+		if (depth + 1 >= bvh_max_depth || node.axis > 2 || n + 1 >= nodes.size() || node.right <= n + 1 || node.right >= nodes.size())
+			return false;
+
+		open.push_back({ n + 1, depth + 1 });
+		open.push_back({ node.right, depth + 1 });
+	}
+
+	return true;
+}
+
+// bytes the arrays of a surface take in the cache
+// the end transforms of one that moves, then positions, normals, triangles, and nodes for a mesh, instances, the
+// materials of the looks, nodes, and the steps of the instances that move for an instance set
+static uint64_t array_bytes_of(const cache_surface &s)
+{
+	uint64_t bytes = s.moving ? sizeof(mat4d) : 0;
+
+	if (s.kind == static_cast<uint32_t>(surface_kind::mesh))
+		bytes += (s.normals ? 6 : 3) * s.vertices * sizeof(double) + 3 * padded(s.triangles * sizeof(uint32_t)) + s.nodes * sizeof(bvh_node);
+
+	if (s.kind == static_cast<uint32_t>(surface_kind::instances))
+		bytes += s.instances * sizeof(instance) + s.looks * sizeof(material) + s.nodes * sizeof(bvh_node) + s.moves * sizeof(mat4d);
+
+	return bytes;
+}
+
+// a std::vector or a mapped_array
+template<typename A>
+static void write_array(std::ofstream &out, const A &v)
+{
+	static const char zeros[8] = {};
+	uint64_t bytes = v.size() * sizeof(*v.data());
+
+	out.write(reinterpret_cast<const char *>(v.data()), bytes);
+	out.write(zeros, padded(bytes) - bytes);
+}
+
+// copies count Ts out of the mapping at p into v, returns what follows them
+template<typename T>
+static const char *read_array(const char *p, uint64_t count, std::vector<T> &v)
+{
+	v.resize(count);
+	std::memcpy(v.data(), p, count * sizeof(T));
+
+	return p + padded(count * sizeof(T));
+}
+
+// points v at the count Ts in the mapping at p, returns what follows them
+template<typename T>
+static const char *point_array(const char *p, uint64_t count, mapped_array<T> &v)
+{
+	v.point_at(reinterpret_cast<const T *>(p), count);
+
+	return p + padded(count * sizeof(T));
+}
+
+static bool write_cache(const std::string &path, const scene_data &scene, uint64_t hash, uint64_t size)
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		return false;
+
+	cache_header header{};
+	std::memcpy(header.magic, "A4SCENE", 8);
+	header.version = cache_version;
+	header.text_hash = hash;
+	header.text_size = size;
+	put(scene.eye, header.eye);
+	put(scene.gaze, header.gaze);
+	put(scene.up, header.up);
+	header.lights = scene.lights.size();
+	header.surfaces = scene.surfaces.size();
+	header.names = scene.names.size();
+
+	for (auto &entry : scene.names)
+		header.name_chars += entry.first.size();
+
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+	for (size_t i = 0; i < scene.lights.size(); ++i)
+	{
+		auto &shape = scene.lights.shapes[i];
+
+		cache_light l{};
+		put(scene.lights.position(i), l.position);
+		l.intensity = scene.lights.intensity[i];
+		l.kind = static_cast<uint32_t>(shape.kind);
+		put(shape.u, l.u);
+		put(shape.v, l.v);
+		l.radius = shape.radius;
+
+		out.write(reinterpret_cast<const char *>(&l), sizeof(l));
+	}
+
+	for (size_t i = 0; i < scene.surfaces.size(); ++i)
+	{
+		auto obj = scene.surfaces[i];
+
+		cache_surface s{};
+		s.kind = static_cast<uint32_t>(scene.kinds[i]);
+		for (size_t j = 0; j < 16; ++j)
+			s.transforms[j] = obj->transforms.at(j / 4, j % 4);
+		put(obj->material.color, s.color);
+		s.k_ambient = obj->material.k_ambient;
+		s.k_diffuse = obj->material.k_diffuse;
+		s.k_specular = obj->material.k_specular;
+		s.k_reflect = obj->material.k_reflect;
+		s.fallout = obj->material.fallout;
+
+		// the motion itself is worked out again from the ends, it's only a few inverses
+		s.moving = obj->motion.empty() ? 0 : 1;
+
+		if (scene.kinds[i] == surface_kind::mesh)
+		{
+			auto m = static_cast<const mesh *>(obj);
+			s.vertices = m->vertex_count();
+			s.triangles = m->triangle_count();
+			s.nodes = m->nodes.size();
+			s.normals = m->nx.empty() ? 0 : 1;
+		}
+		else if (scene.kinds[i] == surface_kind::torus)
+		{
+			auto t = static_cast<const torus *>(obj);
+			s.r_torus = t->r_torus;
+			s.r_tube = t->r_tube;
+		}
+		else if (scene.kinds[i] == surface_kind::sdf)
+		{
+			auto field = static_cast<const sdf_base *>(obj);
+			s.field = field->shape;
+			s.max_steps = field->limits.max_steps;
+			s.relax = field->limits.relax;
+		}
+		else if (scene.kinds[i] == surface_kind::csg)
+		{
+			auto node = static_cast<const csg *>(obj);
+			s.left = std::find(scene.surfaces.begin(), scene.surfaces.end(), node->left) - scene.surfaces.begin();
+			s.right = std::find(scene.surfaces.begin(), scene.surfaces.end(), node->right) - scene.surfaces.begin();
+			s.op = static_cast<uint64_t>(node->op);
+		}
+		else if (scene.kinds[i] == surface_kind::instances)
+		{
+			auto set = static_cast<const instance_set *>(obj);
+			s.shape = std::find(scene.surfaces.begin(), scene.surfaces.end(), set->shape) - scene.surfaces.begin();
+			s.instances = set->instances.size();
+			s.looks = set->looks.size();
+			s.nodes = set->nodes.size();
+			s.moves = set->instance_motion.size();
+		}
+
+		out.write(reinterpret_cast<const char *>(&s), sizeof(s));
+	}
+
+	uint64_t first = 0;
+	for (auto &entry : scene.names)
+	{
+		cache_name n{};
+		n.object = std::find(scene.surfaces.begin(), scene.surfaces.end(), entry.second) - scene.surfaces.begin();
+		n.first = first;
+		n.length = entry.first.size();
+		first += n.length;
+
+		out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+	}
+
+	for (size_t i = 0; i < scene.surfaces.size(); ++i)
+	{
+		// kept out of the records, nearly every surface stands still and would carry 128 bytes for nothing
+		if (!scene.surfaces[i]->motion.empty())
+			write_array(out, std::vector<mat4d>{ scene.surfaces[i]->end_transforms });
+
+		if (scene.kinds[i] == surface_kind::instances)
+		{
+			auto set = static_cast<const instance_set *>(scene.surfaces[i]);
+
+			std::vector<material> looks;
+			for (auto &l : set->looks)
+				looks.push_back(l.material);
+
+			write_array(out, set->instances);
+			write_array(out, looks);
+			write_array(out, set->nodes);
+			write_array(out, set->instance_motion);
+			continue;
+		}
+
+		if (scene.kinds[i] != surface_kind::mesh)
+			continue;
+
+		auto m = static_cast<const mesh *>(scene.surfaces[i]);
+
+		write_array(out, m->x);
+		write_array(out, m->y);
+		write_array(out, m->z);
+
+		if (!m->nx.empty())
+		{
+			write_array(out, m->nx);
+			write_array(out, m->ny);
+			write_array(out, m->nz);
+		}
+
+		write_array(out, m->a);
+		write_array(out, m->b);
+		write_array(out, m->c);
+		write_array(out, m->nodes);
+	}
+
+	for (auto &entry : scene.names)
+		out.write(entry.first.data(), entry.first.size());
+
+	return out.good();
+}
+
+// fills out from a mapped cache, false when it's not one, or not of the text with that hash
+static bool read_cache(const mapped_file &file, scene_data &out, uint64_t hash, uint64_t size)
+{
+	cache_header header;
+	if (file.size() < sizeof(header))
+		return false;
+
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	if (std::memcmp(header.magic, "A4SCENE", 8) != 0 || header.version != cache_version ||
+		header.text_hash != hash || header.text_size != size)
+		return false;
+
+	uint64_t fixed = sizeof(header) + header.lights * sizeof(cache_light) + header.surfaces * sizeof(cache_surface) +
+		header.names * sizeof(cache_name);
+	if (file.size() < fixed + header.name_chars)
+		return false;
+
+	out.eye = get(header.eye);
+	out.gaze = get(header.gaze);
+	out.up = get(header.up);
+
+	auto lights = reinterpret_cast<const cache_light *>(file.data() + sizeof(header));
+	auto surfaces = reinterpret_cast<const cache_surface *>(lights + header.lights);
+	auto names = reinterpret_cast<const cache_name *>(surfaces + header.surfaces);
+	auto arrays = reinterpret_cast<const char *>(names + header.names);
+
+	uint64_t array_bytes = 0;
+	for (size_t i = 0; i < header.surfaces; ++i)
+		array_bytes += array_bytes_of(surfaces[i]);
+
+	if (file.size() != fixed + array_bytes + header.name_chars)
+		return false;
+
+	auto chars = arrays + array_bytes;
+
+	out.surfaces.reserve(header.surfaces);
+	out.kinds.reserve(header.surfaces);
+
+	for (size_t i = 0; i < header.lights; ++i)
+	{
+		auto &l = lights[i];
+		if (l.kind > static_cast<uint32_t>(light_kind::sphere))
+			return false;
+
+		light_shape shape{ static_cast<light_kind>(l.kind), get(l.u), get(l.v), l.radius };
+		out.lights.add({ {{ l.position[0], l.position[1], l.position[2], 1.0 }}, l.intensity, shape });
+	}
+
+	for (size_t i = 0; i < header.surfaces; ++i)
+	{
+		auto &s = surfaces[i];
+		if (s.kind > static_cast<uint32_t>(surface_kind::sdf))
+			return false;
+
+		if (s.kind == static_cast<uint32_t>(surface_kind::sdf) && s.field >= sdf_shapes.size())
+			return false;
+
+		// the shape has to be read already, and can't be copies itself or move
+		if (s.kind == static_cast<uint32_t>(surface_kind::instances) &&
+			(s.shape >= i || surfaces[s.shape].kind == static_cast<uint32_t>(surface_kind::instances) || surfaces[s.shape].moving))
+			return false;
+
+		auto &obj = out.add(static_cast<surface_kind>(s.kind), static_cast<uint32_t>(s.field));
+		for (size_t j = 0; j < 16; ++j)
+			obj.transforms.at(j / 4, j % 4) = s.transforms[j];
+
+		obj.material = { get(s.color), s.k_ambient, s.k_diffuse, s.k_specular, s.k_reflect, s.fallout };
+
+		if (s.moving)
+		{
+			mat4d end;
+			std::memcpy(&end, arrays, sizeof(end));
+			arrays += sizeof(end);
+
+			obj.move_to(end);
+		}
+
+		if (s.kind == static_cast<uint32_t>(surface_kind::sdf))
+		{
+			auto &field = static_cast<sdf_base &>(obj);
+			field.limits.max_steps = s.max_steps;
+			field.limits.relax = s.relax;
+			continue;
+		}
+
+		if (s.kind == static_cast<uint32_t>(surface_kind::csg))
+		{
+			if (s.left >= i || s.right >= i || s.op > static_cast<uint64_t>(csg_op::subtract) ||
+				!solid_kind(out.kinds[s.left]) || !solid_kind(out.kinds[s.right]) ||
+				out.surfaces[s.left]->moving() || out.surfaces[s.right]->moving())
+				return false;
+
+			auto &node = static_cast<csg &>(obj);
+			node.op = static_cast<csg_op>(s.op);
+			node.left = out.surfaces[s.left];
+			node.right = out.surfaces[s.right];
+			node.build();
+			continue;
+		}
+
+		if (s.kind == static_cast<uint32_t>(surface_kind::torus))
+		{
+			auto &t = static_cast<torus &>(obj);
+			t.r_torus = s.r_torus;
+			t.r_tube = s.r_tube;
+			continue;
+		}
+
+		if (s.kind == static_cast<uint32_t>(surface_kind::instances))
+		{
+			auto &set = static_cast<instance_set &>(obj);
+			set.shape = out.surfaces[s.shape];
+			set.shape_inverse = invert(set.shape->transforms);
+
+			// only the looks are copied out, hits point at them as surfaces
+			std::vector<material> looks;
+			arrays = point_array(arrays, s.instances, set.instances);
+			arrays = read_array(arrays, s.looks, looks);
+			arrays = point_array(arrays, s.nodes, set.nodes);
+			arrays = point_array(arrays, s.moves, set.instance_motion);
+
+			for (auto &l : looks)
+				set.looks.emplace_back().material = l;
+
+			for (auto &inst : set.instances)
+				if (inst.look >= s.looks || (inst.motion != instance::still && (s.moves < motion_steps + 1 || inst.motion > s.moves - motion_steps - 1)))
+					return false;
+
+			if (!sound_tree(set.nodes, s.instances))
+				return false;
+
+			continue;
+		}
+
+		if (s.kind != static_cast<uint32_t>(surface_kind::mesh))
+			continue;
+
+		// used where they are in the mapping, the hierarchy included, nothing gets built again
+		auto &m = static_cast<mesh &>(obj);
+
+		arrays = point_array(arrays, s.vertices, m.x);
+		arrays = point_array(arrays, s.vertices, m.y);
+		arrays = point_array(arrays, s.vertices, m.z);
+
+		if (s.normals)
+		{
+			arrays = point_array(arrays, s.vertices, m.nx);
+			arrays = point_array(arrays, s.vertices, m.ny);
+			arrays = point_array(arrays, s.vertices, m.nz);
+		}
+
+		arrays = point_array(arrays, s.triangles, m.a);
+		arrays = point_array(arrays, s.triangles, m.b);
+		arrays = point_array(arrays, s.triangles, m.c);
+		arrays = point_array(arrays, s.nodes, m.nodes);
+
+		// a corrupt cache can say anything, indices are checked before anything reads through them
+		for (size_t t = 0; t < s.triangles; ++t)
+			if (m.a[t] >= s.vertices || m.b[t] >= s.vertices || m.c[t] >= s.vertices)
+				return false;
+
+		if (!sound_tree(m.nodes, s.triangles))
+			return false;
+	}
+
+	for (size_t i = 0; i < header.names; ++i)
+	{
+		auto &n = names[i];
+		if (n.object >= header.surfaces || n.first + n.length > header.name_chars)
+			return false;
+
+		out.names.emplace_back(std::string(chars + n.first, n.length), out.surfaces[n.object]);
+	}
+
+	collect_objects(out);
+	return true;
+}
+
+bool load_scene(const std::string &path, scene_data &out, std::string &error, bool *cached)
+{
+	mapped_file text(path);
+	if (!text.is_open())
+	{
+		error = "can't read " + path;
+		return false;
+	}
+
+	uint64_t hash = text_hash(text.data(), text.size());
+	auto cache_path = path + ".bin";
+
+	if (cached)
+		*cached = false;
+
+	{
+		auto cache = std::make_shared<const mapped_file>(cache_path);
+
+		scene_data from_cache;
+		if (cache->is_open() && read_cache(*cache, from_cache, hash, text.size()))
+		{
+			from_cache.cache = std::move(cache);
+			from_cache.lights.build_tree();
+			out = std::move(from_cache);
+
+			if (cached)
+				*cached = true;
+
+			return true;
+		}
+	}
+
+	scene_data parsed;
+	if (!parse_statements(std::string_view(text.data(), text.size()), parsed, error))
+	{
+		error = path + ", " + error;
+		return false;
+	}
+
+	// no cache only means a slower start next time
+	write_cache(cache_path, parsed, hash, text.size());
+
+	parsed.lights.build_tree();
+	out = std::move(parsed);
+
+	return true;
+}
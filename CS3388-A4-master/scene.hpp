@@ -0,0 +1,106 @@
+#ifndef A4_SCENE_HPP
+#define A4_SCENE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "vector.hpp"
+#include "light.hpp"
+#include "surface.hpp"
+#include "sphere.hpp"
+#include "plane.hpp"
+#include "cone.hpp"
+#include "torus.hpp"
+#include "mesh.hpp"
+#include "instances.hpp"
+#include "csg.hpp"
+#include "sdf.hpp"
+
+// scene files are text, one statement after another, split by any whitespace, # starts a comment to the end of the line
+//
+//   eye x y z, gaze x y z, up x y z      the camera, the A4 one by default
+//   light x y z intensity                a point light
+//     rect ux uy uz vx vy vz             makes the last light a rect with those edges, centered on it
+//     radius r                           makes the last light a ball
+//   sphere, plane, cone                  starts a surface, what follows until the next one applies to it
+//   sphere_mesh lat long                 starts a triangle mesh of the unit sphere, lat x long quads
+//   cone_mesh divs rings                 starts a triangle mesh of the cone, divs x rings quads
+//   torus R r                            starts a torus with a ring of radius R and a tube of radius r
+//   torus_mesh R r divs tube_divs        starts a triangle mesh of that torus, divs x tube_divs quads
+//   sdf shape [steps [relax]]            starts a surface traced through a built in distance field (see sdf_shapes), with
+//                                        rays given up on after steps steps (256) and steps relax times the distance (1.2)
+//   csg op a b                           starts the union, intersection, or difference (op) of the surfaces named a and b,
+//                                        spheres, cones, planes, or other csg nodes, taken as solids, placed where they are
+//                                        by then, with the materials they have, and only drawn through it
+//                                        a plane is the half space behind it
+//   instance n                           starts a copy of the surface named n, where the surface itself is with its
+//                                        material as it is by then, transforms and materials that follow apply to the copy
+//                                        a surface that has copies is only drawn through them, copies can't be named
+//     name n                             so it can be found with find()
+//     translate x y z, scale k, scale x y z, rotx deg, roty deg, rotz deg
+//                                        transforms, they stack in the order written, like they would in code
+//     moving                             the transforms that follow don't place it but move it over the shutter, from where
+//                                        it is by then to where they stack up to, a surface that moves can't be copied or
+//                                        be an operand of a csg node, the copies or the node can move instead
+//     color r g b, ambient k, diffuse k, specular k, reflect k, fallout k
+//                                        its material
+//
+// lights have an intensity of 1, surfaces are white with 0.1 ambient, 1 diffuse, 255 specular and 256 fallout until told otherwise
+
+enum class surface_kind : uint32_t { sphere, plane, cone, mesh, instances, torus, csg, sdf };
+
+class mapped_file;
+
+// everything a scene file describes
+// surfaces are kept in a deque per kind, they're allocated a block at a time and never move
+struct scene_data
+{
+	vec3d eye{{ 0, 40, 80 }}, gaze{{ 0, 0, 0 }}, up{{ 0, 1, 0 }};
+
+	light_list lights;
+
+	std::vector<surface *> objects; // what gets drawn, what the renderer takes, filled once the whole scene is read
+	std::vector<surface *> surfaces; // every surface in the order they were written, the ones that have copies too
+	std::vector<surface_kind> kinds; // of each of surfaces
+	std::vector<std::pair<std::string, surface *>> names; // only the surfaces that were given one
+
+	std::deque<sphere> spheres;
+	std::deque<plane> planes;
+	std::deque<cone> cones;
+	std::deque<torus> tori;
+	std::deque<mesh> meshes;
+	std::deque<instance_set> instance_sets; // one per surface that has copies, holding all of them
+	std::deque<csg> csgs;
+	std::vector<std::unique_ptr<sdf_base>> sdfs; // each a different type, one per field
+
+	// the compiled form it was read from, kept mapped as the arrays of its meshes and instance sets point into it
+	std::shared_ptr<const mapped_file> cache;
+
+	scene_data() = default;
+	scene_data(scene_data &&) = default;
+	scene_data &operator=(scene_data &&) = default;
+
+	// adds a surface with the default material, shape picks the field of an sdf, which has to be one of sdf_shapes
+	surface &add(surface_kind kind, uint32_t shape = 0);
+
+	// the surface given that name, nullptr if there's none
+	surface *find(std::string_view name) const;
+};
+
+// reads a scene from text, returns false and says where it went wrong in error when it can't
+bool parse_scene(std::string_view text, scene_data &out, std::string &error);
+
+// reads the scene file at path
+// its compiled form is kept next to it, at path + ".bin", and memory mapped instead of parsing the text when it's there
+// and was compiled from text with the same hash, otherwise the text is parsed and the cache written for next time
+// a scene read from the cache builds only its surfaces, the vertices, triangles, instances and hierarchies are used
+// where they are in the mapping
+// returns false and says why in error when the text can't be read or parsed, cached says whether the cache was used
+bool load_scene(const std::string &path, scene_data &out, std::string &error, bool *cached = nullptr);
+
+#endif //A4_SCENE_HPP
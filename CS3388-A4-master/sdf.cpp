@@ -0,0 +1,60 @@
+#include "sdf.hpp"
+
+uint64_t &sdf_steps()
+{
+	thread_local uint64_t steps = 0;
+	return steps;
+}
+
+const std::array<std::string_view, 4> sdf_shapes = { "blob", "pillars", "sponge", "rings" };
+
+template<sdf_field F>
+static std::unique_ptr<sdf_base> made(uint32_t shape, const F &field)
+{
+	auto s = std::make_unique<sdf_surface<F>>(field);
+	s->shape = shape;
+
+	return s;
+}
+
+std::unique_ptr<sdf_base> make_sdf(uint32_t shape)
+{
+	// each about the size of the unit sphere
+	switch (shape)
+	{
+	case 0:
+		return made(shape, blend(blend(moved(sdf_sphere{ {}, 0.6 }, -0.4, 0, 0), moved(sdf_sphere{ {}, 0.5 }, 0.45, 0.1, 0), 0.5),
+			moved(sdf_sphere{ {}, 0.35 }, 0, 0.55, 0.1), 0.4));
+	case 1:
+	{
+		// a pillar is a box with its edges rounded off by a ball
+		auto pillar = blend(sdf_box{ {}, 0.08, 1, 0.08 }, moved(sdf_sphere{ {}, 0.14 }, 0, 1, 0), 0.1);
+		return made(shape, repeated(pillar, 1.0 / 3, 3));
+	}
+	case 2:
+		return made(shape, sdf_menger{});
+	case 3:
+	{
+		auto ring = sdf_torus{ {}, 0.6, 0.15 };
+		auto other = moved(sdf_torus{ {}, 0.6, 0.15 }, 0.6, 0, 0);
+
+		// the second ring stands up through the first, turned about x by swapping y and z
+		struct standing : sdf_node
+		{
+			sdf_moved<sdf_torus> a;
+
+			double operator()(const sdf_point &p) const { return a({ p.x, p.z, p.y }); }
+
+			bounds box() const
+			{
+				auto b = a.box();
+				return { vec3d{{ b.lo.x(), b.lo.z(), b.lo.y() }}, vec3d{{ b.hi.x(), b.hi.z(), b.hi.y() }} };
+			}
+		};
+
+		return made(shape, ring | standing{ {}, other });
+	}
+	default:
+		return nullptr;
+	}
+}
@@ -0,0 +1,369 @@
+#ifndef A4_SDF_HPP
+#define A4_SDF_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+#include "surface.hpp"
+#include "vector.hpp"
+
+// signed distance fields, built as expression templates so a whole field compiles down to one function
+// a field is a struct deriving from sdf_node with
+//   double operator()(const sdf_point &p) const, the distance from p to the surface, negative inside, never more than
+//     the true distance so tracing can step that far
+//   bounds box() const, around where it's negative
+
+struct sdf_node {};
+
+template<typename F>
+concept sdf_field = std::is_base_of_v<sdf_node, F>;
+
+struct sdf_point
+{
+	double x, y, z;
+};
+
+inline double length(double x, double y, double z)
+{
+	return std::sqrt(x * x + y * y + z * z);
+}
+
+struct sdf_sphere : sdf_node
+{
+	double r = 1;
+
+	double operator()(const sdf_point &p) const { return length(p.x, p.y, p.z) - r; }
+	bounds box() const { return { vec3d{{ -r, -r, -r }}, vec3d{{ r, r, r }} }; }
+};
+
+struct sdf_box : sdf_node
+{
+	double hx = 1, hy = 1, hz = 1; // half sides
+
+	double operator()(const sdf_point &p) const
+	{
+		double qx = std::abs(p.x) - hx, qy = std::abs(p.y) - hy, qz = std::abs(p.z) - hz;
+		return length(std::max(qx, 0.0), std::max(qy, 0.0), std::max(qz, 0.0)) + std::min(std::max({ qx, qy, qz }), 0.0);
+	}
+
+	bounds box() const { return { vec3d{{ -hx, -hy, -hz }}, vec3d{{ hx, hy, hz }} }; }
+};
+
+// ring around the y axis, like the torus surface
+struct sdf_torus : sdf_node
+{
+	double r_torus = 1, r_tube = 0.25;
+
+	double operator()(const sdf_point &p) const { return length(std::hypot(p.x, p.z) - r_torus, p.y, 0) - r_tube; }
+
+	bounds box() const
+	{
+		double outer = r_torus + r_tube;
+		return { vec3d{{ -outer, -r_tube, -outer }}, vec3d{{ outer, r_tube, outer }} };
+	}
+};
+
+// the cube from -1 to 1 with crosses cut through it, again and again in every ninth of it, iterations times
+struct sdf_menger : sdf_node
+{
+	int iterations = 3;
+
+	double operator()(const sdf_point &p) const
+	{
+		double d = sdf_box{}(p);
+		double s = 1;
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			auto wrap = [s](double v) { return v * s - 2 * std::floor(v * s / 2) - 1; }; // into -1 to 1, a cell of this level
+			double ax = std::abs(1 - 3 * std::abs(wrap(p.x)));
+			double ay = std::abs(1 - 3 * std::abs(wrap(p.y)));
+			double az = std::abs(1 - 3 * std::abs(wrap(p.z)));
+			s *= 3;
+
+			double da = std::max(ax, ay), db = std::max(ay, az), dc = std::max(az, ax);
+			double c = (std::min({ da, db, dc }) - 1) / s;
+
+			d = std::max(d, c);
+		}
+
+		return d;
+	}
+
+	bounds box() const { return sdf_box{}.box(); }
+};
+
+template<sdf_field A>
+struct sdf_moved : sdf_node
+{
+	A a;
+	double x, y, z;
+
+	double operator()(const sdf_point &p) const { return a({ p.x - x, p.y - y, p.z - z }); }
+
+	bounds box() const
+	{
+		auto b = a.box();
+		vec3d d{{ x, y, z }};
+		return { b.lo + d, b.hi + d };
+	}
+};
+
+template<sdf_field A, sdf_field B>
+struct sdf_union : sdf_node
+{
+	A a;
+	B b;
+
+	double operator()(const sdf_point &p) const { return std::min(a(p), b(p)); }
+
+	bounds box() const
+	{
+		auto result = a.box();
+		result.add(b.box());
+		return result;
+	}
+};
+
+template<sdf_field A, sdf_field B>
+struct sdf_intersection : sdf_node
+{
+	A a;
+	B b;
+
+	double operator()(const sdf_point &p) const { return std::max(a(p), b(p)); }
+
+	bounds box() const
+	{
+		auto ba = a.box(), bb = b.box();
+		bounds result;
+		for (size_t k = 0; k < 3; ++k)
+		{
+			result.lo.at(k, 0) = std::max(ba.lo.at(k, 0), bb.lo.at(k, 0));
+			result.hi.at(k, 0) = std::min(ba.hi.at(k, 0), bb.hi.at(k, 0));
+		}
+		return result;
+	}
+};
+
+template<sdf_field A, sdf_field B>
+struct sdf_difference : sdf_node
+{
+	A a;
+	B b;
+
+	double operator()(const sdf_point &p) const { return std::max(a(p), -b(p)); }
+	bounds box() const { return a.box(); }
+};
+
+// a union that melts together where they're closer than k
+template<sdf_field A, sdf_field B>
+struct sdf_blend : sdf_node
+{
+	A a;
+	B b;
+	double k;
+
+	double operator()(const sdf_point &p) const
+	{
+		double da = a(p), db = b(p);
+		double h = std::max(k - std::abs(da - db), 0.0) / k;
+		return std::min(da, db) - h * h * k / 4;
+	}
+
+	// the melted part swells out by at most k / 4
+	bounds box() const
+	{
+		auto result = a.box();
+		result.add(b.box());
+		vec3d grow{{ k / 4, k / 4, k / 4 }};
+		return { result.lo - grow, result.hi + grow };
+	}
+};
+
+// copies of a every period along x and z, count of them each way from the middle, a has to fit in a period
+template<sdf_field A>
+struct sdf_repeat : sdf_node
+{
+	A a;
+	double period;
+	int count;
+
+	double operator()(const sdf_point &p) const
+	{
+		auto cell = [&](double v) { return period * std::clamp(std::round(v / period), -1.0 * count, 1.0 * count); };
+		return a({ p.x - cell(p.x), p.y, p.z - cell(p.z) });
+	}
+
+	bounds box() const
+	{
+		auto b = a.box();
+		vec3d grow{{ period * count, 0, period * count }};
+		return { b.lo - grow, b.hi + grow };
+	}
+};
+
+template<sdf_field A, sdf_field B>
+sdf_union<A, B> operator|(const A &a, const B &b) { return { {}, a, b }; }
+
+template<sdf_field A, sdf_field B>
+sdf_intersection<A, B> operator&(const A &a, const B &b) { return { {}, a, b }; }
+
+template<sdf_field A, sdf_field B>
+sdf_difference<A, B> operator-(const A &a, const B &b) { return { {}, a, b }; }
+
+template<sdf_field A, sdf_field B>
+sdf_blend<A, B> blend(const A &a, const B &b, double k) { return { {}, a, b, k }; }
+
+template<sdf_field A>
+sdf_moved<A> moved(const A &a, double x, double y, double z) { return { {}, a, x, y, z }; }
+
+template<sdf_field A>
+sdf_repeat<A> repeated(const A &a, double period, int count) { return { {}, a, period, count }; }
+
+// what bounds the cost of tracing a ray through a field
+struct sdf_limits
+{
+	size_t max_steps = 256; // a ray that hasn't hit after this many steps misses
+	double relax = 1.2; // steps are this many times the distance, and fall back to 1 when they overshoot, more overshoots too often
+	double epsilon = 1e-4; // closer than this to the surface is a hit, in model space
+};
+
+// steps the tracing on this thread has taken, for heatmaps, reset it as needed
+uint64_t &sdf_steps();
+
+// a surface traced through a field, see sdf_surface
+struct sdf_base : surface
+{
+	uint32_t shape = 0; // which of the built in fields, see make_sdf()
+	sdf_limits limits;
+};
+
+// sphere traces field from where the ray enters its box, with over relaxed steps
+// a ray aimed at a point of the surface gets that exact point back, as shadow rays are by reaches()
+template<sdf_field F>
+struct sdf_surface : sdf_base
+{
+	F field;
+
+	explicit sdf_surface(const F &f) : field(f) {}
+
+	virtual bounds model_bounds() const { return field.box(); }
+
+protected:
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double)
+	{
+		auto start = cart(inv * ray_start);
+		auto end = cart(inv * ray_end);
+		auto dir = end - start;
+		double t_end = magnitude(dir);
+		dir = dir / t_end; // distances are along a unit direction
+
+		const double eps = limits.epsilon;
+
+		// where the ray is in the box, grown a little so a ray entering it isn't already on a surface along a side
+		auto box = field.box();
+		double t0 = 0, t1 = std::numeric_limits<double>::infinity();
+
+		for (size_t k = 0; k < 3; ++k)
+		{
+			double s = start.at(k, 0), d = dir.at(k, 0);
+			double ta = (box.lo.at(k, 0) - 4 * eps - s) / d, tb = (box.hi.at(k, 0) + 4 * eps - s) / d;
+			if (ta > tb)
+				std::swap(ta, tb);
+
+			// written so a NaN, from a ray in the plane of a side, leaves the range as it was
+			t0 = ta > t0 ? ta : t0;
+			t1 = tb < t1 ? tb : t1;
+		}
+
+		if (t0 > t1)
+			return {};
+
+		auto at = [&](double t) { return sdf_point{ start.x() + dir.x() * t, start.y() + dir.y() * t, start.z() + dir.z() * t }; };
+
+		double t = t0;
+		double omega = limits.relax;
+		double step = 0, last_radius = 0;
+		bool found = false;
+
+		// a ray leaving the surface, like a reflection, has to get clear of it before a hit counts
+		double side = field(at(t));
+		bool clear = t0 > 0 || std::abs(side) >= eps;
+		double sign = side < 0 ? -1 : 1;
+
+		uint64_t steps = 0;
+		for (; steps < limits.max_steps && t <= t1; ++steps)
+		{
+			double d = sign * field(at(t));
+			double radius = std::abs(d);
+
+			// the spheres of the last two steps don't touch, the relaxed step went through something, go back
+			if (omega > 1 && radius + last_radius < step)
+			{
+				step -= omega * step;
+				omega = 1;
+				t += step;
+				continue;
+			}
+
+			if (!clear)
+			{
+				clear = radius >= 2 * eps;
+			}
+			else if (radius < eps)
+			{
+				found = true;
+				break;
+			}
+
+			// inside after going through, d is negative and steps back out
+			step = (clear ? d : std::max(radius, eps)) * omega;
+			last_radius = radius;
+			t += step;
+		}
+
+		sdf_steps() += steps;
+
+		if (!found)
+			return {};
+
+		// a hit at what the ray was aimed at, within a few steps' worth, is that point
+		if (std::abs(t_end - t) < 16 * eps)
+			t = t_end;
+
+		auto p = at(t);
+
+		// tetrahedron of 4 samples around the hit, the gradient is the normal
+		const double h = eps;
+		double a = field({ p.x + h, p.y - h, p.z - h }), b = field({ p.x - h, p.y - h, p.z + h });
+		double c = field({ p.x - h, p.y + h, p.z - h }), e = field({ p.x + h, p.y + h, p.z + h });
+		vec3d normal{{ a - b - c + e, -a - b + c + e, -a + b - c + e }};
+
+		vec3d point = t == t_end ? end : vec3d{{ p.x, p.y, p.z }};
+
+		return {{
+			norm(cart(dir_to_world(transforms, homo(normal)))),
+			cart(transforms * homo(point)),
+			this
+		}};
+	}
+};
+
+// names of the fields that are built in, a field's shape number is where it is here
+//   blob      three balls blended together
+//   pillars   a 7 x 7 grid of rounded pillars, repeated from one
+//   sponge    a Menger sponge, 3 levels deep
+//   rings     two linked tori
+extern const std::array<std::string_view, 4> sdf_shapes;
+
+// a surface traced through the built in field shape, nullptr when there's no such shape
+std::unique_ptr<sdf_base> make_sdf(uint32_t shape);
+
+#endif //A4_SDF_HPP
@@ -5,9 +5,8 @@
 #include "vector.hpp"
 #include "matrix_utils.hpp"
 
-std::optional<hit> sphere::intersect(const vec4d &ray_start, const vec4d &ray_end)
+std::optional<hit> sphere::intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double)
 {
-	auto inv = invert(transforms);
 	auto start = cart(inv * ray_start);
 	auto end = cart(inv * ray_end);
 	auto dir = norm(end - start); // warp the ray into model space
@@ -58,3 +57,26 @@ std::optional<hit> sphere::intersect(const vec4d &ray_start, const vec4d &ray_en
 
 	return hit2;
 }
+
+bounds sphere::model_bounds() const
+{
+	return { vec3d{{ -1, -1, -1 }}, vec3d{{ 1, 1, 1 }} }; // unit sphere
+}
+
+bool sphere::model_spans(const vec3d &start, const vec3d &dir, span_list &out)
+{
+	double a = dot(dir, dir);
+	double b = 2 * dot(dir, start);
+	double c = dot(start, start) - 1;
+
+	double discrim = b * b - 4 * a * c;
+	if (discrim <= 0)
+		return true; // misses, or only grazes it
+
+	double t1 = (-b - std::sqrt(discrim)) / (2 * a);
+	double t2 = (-b + std::sqrt(discrim)) / (2 * a);
+
+	// the normal of the unit sphere is the point
+	out.push({ t1, t2, start + dir * t1, start + dir * t2, this, this });
+	return true;
+}
@@ -5,7 +5,11 @@
 
 struct sphere : surface
 {
-	virtual std::optional<hit> intersect(const vec4d &ray_start, const vec4d &ray_end);
+	virtual bounds model_bounds() const;
+	virtual bool model_spans(const vec3d &start, const vec3d &dir, span_list &out);
+
+protected:
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time);
 };
 
 #endif //A4_SPHERE_HPP
@@ -0,0 +1,164 @@
+#include <algorithm>
+
+#include "surface.hpp"
+
+void bounds::add(const vec3d &p)
+{
+	for (size_t a = 0; a < 3; ++a)
+	{
+		lo.at(a, 0) = std::min(lo.at(a, 0), p.at(a, 0));
+		hi.at(a, 0) = std::max(hi.at(a, 0), p.at(a, 0));
+	}
+}
+
+void bounds::add(const bounds &other)
+{
+	add(other.lo);
+	add(other.hi);
+}
+
+std::array<vec3d, 8> bounds::corners() const
+{
+	std::array<vec3d, 8> result;
+
+	for (size_t i = 0; i < 8; ++i)
+	{
+		result[i] = vec3d{{
+			i & 1 ? hi.x() : lo.x(),
+			i & 2 ? hi.y() : lo.y(),
+			i & 4 ? hi.z() : lo.z()
+		}};
+	}
+
+	return result;
+}
+
+void motion_to_start(const mat4d &start, const mat4d &end, mat4d *steps)
+{
+	for (size_t k = 0; k <= motion_steps; ++k)
+	{
+		double t = 1.0 * k / motion_steps;
+		steps[k] = start * invert(start * (1 - t) + end * t);
+	}
+}
+
+mat4d motion_at(const mat4d *steps, double time)
+{
+	double at = std::clamp(time, 0.0, 1.0) * motion_steps;
+	size_t k = std::min(static_cast<size_t>(at), motion_steps - 1);
+	double u = at - k;
+
+	return steps[k] * (1 - u) + steps[k + 1] * u;
+}
+
+bounds swept_bounds(const bounds &box, const mat4d *steps)
+{
+	auto corners = box.corners();
+	bounds result = box;
+
+	for (size_t k = 1; k <= 2 * motion_steps; ++k)
+	{
+		// where the corners are then, the inverse of what takes them back
+		auto from_start = invert(motion_at(steps, 0.5 * k / motion_steps));
+
+		for (auto &c : corners)
+			result.add(cart(from_start * homo(c)));
+	}
+
+	return result;
+}
+
+std::optional<hit> moved_hit(const mat4d &to_start, const vec4d &ray_start, const vec4d &ray_end, const std::optional<hit> &h)
+{
+	if (!h)
+		return {};
+
+	// the same t along both, moving keeps straight lines straight
+	auto start = cart(to_start * ray_start);
+	auto dir = cart(to_start * ray_end) - start;
+	double t = dot(h->world_pt - start, dir) / dot(dir, dir);
+
+	auto world_start = cart(ray_start);
+	auto world_dir = cart(ray_end) - world_start;
+
+	// normals go back through the transpose of what moved the points
+	auto n = to_start.transpose() * vec4d{{ h->normal.x(), h->normal.y(), h->normal.z(), 0 }};
+
+	return hit{ norm(vec3d{{ n.x(), n.y(), n.z() }}), world_start + world_dir * t, h->obj };
+}
+
+void surface::move_to(const mat4d &end)
+{
+	end_transforms = end;
+	motion.resize(motion_steps + 1);
+	motion_to_start(transforms, end, motion.data());
+}
+
+bool surface::moving() const
+{
+	return !motion.empty();
+}
+
+bool surface::reflects() const
+{
+	return material.k_reflect > 0;
+}
+
+bounds surface::world_bounds() const
+{
+	auto box = model_bounds();
+	auto corners = box.corners();
+
+	// the transformed corners of the model box, a box around those is around everything inside
+	auto first = cart(transforms * homo(corners[0]));
+	bounds result{ first, first };
+
+	for (size_t i = 1; i < 8; ++i)
+		result.add(cart(transforms * homo(corners[i])));
+
+	if (!motion.empty())
+		return swept_bounds(result, motion.data());
+
+	return result;
+}
+
+bounds surface::solid_bounds() const
+{
+	return model_bounds();
+}
+
+bool surface::model_spans(const vec3d &, const vec3d &, span_list &)
+{
+	return false;
+}
+
+std::optional<hit> surface::intersect(const vec4d &ray_start, const vec4d &ray_end, double time)
+{
+	if (motion.empty())
+		return intersect_model(invert(transforms), ray_start, ray_end, time);
+
+	// the ray moved back to time 0, where transforms has the surface
+	auto to_start = motion_at(motion.data(), time);
+	return moved_hit(to_start, ray_start, ray_end, intersect_model(invert(transforms), to_start * ray_start, to_start * ray_end, time));
+}
+
+void surface::intersect(const vec4d *ray_starts, const vec4d *ray_ends, size_t count, std::optional<hit> *hits, const double *times)
+{
+	auto inv = invert(transforms);
+
+	if (motion.empty())
+	{
+		for (size_t i = 0; i < count; ++i)
+			hits[i] = intersect_model(inv, ray_starts[i], ray_ends[i], times ? times[i] : 0);
+
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		double time = times ? times[i] : 0;
+		auto to_start = motion_at(motion.data(), time);
+
+		hits[i] = moved_hit(to_start, ray_starts[i], ray_ends[i], intersect_model(inv, to_start * ray_starts[i], to_start * ray_ends[i], time));
+	}
+}
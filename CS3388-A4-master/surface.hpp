@@ -1,6 +1,7 @@
 #ifndef A4_SURFACE_HPP
 #define A4_SURFACE_HPP
 
+#include <array>
 #include <vector>
 #include <optional>
 
@@ -10,16 +11,115 @@
 #include "material.hpp"
 
 struct hit;
+struct surface;
+
+// axis aligned box
+struct bounds
+{
+	vec3d lo, hi;
+
+	// grows the box to take in p
+	void add(const vec3d &p);
+
+	// grows the box to take in other
+	void add(const bounds &other);
+
+	std::array<vec3d, 8> corners() const;
+};
+
+// stretch of a ray inside a solid, between t_in and t_out along it, with the normals and the surfaces where it enters and leaves
+// either end can be infinite, for solids the ray doesn't leave
+struct span
+{
+	double t_in, t_out;
+	vec3d n_in, n_out;
+	surface *in, *out;
+};
+
+// the spans of a ray, sorted and apart from one another
+// kept inline so finding them never allocates, spans past the capacity are dropped, they're the farthest ones
+struct span_list
+{
+	static constexpr size_t capacity = 8;
+
+	std::array<span, capacity> items;
+	size_t count = 0;
+
+	void push(const span &s)
+	{
+		if (count < capacity)
+			items[count++] = s;
+	}
+};
+
+// steps the shutter is split into for things that move while it's open
+constexpr size_t motion_steps = 8;
+
+// motion from start at time 0 to end at time 1, the matrices in between taken linearly
+// kept as what takes the scene at each step back to time 0, start times the inverse of the matrix then, into
+// steps[0] to steps[motion_steps], each worked out exactly, so a ray at any time is moved back by interpolating two of them
+// and whatever it hits is found where it was at time 0, without inverting anything
+void motion_to_start(const mat4d &start, const mat4d &end, mat4d *steps);
+
+// what takes the scene at time (0 to 1) back to time 0, from the steps of motion_to_start()
+mat4d motion_at(const mat4d *steps, double time);
+
+// box around everything in box, which is where it is at time 0, over the whole of a motion
+// the boxes at every step and halfway between, exact when the motion only translates, and off by a sliver of what
+// the interpolation is off by when it turns or scales
+bounds swept_bounds(const bounds &box, const mat4d *steps);
+
+// a hit h found on the ray from start to end moved back to time 0 by to_start, put back on the ray as it is
+std::optional<hit> moved_hit(const mat4d &to_start, const vec4d &ray_start, const vec4d &ray_end, const std::optional<hit> &h);
 
 // extend to define surfaces
 struct surface
 {
 	mat4d transforms = identity(); // transforms on this surface, to be able to create variations of this shape
 
+	// transforms at the end of the shutter, and the steps of the motion from transforms there, see motion_to_start()
+	// a surface that doesn't move has no steps and its rays don't pay for any of it
+	mat4d end_transforms = identity();
+	std::vector<mat4d> motion;
+
 	material material; // parameters for Phong lighting
 
-	// returns a potential intersection given a ray
-	virtual std::optional<hit> intersect(const vec4d &ray_start, const vec4d &ray_end) = 0;
+	// makes the surface move from transforms at time 0 to end at time 1, called again if transforms change
+	void move_to(const mat4d &end);
+
+	// whether anything of the surface moves while the shutter is open
+	virtual bool moving() const;
+
+	// whether any of its hits can mirror, the materials its hits carry can be other than its own
+	virtual bool reflects() const;
+
+	// returns a potential intersection given a ray at time (0 to 1) in the shutter
+	std::optional<hit> intersect(const vec4d &ray_start, const vec4d &ray_end, double time = 0);
+
+	// box around the surface before its transforms
+	virtual bounds model_bounds() const = 0;
+
+	// box around the surface taken as a solid before its transforms, what spans can be found in
+	// the same as model_bounds() for all but solids that don't end, like the half space under a plane
+	virtual bounds solid_bounds() const;
+
+	// spans of the line from start along dir inside the surface taken as a solid, all in model space, t as along dir
+	// false for surfaces that don't enclose anything
+	virtual bool model_spans(const vec3d &start, const vec3d &dir, span_list &out);
+
+	// box around the surface where it ends up, over the whole shutter when it moves
+	bounds world_bounds() const;
+
+	// intersections of count rays at once, hits[i] for ray i at times[i], or all at 0 without times
+	// the transforms are inverted only the once for the whole packet
+	void intersect(const vec4d *ray_starts, const vec4d *ray_ends, size_t count, std::optional<hit> *hits, const double *times = nullptr);
+
+protected:
+	friend struct instance_set; // hands rays it has already moved into an instance straight to its shape
+
+	// returns a potential intersection given a ray and inv, the inverse of transforms
+	// time is only for surfaces with parts that move on their own, the rest ignore it
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time) = 0;
 };
 
 // holds results from intersection checks
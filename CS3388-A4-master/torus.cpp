@@ -0,0 +1,183 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "torus.hpp"
+#include "vector.hpp"
+
+// the largest real root of z^3 + a z^2 + b z + c
+static double largest_cubic_root(double a, double b, double c)
+{
+	double q = (a * a - 3 * b) / 9;
+	double r = (2 * a * a * a - 9 * a * b + 27 * c) / 54;
+
+	// three real roots
+	if (r * r < q * q * q)
+	{
+		double theta = std::acos(std::clamp(r / std::sqrt(q * q * q), -1.0, 1.0));
+		return -2 * std::sqrt(q) * std::cos((theta + 2 * M_PI) / 3) - a / 3;
+	}
+
+	// one
+	double big = -std::copysign(std::cbrt(std::abs(r) + std::sqrt(r * r - q * q * q)), r);
+	return big + (big != 0 ? q / big : 0) - a / 3;
+}
+
+// real roots of x^2 + b x + c into roots, returns how many
+// written so the smaller root doesn't lose its digits when b is large
+static size_t solve_quadratic(double b, double c, double *roots)
+{
+	double discrim = b * b - 4 * c;
+	if (discrim < 0)
+		return 0;
+
+	double k = -0.5 * (b + std::copysign(std::sqrt(discrim), b));
+	if (k == 0)
+	{
+		roots[0] = 0;
+		return 1;
+	}
+
+	roots[0] = k;
+	roots[1] = c / k;
+	return 2;
+}
+
+size_t solve_quartic(double b, double c, double d, double e, double roots[4])
+{
+	// x = y - b / 4 gets rid of the cubic term, y^4 + p y^2 + q y + r
+	double shift = b / 4;
+	double b2 = b * b;
+	double p = c - 3 * b2 / 8;
+	double q = d - b * c / 2 + b2 * b / 8;
+	double r = e - b * d / 4 + b2 * c / 16 - 3 * b2 * b2 / 256;
+
+	size_t count = 0;
+
+	if (std::abs(q) < 1e-12 * (1 + std::abs(p) + std::abs(r)))
+	{
+		// biquadratic, a quadratic in y^2
+		double squares[2];
+		size_t n = solve_quadratic(p, r, squares);
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (squares[i] < 0)
+				continue;
+
+			double y = std::sqrt(squares[i]);
+			roots[count++] = y;
+			roots[count++] = -y;
+		}
+	}
+	else
+	{
+		// (y^2 + s y + u)(y^2 - s y + v) with s^2 the largest root of the resolvent, which is positive while q isn't 0
+		double z = largest_cubic_root(2 * p, p * p - 4 * r, -q * q);
+		if (z <= 0)
+			return 0;
+
+		double s = std::sqrt(z);
+		double u = (p + z - q / s) / 2;
+		double v = (p + z + q / s) / 2;
+
+		count += solve_quadratic(s, u, roots);
+		count += solve_quadratic(-s, v, roots + count);
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		double x = roots[i] - shift;
+
+		// the closed form loses digits near double roots, two Newton steps win them back
+		for (int step = 0; step < 2; ++step)
+		{
+			double f = (((x + b) * x + c) * x + d) * x + e;
+			double df = ((4 * x + 3 * b) * x + 2 * c) * x + d;
+			if (df == 0)
+				break;
+
+			x -= f / df;
+		}
+
+		roots[i] = x;
+	}
+
+	return count;
+}
+
+std::optional<hit> torus::intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double)
+{
+	auto start = cart(inv * ray_start);
+	auto end = cart(inv * ray_end);
+	auto dir = norm(end - start); // warp the ray into model space
+
+	// the ball around the torus, most rays miss it and cost a quadratic
+	double outer = r_torus + r_tube;
+	double g = dot(start, dir);
+	double discrim = g * g - dot(start, start) + outer * outer;
+	if (discrim < 0)
+		return {};
+
+	double t_lo = -g - std::sqrt(discrim), t_hi = -g + std::sqrt(discrim);
+
+	// the slab the tube spans in y
+	if (dir.y() != 0)
+	{
+		double ta = (-r_tube - start.y()) / dir.y(), tb = (r_tube - start.y()) / dir.y();
+		t_lo = std::max(t_lo, std::min(ta, tb));
+		t_hi = std::min(t_hi, std::max(ta, tb));
+	}
+	else if (std::abs(start.y()) > r_tube)
+	{
+		return {};
+	}
+
+	if (t_hi < 0 || t_lo > t_hi)
+		return {};
+
+	// solved from where the ray enters the bounds, near the torus the coefficients keep their digits
+	double t0 = std::max(t_lo, 0.0);
+	auto o = start + dir * t0;
+
+	double big_r2 = r_torus * r_torus;
+	double k = dot(o, o) + big_r2 - r_tube * r_tube;
+	double od = dot(o, dir);
+
+	// (|p|^2 + R^2 - r^2)^2 = 4 R^2 (px^2 + pz^2), with p = o + t dir and |dir| = 1
+	double roots[4];
+	size_t n = solve_quartic(
+		4 * od,
+		4 * od * od + 2 * k - 4 * big_r2 * (dir.x() * dir.x() + dir.z() * dir.z()),
+		4 * od * k - 8 * big_r2 * (o.x() * dir.x() + o.z() * dir.z()),
+		k * k - 4 * big_r2 * (o.x() * o.x() + o.z() * o.z()),
+		roots);
+
+	double t = std::numeric_limits<double>::infinity();
+	for (size_t i = 0; i < n; ++i)
+		if (roots[i] >= 0 && roots[i] < t)
+			t = roots[i];
+
+	if (t > t_hi - t0)
+		return {};
+
+	auto p = o + dir * t;
+
+	// away from the circle at the middle of the tube
+	auto ring = vec3d{{ p.x(), 0, p.z() }};
+	double ring_len = std::sqrt(dot(ring, ring));
+	auto n_model = ring_len > 0 ? p - ring * (r_torus / ring_len) : p;
+
+	return {{
+		norm(cart(dir_to_world(transforms, homo(n_model)))),
+		cart(transforms * homo(p)),
+		this
+	}};
+}
+
+bounds torus::model_bounds() const
+{
+	double outer = r_torus + r_tube;
+	return { vec3d{{ -outer, -r_tube, -outer }}, vec3d{{ outer, r_tube, outer }} };
+}
@@ -0,0 +1,26 @@
+#ifndef A4_TORUS_HPP
+#define A4_TORUS_HPP
+
+#include <cstddef>
+
+#include "surface.hpp"
+
+// ring around the y axis in the xz plane, like make_torus() from A2
+// r_torus is the radius of the ring, r_tube the radius of the tube that runs around it
+// a ray is only solved for when it goes through both the ball around the torus and the slab its tube spans in y
+struct torus : public surface
+{
+	double r_torus = 1;
+	double r_tube = 0.25;
+
+	virtual bounds model_bounds() const;
+
+protected:
+	virtual std::optional<hit> intersect_model(const mat4d &inv, const vec4d &ray_start, const vec4d &ray_end, double time);
+};
+
+// real roots of x^4 + b x^3 + c x^2 + d x + e, unsorted, returns how many there are
+// solved in closed form through a resolvent cubic then polished with Newton steps, so close or double roots stay accurate
+size_t solve_quartic(double b, double c, double d, double e, double roots[4]);
+
+#endif //A4_TORUS_HPP
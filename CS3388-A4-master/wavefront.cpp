@@ -0,0 +1,593 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "wavefront.hpp"
+#include "sphere.hpp"
+#include "plane.hpp"
+#include "cone.hpp"
+#include "torus.hpp"
+#include "mesh.hpp"
+#include "instances.hpp"
+#include "csg.hpp"
+#include "sdf.hpp"
+#include "../common/trace.hpp"
+
+using clock_type = std::chrono::steady_clock;
+
+static double ms_since(clock_type::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+stage_stats &wavefront_stats::stage(const std::string &name)
+{
+	for (auto &s : stages)
+		if (s.name == name)
+			return s;
+
+	auto &added = stages.emplace_back();
+	added.name = name;
+	return added;
+}
+
+std::string wavefront_stats::summary() const
+{
+	char line[160];
+	std::string text;
+
+	auto lanes = [](size_t queued, size_t slots) { return slots ? 100.0 * queued / slots : 0.0; };
+
+	for (auto &s : stages)
+	{
+		size_t queued = 0, slots = 0;
+		for (auto &k : s.kernels)
+		{
+			queued += k.queued;
+			slots += k.slots;
+		}
+
+		// shading runs no kernels, there are no lanes to fill
+		if (s.kernels.empty())
+			std::snprintf(line, sizeof(line), "%-10s %10zu rays %10.2f ms\n", s.name.c_str(), s.rays, s.ms);
+		else
+			std::snprintf(line, sizeof(line), "%-10s %10zu rays %10.2f ms %6.1f%% lanes\n", s.name.c_str(), s.rays, s.ms, lanes(queued, slots));
+		text += line;
+
+		for (auto &k : s.kernels)
+		{
+			std::snprintf(line, sizeof(line), "  %-16s %10zu queued %10.2f ms %6.1f%% lanes\n", k.surface.c_str(), k.queued, k.ms, lanes(k.queued, k.slots));
+			text += line;
+		}
+	}
+
+	return text;
+}
+
+size_t ray_batch::size() const
+{
+	return starts.size();
+}
+
+void ray_batch::clear()
+{
+	starts.clear();
+	ends.clear();
+	owners.clear();
+	inverses.clear();
+	closest.clear();
+}
+
+void ray_batch::push(const vec4d &start, const vec4d &end, uint32_t owner)
+{
+	starts.push_back(start);
+	ends.push_back(end);
+	owners.push_back(owner);
+}
+
+std::string surface_type(const surface &s)
+{
+	if (dynamic_cast<const sphere *>(&s))
+		return "sphere";
+	if (dynamic_cast<const plane *>(&s))
+		return "plane";
+	if (dynamic_cast<const cone *>(&s))
+		return "cone";
+	if (dynamic_cast<const torus *>(&s))
+		return "torus";
+	if (dynamic_cast<const mesh *>(&s))
+		return "mesh";
+	if (dynamic_cast<const instance_set *>(&s))
+		return "instances";
+	if (dynamic_cast<const csg *>(&s))
+		return "csg";
+	if (auto field = dynamic_cast<const sdf_base *>(&s))
+		return "sdf " + std::string(sdf_shapes[field->shape]);
+
+	return "surface";
+}
+
+bounds cull_box(const surface &s)
+{
+	auto box = s.world_bounds();
+
+	for (size_t k = 0; k < 3; ++k)
+	{
+		double pad = 1e-9 * (1 + std::abs(box.lo.at(k, 0)) + std::abs(box.hi.at(k, 0)));
+		box.lo.at(k, 0) -= pad;
+		box.hi.at(k, 0) += pad;
+	}
+
+	return box;
+}
+
+// whether the ray from o the way of 1 / inv goes through box, a NaN from a ray in the plane of a side leaves it in
+static bool crosses(const bounds &box, const double *o, const double *inv)
+{
+	double t0 = 0, t1 = std::numeric_limits<double>::infinity();
+
+	for (size_t k = 0; k < 3; ++k)
+	{
+		double ta = (box.lo.at(k, 0) - o[k]) * inv[k], tb = (box.hi.at(k, 0) - o[k]) * inv[k];
+		if (ta > tb)
+			std::swap(ta, tb);
+
+		t0 = ta > t0 ? ta : t0;
+		t1 = tb < t1 ? tb : t1;
+	}
+
+	return t0 <= t1;
+}
+
+void extend(const std::vector<surface_group> &groups, ray_batch &batch, stage_stats &stats)
+{
+	TRACE_ZONE("extend");
+
+	auto stage_start = clock_type::now();
+	const size_t count = batch.size();
+
+	stats.rays += count;
+	batch.closest.assign(count, std::nullopt);
+
+	// where each ray starts and one over its direction, worked out once for every box, unless they came with the rays
+	const bool given = batch.inverses.size() == 3 * count;
+
+	std::vector<double> origins(3 * count), inverses(given ? 0 : 3 * count);
+	for (size_t r = 0; r < count; ++r)
+	{
+		auto s = cart(batch.starts[r]);
+		for (size_t k = 0; k < 3; ++k)
+			origins[3 * r + k] = s.at(k, 0);
+
+		if (given)
+			continue;
+
+		auto d = cart(batch.ends[r]) - s;
+		for (size_t k = 0; k < 3; ++k)
+			inverses[3 * r + k] = 1 / d.at(k, 0);
+	}
+
+	const double *reciprocals = given ? batch.inverses.data() : inverses.data();
+
+	std::vector<double> closest_d2(count, std::numeric_limits<double>::infinity());
+
+	std::vector<uint32_t> queue;
+	std::vector<size_t> runs; // rays queued for each surface of the group, one after another in queue
+	std::vector<vec4d> starts, ends;
+	std::vector<std::optional<hit>> hits;
+
+	for (auto &group : groups)
+	{
+		auto found = std::find_if(stats.kernels.begin(), stats.kernels.end(), [&](auto &k) { return k.surface == group.name; });
+		if (found == stats.kernels.end())
+		{
+			stats.kernels.emplace_back().surface = group.name;
+			found = stats.kernels.end() - 1;
+		}
+
+		auto &kernel = *found;
+
+		queue.clear();
+		runs.clear();
+
+		for (size_t j = 0; j < group.objs.size(); ++j)
+		{
+			size_t before = queue.size();
+
+			for (size_t r = 0; r < count; ++r)
+				if (crosses(group.boxes[j], &origins[3 * r], &reciprocals[3 * r]))
+					queue.push_back(static_cast<uint32_t>(r));
+
+			size_t run = queue.size() - before;
+			runs.push_back(run);
+
+			kernel.queued += run;
+			kernel.slots += (run + kernel_lanes - 1) / kernel_lanes * kernel_lanes;
+		}
+
+		TRACE_ZONE("kernel");
+		auto kernel_start = clock_type::now();
+
+		size_t offset = 0;
+		for (size_t j = 0; j < group.objs.size(); ++j)
+		{
+			size_t n = runs[j];
+			if (n == 0)
+				continue;
+
+			starts.resize(n);
+			ends.resize(n);
+			hits.resize(n);
+
+			for (size_t q = 0; q < n; ++q)
+			{
+				starts[q] = batch.starts[queue[offset + q]];
+				ends[q] = batch.ends[queue[offset + q]];
+			}
+
+			group.objs[j]->intersect(starts.data(), ends.data(), n, hits.data());
+
+			for (size_t q = 0; q < n; ++q)
+			{
+				if (!hits[q])
+					continue;
+
+				uint32_t r = queue[offset + q];
+				auto d = hits[q]->world_pt - cart(batch.starts[r]);
+				double d2 = dot(d, d);
+
+				if (d2 < closest_d2[r])
+				{
+					batch.closest[r] = hits[q];
+					closest_d2[r] = d2;
+				}
+			}
+
+			offset += n;
+		}
+
+		kernel.ms += ms_since(kernel_start);
+	}
+
+	stats.ms += ms_since(stage_start);
+}
+
+// a ray of a pixel's path, what it adds to the pixel
+struct path_ray
+{
+	uint32_t pixel;
+	uint32_t key; // of the pixel, see pixel_seed()
+	double weight;
+	vec3d origin;
+};
+
+// a hit being shaded, the Phong sums of the lights it has seen so far
+struct shading
+{
+	hit at;
+	uint32_t path;
+	vec3d lit;
+	double spec;
+	bool reached;
+	double faint; // most the lights it didn't test could add to a channel
+};
+
+// light i of a hit, waiting on its shadow rays
+struct shadow_test
+{
+	uint32_t shaded;
+	uint32_t light;
+	double diffuse, specular;
+	uint32_t samples; // that visibility() would take
+	uint32_t traced = 0, visible = 0;
+	uint32_t scramble_s = 0, scramble_t = 0;
+};
+
+// adds the shadow rays of test from sample first up to last, from the light to the hit like reaches()
+static void push_shadow_rays(ray_batch &rays, const light_list &lights, const shadow_test &test, const vec3d &pt, uint32_t id,
+	uint32_t first, uint32_t last)
+{
+	for (uint32_t k = first; k < last; ++k)
+	{
+		vec3d from = lights.position(test.light);
+		if (lights.shapes[test.light].kind != light_kind::point)
+		{
+			auto [s, t] = sobol_2d(k, test.scramble_s, test.scramble_t);
+			from = lights.sample_point(test.light, pt, s, t);
+		}
+
+		rays.push(homo(from), homo(pt), id);
+	}
+}
+
+// counts the shadow rays that got to their hit
+static void count_visible(const ray_batch &rays, std::vector<shadow_test> &tests, const std::vector<shading> &shaded)
+{
+	for (size_t r = 0; r < rays.size(); ++r)
+	{
+		auto &test = tests[rays.owners[r]];
+		test.traced += 1;
+
+		if (!rays.closest[r])
+		{
+			test.visible += 1;
+			continue;
+		}
+
+		auto d = shaded[test.shaded].at.world_pt - rays.closest[r]->world_pt;
+		if (dot(d, d) <= std::numeric_limits<double>::epsilon())
+			test.visible += 1;
+	}
+}
+
+draw_counts trace_wavefront(const std::vector<surface_group> &groups, const light_list &lights, const vec3d &eye, const mat4d &inv,
+	sf::Image &image, const render_options &options, ray_stats *stats, wavefront_stats *wstats)
+{
+	TRACE_ZONE("wavefront");
+
+	const size_t width = image.getSize().x, height = image.getSize().y;
+	const size_t max_depth = std::min(options.max_depth, ray_stats::max_depths - 1);
+
+	draw_counts counts;
+	wavefront_stats local;
+	auto &waves = wstats ? *wstats : local;
+
+	ray_generator generator(eye, inv, width, height);
+	camera_rays tile_rays;
+
+	std::vector<uint32_t> pixels; // of the batch
+	std::vector<path_ray> paths, next_paths;
+	std::vector<vec3d> colors;
+	std::vector<uint8_t> covered;
+	std::vector<shading> shaded;
+	std::vector<shadow_test> tests, faint_tests;
+	ray_batch rays, next_rays, shadows;
+
+	std::vector<double> diffuse(lights.size()), specular(lights.size()), bound(lights.size());
+	std::vector<uint32_t> lit_order;
+
+	for (size_t tile = 0; tile < generator.tiles(); )
+	{
+		pixels.clear();
+		paths.clear();
+		rays.clear();
+
+		// whole tiles, each along its Morton curve, for as many as fit
+		do
+		{
+			generator.generate(tile++, tile_rays, true); // the reciprocals save extend() working them out
+
+			for (size_t k = 0; k < tile_rays.size(); ++k)
+			{
+				uint32_t p = static_cast<uint32_t>(pixels.size());
+				uint32_t i = tile_rays.pixels[k];
+
+				pixels.push_back(i);
+				paths.push_back({ p, pixel_seed(static_cast<uint32_t>(i % width), static_cast<uint32_t>(i / width), 0), 1, eye });
+				rays.push(homo(eye), tile_rays.ends[k], p);
+				rays.inverses.insert(rays.inverses.end(), { tile_rays.rx[k], tile_rays.ry[k], tile_rays.rz[k] });
+			}
+		}
+		while (tile < generator.tiles() && pixels.size() + tile_size * tile_size <= wavefront_batch);
+
+		const size_t batch = pixels.size();
+
+		colors.assign(batch, vec3d{{ 0, 0, 0 }});
+		covered.assign(batch, 0);
+
+		for (size_t depth = 0; rays.size() > 0; ++depth)
+		{
+			auto &traced = waves.stage(depth == 0 ? "primary" : "bounce " + std::to_string(depth));
+			double before = traced.ms;
+
+			extend(groups, rays, traced);
+
+			if (stats)
+			{
+				stats->rays[depth] += rays.size();
+				stats->ms[depth] += traced.ms - before;
+			}
+
+			// the hits, what's left of the rays that didn't leave the scene
+			shaded.clear();
+			for (size_t r = 0; r < rays.size(); ++r)
+				if (rays.closest[r])
+					shaded.push_back({ *rays.closest[r], rays.owners[r], vec3d{{ 0, 0, 0 }}, 0, false, 0 });
+
+			if (depth == 0)
+				for (auto &s : shaded)
+					covered[paths[s.path].pixel] = 1;
+
+			// the unshadowed terms of every light of every hit, with the faint tail of lights cut like shade_all() does
+			// and one shadow test for each light that's left
+			auto &shade = waves.stage("shade");
+			auto shade_start = clock_type::now();
+			shade.rays += shaded.size();
+
+			tests.clear();
+			faint_tests.clear();
+			shadows.clear();
+
+			for (size_t h = 0; h < shaded.size(); ++h)
+			{
+				auto &s = shaded[h];
+				auto &path = paths[s.path];
+				const auto &mat = s.at.obj->material;
+
+				vec3d v = norm(path.origin - s.at.world_pt);
+				double brightest = std::max({ mat.color.x(), mat.color.y(), mat.color.z() });
+
+				lit_order.clear();
+				double remaining = 0;
+				for (size_t i = 0; i < lights.size(); ++i)
+				{
+					std::tie(diffuse[i], specular[i]) = light_terms(lights, i, s.at, v);
+					bound[i] = diffuse[i] * brightest + specular[i];
+
+					if (bound[i] > 0)
+					{
+						lit_order.push_back(static_cast<uint32_t>(i));
+						remaining += bound[i];
+					}
+				}
+
+				std::sort(lit_order.begin(), lit_order.end(), [&](uint32_t a, uint32_t b) { return bound[a] > bound[b]; });
+
+				// the same random numbers shade() would have had for the soft shadows
+				uint32_t key = random_bits(path.key, static_cast<uint32_t>(depth)) ^ 0x5bd1e995;
+
+				// the faint tail is kept aside, it only gets shadow rays if it turns out it could round the hit up
+				for (size_t k = 0; k < lit_order.size(); ++k)
+				{
+					uint32_t i = lit_order[k];
+					bool faint = remaining < options.light_cutoff;
+					remaining -= bound[i];
+
+					uint32_t samples = lights.shapes[i].kind == light_kind::point ? 1 : static_cast<uint32_t>(std::max<size_t>(options.shadow_samples, 1));
+					shadow_test test{ static_cast<uint32_t>(h), i, diffuse[i], specular[i], samples, 0, 0, random_bits(key, 2 * i), random_bits(key, 2 * i + 1) };
+
+					if (faint)
+					{
+						s.faint += bound[i];
+						faint_tests.push_back(test);
+						continue;
+					}
+
+					uint32_t id = static_cast<uint32_t>(tests.size());
+					tests.push_back(test);
+
+					push_shadow_rays(shadows, lights, test, s.at.world_pt, id, 0, std::min<uint32_t>(test.samples, shadow_packet));
+				}
+
+				if (stats)
+					stats->lights_culled += lights.size() - lit_order.size();
+			}
+
+			shade.ms += ms_since(shade_start);
+
+			// the first packet of every test in shadows, then the rest of the ones that need it, then what each hit sees
+			auto trace_shadows = [&](const std::string &stage)
+			{
+				if (stats)
+					stats->shadow_rays += shadows.size();
+
+				extend(groups, shadows, waves.stage(stage));
+				count_visible(shadows, tests, shaded);
+
+				// area lights whose first packet neither all saw nor all missed get the rest of their samples
+				shadows.clear();
+				for (size_t t = 0; t < tests.size(); ++t)
+				{
+					auto &test = tests[t];
+					if (test.visible == 0 || test.visible == test.traced || test.traced == test.samples)
+						continue;
+
+					push_shadow_rays(shadows, lights, test, shaded[test.shaded].at.world_pt, static_cast<uint32_t>(t), test.traced, test.samples);
+				}
+
+				if (shadows.size() > 0)
+				{
+					if (stats)
+						stats->shadow_rays += shadows.size();
+
+					extend(groups, shadows, waves.stage("penumbra"));
+					count_visible(shadows, tests, shaded);
+				}
+
+				auto sum_start = clock_type::now();
+
+				for (auto &test : tests)
+				{
+					double seen = test.traced == test.samples ? 1.0 * test.visible / test.samples : test.visible ? 1 : 0;
+					if (seen <= 0)
+						continue;
+
+					auto &s = shaded[test.shaded];
+					s.lit = s.lit + s.at.obj->material.color * (test.diffuse * seen);
+					s.spec += test.specular * seen;
+					s.reached = true;
+				}
+
+				shade.ms += ms_since(sum_start);
+			};
+
+			trace_shadows("shadow");
+
+			// the faint lights of hits they could still round a channel of, or that no light has reached yet, all of them
+			// where shade_all() would stop partway, what it leaves couldn't have changed the hit either
+			tests.clear();
+			shadows.clear();
+
+			for (auto &test : faint_tests)
+			{
+				auto &s = shaded[test.shaded];
+				// a hit no light reached yet keeps its faint lights, one of them reaching it changes its ambient
+				if (s.reached && !rounds_up(s.at.obj->material, s.lit, s.spec, s.faint))
+				{
+					if (stats)
+						stats->lights_culled += 1;
+					continue;
+				}
+
+				uint32_t id = static_cast<uint32_t>(tests.size());
+				tests.push_back(test);
+
+				push_shadow_rays(shadows, lights, test, s.at.world_pt, id, 0, std::min<uint32_t>(test.samples, shadow_packet));
+			}
+
+			if (shadows.size() > 0)
+				trace_shadows("faint");
+
+			// the color of each hit, and the reflection rays for the next bounce
+			shade_start = clock_type::now();
+
+			next_paths.clear();
+			next_rays.clear();
+
+			for (auto &s : shaded)
+			{
+				auto &path = paths[s.path];
+				const auto &mat = s.at.obj->material;
+
+				colors[path.pixel] = colors[path.pixel] + combine(mat, s.lit, s.spec, s.reached) * path.weight;
+
+				double weight = path.weight * mat.k_reflect;
+				if (weight < options.cutoff || depth == max_depth)
+					continue;
+
+				vec3d d = norm(s.at.world_pt - path.origin);
+				vec3d n = dot(d, s.at.normal) > 0 ? -s.at.normal : s.at.normal;
+				vec3d r = d - n * 2 * dot(d, n);
+				vec3d origin = s.at.world_pt + n * reflect_offset;
+
+				next_rays.push(homo(origin), homo(origin + r), static_cast<uint32_t>(next_paths.size()));
+				next_paths.push_back({ path.pixel, path.key, weight, origin });
+			}
+
+			shade.ms += ms_since(shade_start);
+
+			std::swap(paths, next_paths);
+			std::swap(rays, next_rays);
+		}
+
+		for (size_t p = 0; p < batch; ++p)
+		{
+			uint32_t i = pixels[p];
+
+			if (stats)
+			{
+				stats->pixels += 1;
+				stats->samples += 1;
+			}
+
+			if (!covered[p])
+				continue;
+
+			image.setPixel(i % width, i / width, pixel_color(colors[p]));
+			counts.pixels += 1;
+		}
+	}
+
+	return counts;
+}
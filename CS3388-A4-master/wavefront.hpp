@@ -0,0 +1,134 @@
+#ifndef A4_WAVEFRONT_HPP
+#define A4_WAVEFRONT_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "light.hpp"
+#include "../common/profiler.hpp"
+#include "render.hpp"
+#include "surface.hpp"
+#include "vector.hpp"
+
+// wavefront rendering, the image of render() without anti-aliasing, traced a stage at a time over a batch of pixels
+// instead of a pixel at a time, so each stage runs the one piece of code over every ray of the batch
+//   primary    a ray through every pixel of the batch
+//   shade      lights every hit, making a shadow ray for each light that could show and a reflection ray where it mirrors
+//   shadow     the shadow rays, only the first packet of samples of an area light
+//   penumbra   the rest of the samples of the area lights whose first packet didn't agree, like visibility() does
+//   faint      the lights too faint to test, where they could still round a channel up or no other light reached the hit
+//   bounce n   the reflection rays n deep, which are shaded and shadowed again in turn
+// tracing rays puts each one in the queue of every type of surface whose box it goes through, and each type's kernel then
+// intersects its whole queue, a surface at a time, so the same code and the same surface stay in cache from ray to ray
+
+// pixels traced together, more fill the queues better, each takes a few hundred bytes through the stages
+constexpr size_t wavefront_batch = 1 << 16;
+
+// the surfaces of one type in a scene, in scene order, with the boxes rays are sorted into the queue by
+struct surface_group
+{
+	std::string name;
+	std::vector<surface *> objs;
+	std::vector<bounds> boxes;
+};
+
+// lanes the occupancy of the stats is measured against, a packet of 4 doubles as AVX2 would take
+// the kernels themselves are scalar, the figure is how full packets this wide would be with the queues they're given
+constexpr size_t kernel_lanes = 4;
+
+// what the kernel of one type of surface did over a stage
+struct kernel_stats
+{
+	std::string surface;
+	size_t queued = 0; // ray and surface pairs, over every batch
+	size_t slots = 0; // lanes of the kernel_lanes wide packets each surface's queue would fill, the last one short
+	double ms = 0;
+};
+
+struct stage_stats
+{
+	std::string name;
+	size_t rays = 0; // over every batch
+	double ms = 0; // queues built and kernels run, or the shading
+	std::vector<kernel_stats> kernels;
+};
+
+struct wavefront_stats
+{
+	std::vector<stage_stats> stages; // in the order they first ran
+
+	// the stage by that name, added at the end if there's none yet
+	stage_stats &stage(const std::string &name);
+
+	// a line per stage, then one per kernel with its queue and its time
+	// both give the share of kernel_lanes wide packet lanes their queues fill, short queues leave lanes empty
+	std::string summary() const;
+};
+
+// rays of a stage, one array per field
+struct ray_batch
+{
+	std::vector<vec4d> starts, ends;
+	std::vector<uint32_t> owners; // what each ray is for, a path or a shadow test
+	std::vector<double> inverses; // one over each ray's direction, 3 a ray, optional, extend() works them out when it's empty
+	std::vector<std::optional<hit>> closest; // filled by extend()
+
+	size_t size() const;
+	void clear();
+	void push(const vec4d &start, const vec4d &end, uint32_t owner);
+};
+
+// name of the type of s, for the stats
+std::string surface_type(const surface &s);
+
+// box around s that rays are culled by, its world bounds grown a little so a ray grazing it is never dropped
+bounds cull_box(const surface &s);
+
+// the surfaces of scene by type, one kernel each, types in the order they first show up
+template<typename C>
+std::vector<surface_group> group_surfaces(const C &scene)
+{
+	std::vector<surface_group> groups;
+	std::vector<std::type_index> types;
+
+	for (auto &obj : scene)
+	{
+		std::type_index type = typeid(*obj);
+
+		size_t g = std::find(types.begin(), types.end(), type) - types.begin();
+		if (g == types.size())
+		{
+			types.push_back(type);
+			groups.emplace_back().name = surface_type(*obj);
+		}
+
+		groups[g].objs.push_back(obj);
+		groups[g].boxes.push_back(cull_box(*obj));
+	}
+
+	return groups;
+}
+
+// closest hit of every ray of batch into batch.closest, queue by queue, added to stats
+void extend(const std::vector<surface_group> &groups, ray_batch &batch, stage_stats &stats);
+
+// ray traces the surfaces in groups into image in stages, see above, stats and wstats can be nullptr
+// hits are lit by every light, options.light_samples and options.aa_samples are left to render()
+draw_counts trace_wavefront(const std::vector<surface_group> &groups, const light_list &lights, const vec3d &eye, const mat4d &inv,
+	sf::Image &image, const render_options &options, ray_stats *stats, wavefront_stats *wstats);
+
+template<typename C>
+draw_counts render_wavefront(const C &scene, const light_list &lights, const vec3d &eye, const mat4d &inv, sf::Image &image,
+	const render_options &options = {}, ray_stats *stats = nullptr, wavefront_stats *wstats = nullptr)
+{
+	return trace_wavefront(group_surfaces(scene), lights, eye, inv, image, options, stats, wstats);
+}
+
+#endif //A4_WAVEFRONT_HPP
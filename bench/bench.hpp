@@ -0,0 +1,431 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// a small benchmark harness in the style of Google Benchmark, so the bench programs need nothing but SFML
+// a benchmark is a function taking a bench_state, the code to time goes in a for (auto _ : state) loop
+//
+//   void mat4_mul(bench_state &state)
+//   {
+//       auto a = ..., b = ...;
+//       for (auto _ : state)
+//           do_not_optimize(a * b);
+//   }
+//   BENCHMARK(mat4_mul);
+//   BENCHMARK_MAIN();
+//
+// each benchmark is first run with more and more iterations until a run takes at least min_time,
+// then that many iterations are repeated and the median time per iteration is reported
+
+// keeps the compiler from throwing away a value that's otherwise unused
+template<typename T>
+void do_not_optimize(const T &value)
+{
+#if defined(_MSC_VER)
+	static volatile const void *sink;
+	sink = &value;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "g"(&value) : "memory");
+#endif
+}
+
+// keeps the compiler from assuming memory is unchanged across this point
+inline void clobber_memory()
+{
+#if defined(_MSC_VER)
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : : "memory");
+#endif
+}
+
+// drives the timed loop of one run of a benchmark
+class bench_state
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	// what the range-for hands out, never used, so gcc/clang are told not to warn about it
+#if defined(_MSC_VER)
+	struct value {};
+#else
+	struct __attribute__((unused)) value {};
+#endif
+
+	class iterator
+	{
+		bench_state *state;
+		size_t left;
+
+	public:
+		iterator(bench_state *state, size_t left);
+
+		value operator*() const { return {}; }
+		iterator &operator++() { --left; return *this; }
+
+		// the timer stops as soon as the loop runs out
+		bool operator!=(const iterator &) const;
+	};
+
+	bench_state(size_t iterations);
+
+	size_t iterations() const;
+
+	// excludes setup inside the loop from the timing
+	void pause_timing();
+	void resume_timing();
+
+	// work done per iteration, for the items/s column, e.g. rays or pixels
+	void set_items_per_iteration(double items);
+	double items_per_iteration() const;
+
+	// time of the loop in ns, excluding paused time
+	double elapsed_ns() const;
+
+	iterator begin();
+	iterator end();
+
+private:
+	size_t count;
+	double items = 0;
+	double elapsed = 0;
+	clock::time_point start;
+	bool running = false;
+};
+
+bench_state::iterator::iterator(bench_state *state, size_t left) :
+	state(state),
+	left(left)
+{}
+
+bool bench_state::iterator::operator!=(const iterator &) const
+{
+	if (left > 0)
+		return true;
+
+	state->pause_timing();
+	return false;
+}
+
+bench_state::bench_state(size_t iterations) :
+	count(iterations)
+{}
+
+size_t bench_state::iterations() const
+{
+	return count;
+}
+
+void bench_state::pause_timing()
+{
+	if (!running)
+		return;
+
+	elapsed += std::chrono::duration<double, std::nano>(clock::now() - start).count();
+	running = false;
+}
+
+void bench_state::resume_timing()
+{
+	if (running)
+		return;
+
+	running = true;
+	start = clock::now();
+}
+
+void bench_state::set_items_per_iteration(double items)
+{
+	this->items = items;
+}
+
+double bench_state::items_per_iteration() const
+{
+	return items;
+}
+
+double bench_state::elapsed_ns() const
+{
+	return elapsed;
+}
+
+bench_state::iterator bench_state::begin()
+{
+	resume_timing();
+	return iterator(this, count);
+}
+
+bench_state::iterator bench_state::end()
+{
+	return iterator(this, 0);
+}
+
+using bench_fn = void (*)(bench_state &);
+
+// every benchmark in the program, in order of registration
+std::vector<std::pair<std::string, bench_fn>> &bench_registry()
+{
+	static std::vector<std::pair<std::string, bench_fn>> registry;
+	return registry;
+}
+
+struct bench_registrar
+{
+	bench_registrar(const char *name, bench_fn fn)
+	{
+		bench_registry().emplace_back(name, fn);
+	}
+};
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCHMARK(fn) static bench_registrar BENCH_CONCAT(bench_registrar_, __LINE__)(#fn, fn)
+#define BENCHMARK_MAIN() int main(int argc, char **argv) { return run_benchmarks(argc, argv); }
+
+// timings of one benchmark over every repetition, in ns per iteration
+struct bench_result
+{
+	std::string name;
+	size_t iterations = 0;
+	std::vector<double> times;
+	double items = 0;
+
+	double median() const;
+	double mean() const;
+	double stddev() const;
+	double min() const;
+};
+
+double bench_result::median() const
+{
+	auto sorted = times;
+	std::sort(sorted.begin(), sorted.end());
+
+	size_t n = sorted.size();
+	return n % 2 == 1 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+}
+
+double bench_result::mean() const
+{
+	double sum = 0;
+	for (auto t : times)
+		sum += t;
+
+	return sum / times.size();
+}
+
+double bench_result::stddev() const
+{
+	if (times.size() < 2)
+		return 0;
+
+	double m = mean(), sum = 0;
+	for (auto t : times)
+		sum += (t - m) * (t - m);
+
+	return std::sqrt(sum / (times.size() - 1));
+}
+
+double bench_result::min() const
+{
+	return *std::min_element(times.begin(), times.end());
+}
+
+struct bench_options
+{
+	std::string filter; // only run benchmarks whose name contains this
+	std::string out; // json results go here when set
+	double min_time = 0.5; // s, a calibrated run takes at least this long
+	size_t repetitions = 5;
+	bool list = false;
+};
+
+// runs fn with more and more iterations until one run takes min_time, then repeats it
+bench_result run_benchmark(const std::string &name, bench_fn fn, const bench_options &options)
+{
+	const double min_ns = options.min_time * 1e9;
+
+	size_t iterations = 1;
+	for (;;)
+	{
+		bench_state state(iterations);
+		fn(state);
+
+		double ns = state.elapsed_ns();
+		if (ns >= min_ns || iterations >= 1000000000)
+			break;
+
+		// aim a little past min_time, but don't grow more than 10x on a noisy short run
+		double guess = ns > 0 ? 1.4 * min_ns / ns * iterations : 10.0 * iterations;
+		iterations = static_cast<size_t>(std::clamp(guess, iterations + 1.0, 10.0 * iterations));
+	}
+
+	bench_result result;
+	result.name = name;
+	result.iterations = iterations;
+
+	for (size_t r = 0; r < std::max<size_t>(options.repetitions, 1); ++r)
+	{
+		bench_state state(iterations);
+		fn(state);
+
+		result.times.push_back(state.elapsed_ns() / iterations);
+		result.items = state.items_per_iteration();
+	}
+
+	return result;
+}
+
+// results in the shape Google Benchmark writes them, so its tools read them too
+bool write_results(const std::string &path, const std::string &executable, const bench_options &options, const std::vector<bench_result> &results)
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+
+	// windows paths are full of backslashes
+	std::string exe;
+	for (char c : executable)
+	{
+		if (c == '\\' || c == '"')
+			exe += '\\';
+		exe += c;
+	}
+
+	char date[64];
+	std::time_t now = std::time(nullptr);
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+#if defined(NDEBUG)
+	const char *build = "release";
+#else
+	const char *build = "debug";
+#endif
+
+	out << "{\n  \"context\": {\n"
+		<< "    \"date\": \"" << date << "\",\n"
+		<< "    \"executable\": \"" << exe << "\",\n"
+		<< "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+		<< "    \"library_build_type\": \"" << build << "\",\n"
+		<< "    \"min_time\": " << options.min_time << ",\n"
+		<< "    \"repetitions\": " << options.repetitions << "\n"
+		<< "  },\n  \"benchmarks\": [";
+
+	char number[64];
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const auto &r = results[i];
+
+		out << (i == 0 ? "\n" : ",\n")
+			<< "    {\n      \"name\": \"" << r.name << "\",\n"
+			<< "      \"iterations\": " << r.iterations << ",\n"
+			<< "      \"repetitions\": " << r.times.size() << ",\n";
+
+		std::snprintf(number, sizeof(number), "%.3f", r.median());
+		out << "      \"real_time\": " << number << ",\n";
+		std::snprintf(number, sizeof(number), "%.3f", r.mean());
+		out << "      \"mean_time\": " << number << ",\n";
+		std::snprintf(number, sizeof(number), "%.3f", r.stddev());
+		out << "      \"stddev_time\": " << number << ",\n";
+		std::snprintf(number, sizeof(number), "%.3f", r.min());
+		out << "      \"min_time\": " << number << ",\n";
+
+		if (r.items > 0)
+		{
+			std::snprintf(number, sizeof(number), "%.1f", r.items * 1e9 / r.median());
+			out << "      \"items_per_second\": " << number << ",\n";
+		}
+
+		out << "      \"time_unit\": \"ns\"\n    }";
+	}
+
+	out << "\n  ]\n}\n";
+
+	return out.good();
+}
+
+// usage: <bench> [--filter <substring>] [--out <results.json>] [--min-time <s>] [--repetitions <n>] [--list]
+int run_benchmarks(int argc, char **argv)
+{
+	bench_options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--list")
+		{
+			options.list = true;
+			continue;
+		}
+
+		// every other option takes a value, one left at the end without it is a mistake, not a request for the default
+		bool takes_value = arg == "--filter" || arg == "--out" || arg == "--min-time" || arg == "--repetitions";
+		if (takes_value && i + 1 >= argc)
+		{
+			std::fprintf(stderr, "expected a value after %s\n", arg.c_str());
+			return 1;
+		}
+
+		if (arg == "--filter")
+			options.filter = argv[++i];
+		else if (arg == "--out")
+			options.out = argv[++i];
+		else if (arg == "--min-time")
+			options.min_time = std::stod(argv[++i]);
+		else if (arg == "--repetitions")
+			options.repetitions = std::stoul(argv[++i]);
+	}
+
+	if (options.list)
+	{
+		for (auto &entry : bench_registry())
+			std::printf("%s\n", entry.first.c_str());
+
+		return 0;
+	}
+
+	std::printf("%-28s %12s %14s %14s %8s %14s\n", "benchmark", "iterations", "median ns", "mean ns", "cv %", "items/s");
+
+	std::vector<bench_result> results;
+	for (auto &entry : bench_registry())
+	{
+		if (entry.first.find(options.filter) == std::string::npos)
+			continue;
+
+		auto r = run_benchmark(entry.first, entry.second, options);
+
+		std::printf("%-28s %12zu %14.1f %14.1f %8.2f", r.name.c_str(), r.iterations, r.median(), r.mean(), 100 * r.stddev() / r.mean());
+		if (r.items > 0)
+			std::printf(" %14.4g", r.items * 1e9 / r.median());
+		std::printf("\n");
+		std::fflush(stdout);
+
+		results.push_back(std::move(r));
+	}
+
+	if (!options.out.empty() && !write_results(options.out, argv[0], options, results))
+	{
+		std::fprintf(stderr, "can't write %s\n", options.out.c_str());
+		return 1;
+	}
+
+	return 0;
+}
+
+#endif
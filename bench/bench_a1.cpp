@@ -0,0 +1,55 @@
+// A1 benchmarks: the two line algorithms on the same random segments
+
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "bench.hpp"
+
+#include "bresenham.hpp"
+
+// segments are cycled through so the compiler can't fold the work away
+constexpr size_t segment_count = 1024;
+
+// random segments inside the A1 window, every octant and length shows up
+static std::vector<std::pair<point<int>, point<int>>> random_segments()
+{
+	std::mt19937 gen(3388); // fixed seed, every run times the same lines
+	std::uniform_int_distribution<int> coord(0, 511);
+
+	std::vector<std::pair<point<int>, point<int>>> segments;
+	for (size_t i = 0; i < segment_count; ++i)
+		segments.push_back({ { coord(gen), coord(gen) }, { coord(gen), coord(gen) } });
+
+	return segments;
+}
+
+static void a1_bresenham(bench_state &state)
+{
+	auto segments = random_segments();
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		auto &s = segments[i];
+		do_not_optimize(Bresenham(s.first.first, s.first.second, s.second.first, s.second.second));
+		i = (i + 1) % segment_count;
+	}
+}
+BENCHMARK(a1_bresenham);
+
+static void a1_line(bench_state &state)
+{
+	auto segments = random_segments();
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		auto &s = segments[i];
+		do_not_optimize(line(s.first.first, s.first.second, s.second.first, s.second.second));
+		i = (i + 1) % segment_count;
+	}
+}
+BENCHMARK(a1_line);
+
+BENCHMARK_MAIN();
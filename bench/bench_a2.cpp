@@ -0,0 +1,103 @@
+// A2 benchmarks: drawing lines into an image, transforming the wireframes, and a whole frame
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "bench.hpp"
+
+#include "bresenham.hpp"
+#include "draw.hpp"
+#include "geom.hpp"
+#include "matrix.hpp"
+
+const size_t window_width = 1000, window_height = 600;
+
+// same objects and view as the A2 scene
+static std::vector<std::vector<vec4d>> make_scene()
+{
+	return {
+		translate(0.0, 0.0, 200.0) * make_torus(160, 60, 48, 32),
+		translate(200.0, 0.0, -200.0) * make_torus(0, 200, 48, 48),
+		translate(-200.0, 0.0, -200.0) * make_cone(200, 400, 32)
+	};
+}
+
+static mat4d make_view()
+{
+	return rotx(M_PI / 4) * translate(0.0, 0.0, 0.0) * scale(0.75);
+}
+
+static mat4d make_screen()
+{
+	return translate(window_width / 2.0, window_height / 2.0, 0.0);
+}
+
+// lines are cycled through so the compiler can't fold the work away
+static void a2_bresenham_image(bench_state &state)
+{
+	const size_t segment_count = 1024;
+
+	std::mt19937 gen(3388); // fixed seed, every run draws the same lines
+	std::uniform_int_distribution<int> x(0, window_width - 1), y(0, window_height - 1);
+
+	std::vector<std::pair<point<int>, point<int>>> segments;
+	for (size_t i = 0; i < segment_count; ++i)
+		segments.push_back({ { x(gen), y(gen) }, { x(gen), y(gen) } });
+
+	sf::Image image;
+	image.create(window_width, window_height, sf::Color(0, 0, 0, 0));
+
+	size_t i = 0, pixels = 0;
+	for (auto _ : state)
+	{
+		auto &s = segments[i];
+		pixels += Bresenham(image, s.first.first, s.first.second, s.second.first, s.second.second);
+		i = (i + 1) % segment_count;
+	}
+
+	do_not_optimize(pixels);
+	state.set_items_per_iteration(1.0 * pixels / state.iterations()); // pixels/s
+}
+BENCHMARK(a2_bresenham_image);
+
+static void a2_transform(bench_state &state)
+{
+	auto scene = make_scene();
+	auto view = make_view(), screen = make_screen();
+
+	size_t verts = 0;
+	for (auto &obj : scene)
+		verts += obj.size();
+
+	for (auto _ : state)
+	{
+		for (auto &obj : scene)
+			do_not_optimize(normalize_w(screen * view * roty(0.5) * obj));
+	}
+
+	state.set_items_per_iteration(verts); // vertices/s
+}
+BENCHMARK(a2_transform);
+
+// the whole A2 scene at its window size, one angle of the spin
+static void a2_frame(bench_state &state)
+{
+	auto scene = make_scene();
+	auto view = make_view(), screen = make_screen();
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(window_width, window_height, sf::Color(0, 0, 0, 0));
+		draw_frame(scene, view, screen, 0.5, image);
+		clobber_memory();
+	}
+}
+BENCHMARK(a2_frame);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,112 @@
+// A3 benchmarks: a whole shaded frame, and its shading and scanline fill on their own
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "bench.hpp"
+
+#include "geom.hpp"
+#include "light.hpp"
+#include "matrix.hpp"
+#include "mesh.hpp"
+#include "raster.hpp"
+
+const size_t window_width = 1000, window_height = 600;
+
+// same camera, light, and objects as the A3 scene
+static const vec4d eye{{ 0, 300, 300, 1.0 }};
+static const light bulb{ {{ 0, 400, 400, 1.0 }}, 1 };
+
+static std::vector<mesh> make_meshes()
+{
+	mesh sphere = make_sphere_mesh(200, 1000, 1000);
+	sphere.color = vec4d{{ 255, 127, 0.0, 255.0 }};
+
+	mesh cone = make_cone_mesh(150, 250, 800, 1);
+	cone.color = vec4d{{ 0.0, 127, 0.0, 255 }};
+
+	return { cone, sphere };
+}
+
+// model space to screen space, then perspective division, like A3 does before shading
+static void project(std::vector<mesh> &meshes)
+{
+	auto view = rotx(M_PI / 4) * translate(-eye.at(0, 0), -eye.at(1, 0), -eye.at(2, 0)) * scale(0.75);
+	auto screen = translate(window_width / 2.0, window_height / 2.0, 0.0);
+
+	const double offsets[] = { 100.0, -300.0 }; // cone, sphere
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		for (auto &tri : meshes[i].faces)
+			tri.points = normalize_w(screen * view * translate(offsets[i], 0.0, 0.0) * tri.points);
+	}
+}
+
+static size_t face_count(const std::vector<mesh> &meshes)
+{
+	size_t faces = 0;
+	for (auto &m : meshes)
+		faces += m.faces.size();
+
+	return faces;
+}
+
+// transform, divide, shade, and fill, everything but putting it on screen
+static void a3_frame(bench_state &state)
+{
+	const auto models = make_meshes();
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		state.pause_timing(); // A3 transforms a fresh copy of its meshes, the copy isn't part of the frame
+		auto meshes = models;
+		state.resume_timing();
+
+		project(meshes);
+		compute_color(meshes, bulb, eye);
+
+		image.create(window_width, window_height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(fill_triangles(meshes, image));
+	}
+
+	state.set_items_per_iteration(face_count(models)); // triangles/s
+}
+BENCHMARK(a3_frame);
+
+static void a3_shade(bench_state &state)
+{
+	auto meshes = make_meshes();
+	project(meshes);
+
+	for (auto _ : state)
+	{
+		compute_color(meshes, bulb, eye);
+		clobber_memory();
+	}
+
+	state.set_items_per_iteration(face_count(meshes)); // triangles/s
+}
+BENCHMARK(a3_shade);
+
+static void a3_fill(bench_state &state)
+{
+	auto meshes = make_meshes();
+	project(meshes);
+	compute_color(meshes, bulb, eye);
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(window_width, window_height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(fill_triangles(meshes, image));
+	}
+
+	state.set_items_per_iteration(face_count(meshes)); // triangles/s
+}
+BENCHMARK(a3_fill);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,879 @@
+// A4 benchmarks: matrix/vector ops, ray-surface intersections, and a whole ray traced frame
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+#include "bench.hpp"
+
+#include "matrix.hpp"
+#include "vector.hpp"
+#include "matrix_utils.hpp"
+#include "light.hpp"
+#include "plane.hpp"
+#include "cone.hpp"
+#include "sphere.hpp"
+#include "torus.hpp"
+#include "mesh.hpp"
+#include "instances.hpp"
+#include "csg.hpp"
+#include "sdf.hpp"
+#include "lens.hpp"
+#include "path.hpp"
+#include "wavefront.hpp"
+#include "render.hpp"
+#include "scene.hpp"
+
+// inputs are cycled through so the compiler can't fold the work away, and are small enough to stay in cache
+constexpr size_t input_count = 1024;
+
+static std::mt19937 &rng()
+{
+	static std::mt19937 gen(3388); // fixed seed, every run times the same inputs
+	return gen;
+}
+
+static double random_double(double lo, double hi)
+{
+	return std::uniform_real_distribution<double>(lo, hi)(rng());
+}
+
+static mat4d random_mat4()
+{
+	mat4d m;
+	for (size_t i = 0; i < 4; ++i)
+		for (size_t j = 0; j < 4; ++j)
+			m.at(i, j) = random_double(-1, 1) + (i == j ? 4 : 0); // diagonally dominant, always invertible
+
+	return m;
+}
+
+static vec3d random_vec3()
+{
+	return vec3d{{ random_double(-1, 1), random_double(-1, 1), random_double(-1, 1) }};
+}
+
+// same camera and objects as the A4 scene
+static const vec3d eye{{ 0, 40, 80 }};
+
+static mat4d screen_to_world(size_t width, size_t height)
+{
+	auto ms = screen(1.0 * width, 1.0 * height);
+	auto mp = perspective(10.0, 1.0, -1.0, 1.0, 0.6, -0.6);
+	auto mc = camera<double>(eye, vec3d{{ 0, 0, 0 }}, vec3d{{ 0, 1, 0 }});
+
+	return invert(ms * mp * mc);
+}
+
+// rays from the eye to random points in a box around center, about half of them miss
+static std::vector<std::pair<vec4d, vec4d>> random_rays(const vec3d &center, double extent)
+{
+	std::vector<std::pair<vec4d, vec4d>> rays;
+	for (size_t i = 0; i < input_count; ++i)
+		rays.emplace_back(homo(eye), homo(center + random_vec3() * extent));
+
+	return rays;
+}
+
+static void mat4_mul(bench_state &state)
+{
+	std::vector<mat4d> ms;
+	for (size_t i = 0; i < input_count; ++i)
+		ms.push_back(random_mat4());
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(ms[i] * ms[(i + 1) % input_count]);
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(mat4_mul);
+
+static void mat4_vec_mul(bench_state &state)
+{
+	std::vector<mat4d> ms;
+	std::vector<vec4d> vs;
+	for (size_t i = 0; i < input_count; ++i)
+	{
+		ms.push_back(random_mat4());
+		vs.push_back(homo(random_vec3()));
+	}
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(ms[i] * vs[i]);
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(mat4_vec_mul);
+
+static void mat4_invert(bench_state &state)
+{
+	std::vector<mat4d> ms;
+	for (size_t i = 0; i < input_count; ++i)
+		ms.push_back(random_mat4());
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(invert(ms[i]));
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(mat4_invert);
+
+static void mat4_det(bench_state &state)
+{
+	std::vector<mat4d> ms;
+	for (size_t i = 0; i < input_count; ++i)
+		ms.push_back(random_mat4());
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(det(ms[i]));
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(mat4_det);
+
+static void vec3_norm(bench_state &state)
+{
+	std::vector<vec3d> vs;
+	for (size_t i = 0; i < input_count; ++i)
+		vs.push_back(random_vec3());
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(norm(vs[i]));
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(vec3_norm);
+
+static void vec3_cross(bench_state &state)
+{
+	std::vector<vec3d> vs;
+	for (size_t i = 0; i < input_count; ++i)
+		vs.push_back(random_vec3());
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(cross(vs[i], vs[(i + 1) % input_count]));
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(vec3_cross);
+
+// times obj.intersect() on rays aimed around center
+static void time_intersect(bench_state &state, surface &obj, const vec3d &center, double extent)
+{
+	auto rays = random_rays(center, extent);
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(obj.intersect(rays[i].first, rays[i].second));
+		i = (i + 1) % input_count;
+	}
+}
+
+static void sphere_intersect(bench_state &state)
+{
+	sphere ball;
+	ball.transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
+
+	time_intersect(state, ball, vec3d{{ -20, 20, 0 }}, 40);
+}
+BENCHMARK(sphere_intersect);
+
+// the ball moving 10 to the right over the shutter, each ray at its own time, compare with sphere_intersect for what
+// moving the ray back to time 0 costs
+static void sphere_moving_intersect(bench_state &state)
+{
+	sphere ball;
+	ball.transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
+	ball.move_to(translate(-10.0, 20.0, 0.0) * scale(20.0));
+
+	auto rays = random_rays(vec3d{{ -15, 20, 0 }}, 40);
+
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		do_not_optimize(ball.intersect(rays[i].first, rays[i].second, 1.0 * i / input_count));
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(sphere_moving_intersect);
+
+static void plane_intersect(bench_state &state)
+{
+	plane ground;
+	ground.transforms = scale(100.0) * rotx(-M_PI / 2);
+
+	time_intersect(state, ground, vec3d{{ 0, 0, 0 }}, 200);
+}
+BENCHMARK(plane_intersect);
+
+static void cone_intersect(bench_state &state)
+{
+	cone dunce;
+	dunce.transforms = translate(40.0, 0.0, 0.0) * scale(20.0) * scale(1.0, 2.0, 1.0);
+
+	time_intersect(state, dunce, vec3d{{ 40, 20, 0 }}, 40);
+}
+BENCHMARK(cone_intersect);
+
+// the unit sphere as about a million triangles, 1000 x 500 quads
+static mesh sphere_mesh(size_t threads = 0)
+{
+	mesh m;
+	tessellate_sphere(m, 1000, 500);
+	m.build(threads);
+
+	return m;
+}
+
+// should be about as fast as sphere_intersect, only the depth of the hierarchy is added
+static void mesh_intersect(bench_state &state)
+{
+	static mesh ball = sphere_mesh();
+	ball.transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
+
+	time_intersect(state, ball, vec3d{{ -20, 20, 0 }}, 40);
+}
+BENCHMARK(mesh_intersect);
+
+static void mesh_build(bench_state &state)
+{
+	mesh m;
+	tessellate_sphere(m, 1000, 500);
+
+	for (auto _ : state)
+	{
+		m.build();
+		do_not_optimize(m.nodes.data());
+	}
+
+	state.set_items_per_iteration(m.triangle_count()); // triangles/s
+}
+BENCHMARK(mesh_build);
+
+static void mesh_build_1_thread(bench_state &state)
+{
+	mesh m;
+	tessellate_sphere(m, 1000, 500);
+
+	for (auto _ : state)
+	{
+		m.build(1);
+		do_not_optimize(m.nodes.data());
+	}
+
+	state.set_items_per_iteration(m.triangle_count());
+}
+BENCHMARK(mesh_build_1_thread);
+
+// a ring standing up at the ball's place, most rays around it miss its bounds and never get to the quartic
+static const mat4d ring_transforms = translate(-20.0, 20.0, 0.0) * rotx(M_PI / 3) * scale(20.0);
+
+static void torus_intersect(bench_state &state)
+{
+	torus ring;
+	ring.r_tube = 0.35;
+	ring.transforms = ring_transforms;
+
+	time_intersect(state, ring, vec3d{{ -20, 20, 0 }}, 40);
+}
+BENCHMARK(torus_intersect);
+
+// the same torus as 256 x 128 quads, 65k triangles and 5 MB where the torus is two numbers
+static void torus_mesh_intersect(bench_state &state)
+{
+	static mesh ring = []
+	{
+		mesh m;
+		tessellate_torus(m, 1, 0.35, 256, 128);
+		m.build();
+
+		return m;
+	}();
+	ring.transforms = ring_transforms;
+
+	time_intersect(state, ring, vec3d{{ -20, 20, 0 }}, 40);
+}
+BENCHMARK(torus_mesh_intersect);
+
+// the real roots of quartics with four of them, what a torus costs past its bounds
+static void quartic_solve(bench_state &state)
+{
+	std::vector<std::array<double, 4>> coeffs;
+	for (size_t i = 0; i < input_count; ++i)
+	{
+		double r[4] = { random_double(-5, 5), random_double(-5, 5), random_double(-5, 5), random_double(-5, 5) };
+		coeffs.push_back({
+			-(r[0] + r[1] + r[2] + r[3]),
+			r[0] * r[1] + r[0] * r[2] + r[0] * r[3] + r[1] * r[2] + r[1] * r[3] + r[2] * r[3],
+			-(r[0] * r[1] * r[2] + r[0] * r[1] * r[3] + r[0] * r[2] * r[3] + r[1] * r[2] * r[3]),
+			r[0] * r[1] * r[2] * r[3]
+		});
+	}
+
+	size_t i = 0;
+	double roots[4];
+	for (auto _ : state)
+	{
+		auto &c = coeffs[i];
+		do_not_optimize(solve_quartic(c[0], c[1], c[2], c[3], roots));
+		i = (i + 1) % input_count;
+	}
+}
+BENCHMARK(quartic_solve);
+
+// the ball with a bite taken out of it, compare with sphere_intersect
+static void csg_intersect(bench_state &state)
+{
+	sphere ball, bite;
+	ball.transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
+	bite.transforms = translate(-5.0, 30.0, 12.0) * scale(14.0);
+
+	csg bitten;
+	bitten.op = csg_op::subtract;
+	bitten.left = &ball;
+	bitten.right = &bite;
+	bitten.build();
+
+	time_intersect(state, bitten, vec3d{{ -20, 20, 0 }}, 40);
+}
+BENCHMARK(csg_intersect);
+
+// the union of two balls far apart, a ray through one's box never looks at the other
+static void csg_apart_intersect(bench_state &state)
+{
+	sphere ball, other;
+	ball.transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
+	other.transforms = translate(60.0, 20.0, 0.0) * scale(20.0);
+
+	csg both;
+	both.left = &ball;
+	both.right = &other;
+	both.build();
+
+	time_intersect(state, both, vec3d{{ -20, 20, 0 }}, 40);
+}
+BENCHMARK(csg_apart_intersect);
+
+// the blob traced through its field, compare with sphere_intersect
+static void sdf_trace(bench_state &state, double relax)
+{
+	auto blob = make_sdf(0);
+	blob->transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
+	blob->limits.relax = relax;
+
+	time_intersect(state, *blob, vec3d{{ -20, 20, 0 }}, 40);
+}
+
+static void sdf_intersect(bench_state &state)
+{
+	sdf_trace(state, sdf_limits{}.relax);
+}
+BENCHMARK(sdf_intersect);
+
+// plain sphere tracing, what the relaxed steps save
+static void sdf_unrelaxed_intersect(bench_state &state)
+{
+	sdf_trace(state, 1);
+}
+BENCHMARK(sdf_unrelaxed_intersect);
+
+// the A4 objects, shared by the frame benchmarks
+struct a4_scene
+{
+	sphere ball;
+	plane ground;
+	cone dunce;
+
+	a4_scene()
+	{
+		ball.transforms = translate(-20.0, 20.0, 0.0) * scale(20.0);
+		ball.material = { .color = vec3d{{ 255, 150, 0 }}, .k_ambient = 0.08, .k_diffuse = 1, .k_specular = 255, .k_reflect = 0, .fallout = 256 };
+
+		ground.transforms = scale(100.0) * rotx(-M_PI / 2);
+		ground.material = { .color = vec3d{{ 180, 180, 180 }}, .k_ambient = 0.1, .k_diffuse = 1, .k_specular = 255, .k_reflect = 0, .fallout = 256 };
+
+		dunce.transforms = translate(40.0, 0.0, 0.0) * scale(20.0) * scale(1.0, 2.0, 1.0);
+		dunce.material = { .color = vec3d{{ 0, 180, 180 }}, .k_ambient = 0.12, .k_diffuse = 1, .k_specular = 255, .k_reflect = 0, .fallout = 256 };
+	}
+
+	std::array<surface *, 3> objects() { return {{ &dunce, &ground, &ball }}; }
+};
+
+// times whole frames of the A4 objects lit by lights
+static void time_frame(bench_state &state, const light_list &lights, size_t width, size_t height, const render_options &options)
+{
+	auto inv = screen_to_world(width, height);
+
+	a4_scene objects;
+	auto scene = objects.objects();
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(width, height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(render(scene, lights, eye, inv, image, options));
+	}
+
+	state.set_items_per_iteration(width * height); // rays/s
+}
+
+// the whole A4 scene at its window size
+static void a4_frame(bench_state &state)
+{
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	time_frame(state, lights, 1000, 600, {});
+}
+BENCHMARK(a4_frame);
+
+// relighting a frame from its G-buffer, what a light or material edit costs, compare with a4_frame_small
+static void a4_shading_pass(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto inv = screen_to_world(width, height);
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+	auto scene = objects.objects();
+
+	gbuffer g;
+	visibility_pass(scene, eye, inv, width, height, g);
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(width, height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(shading_pass(scene, lights, eye, g, image));
+	}
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(a4_shading_pass);
+
+// moving the ball a step and tracing only the tiles it and its shadow touch, compare with a4_frame_small
+static void a4_ball_move(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto ms = screen(1.0 * width, 1.0 * height);
+	auto mp = perspective(10.0, 1.0, -1.0, 1.0, 0.6, -0.6);
+	auto mc = camera<double>(eye, vec3d{{ 0, 0, 0 }}, vec3d{{ 0, 1, 0 }});
+	auto mvp = ms * mp * mc;
+	auto inv = invert(mvp);
+
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+	auto scene = objects.objects();
+
+	gbuffer g;
+	sf::Image image;
+	image.create(width, height, sf::Color(0, 0, 0, 0));
+	visibility_pass(scene, eye, inv, width, height, g);
+	shading_pass(scene, lights, eye, g, image);
+
+	// back and forth, so the ball stays put over a run
+	double step = 5;
+	for (auto _ : state)
+	{
+		auto before = objects.ball.world_bounds();
+		objects.ball.transforms = translate(step, 0.0, 0.0) * objects.ball.transforms;
+		step = -step;
+
+		auto dirty = dirty_tiles(scene, lights, mvp, width, height, before, objects.ball.world_bounds());
+		do_not_optimize(render_tiles(scene, lights, eye, inv, g, image, dirty));
+	}
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(a4_ball_move);
+
+// adaptive anti-aliasing up to 16 samples, should stay well under 2x a4_frame_small
+static void a4_frame_aa16(bench_state &state)
+{
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	render_options options;
+	options.aa_samples = 16;
+
+	time_frame(state, lights, 250, 150, options);
+}
+
+static void a4_frame_small(bench_state &state)
+{
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	time_frame(state, lights, 250, 150, {});
+}
+BENCHMARK(a4_frame_small);
+BENCHMARK(a4_frame_aa16);
+
+// the A4 light as a 30 wide square, the shadow samples only all get traced in the penumbra
+static void a4_frame_area_light(bench_state &state)
+{
+	light_shape square{ light_kind::rect, vec3d{{ 30, 0, 0 }}, vec3d{{ 0, 0, 30 }} };
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0, square } };
+
+	time_frame(state, lights, 250, 150, {});
+}
+BENCHMARK(a4_frame_area_light);
+
+// the small frame traced as wavefronts, compare with a4_frame_small, the image is the same
+static void a4_frame_wavefront(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto inv = screen_to_world(width, height);
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+	auto scene = objects.objects();
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(width, height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(render_wavefront(scene, lights, eye, inv, image));
+	}
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(a4_frame_wavefront);
+
+// primary rays of the full A4 frame as the renderers made them, a 4x4 multiply a pixel
+static void primary_rays_multiplied(bench_state &state)
+{
+	const size_t width = 1000, height = 600;
+	auto inv = screen_to_world(width, height);
+
+	for (auto _ : state)
+		for (size_t y = 0; y < height; ++y)
+			for (size_t x = 0; x < width; ++x)
+				do_not_optimize(inv * vec4d{{ 1.0 * x, 1.0 * y, 1, 1 }});
+
+	state.set_items_per_iteration(width * height); // rays/s
+}
+BENCHMARK(primary_rays_multiplied);
+
+// the same rays from the generator, tile by tile along Morton curves, with unit and reciprocal directions
+static void primary_rays_generated(bench_state &state)
+{
+	const size_t width = 1000, height = 600;
+	ray_generator rays(eye, screen_to_world(width, height), width, height);
+	camera_rays batch;
+
+	for (auto _ : state)
+	{
+		for (size_t tile = 0; tile < rays.tiles(); ++tile)
+		{
+			rays.generate(tile, batch, true);
+			do_not_optimize(batch.rz.back());
+		}
+	}
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(primary_rays_generated);
+
+// the same tiles with only the ends, what visibility_pass() asks for
+static void primary_rays_tiled(bench_state &state)
+{
+	const size_t width = 1000, height = 600;
+	ray_generator rays(eye, screen_to_world(width, height), width, height);
+	camera_rays batch;
+
+	for (auto _ : state)
+	{
+		for (size_t tile = 0; tile < rays.tiles(); ++tile)
+		{
+			rays.generate(tile, batch);
+			do_not_optimize(batch.ends.back());
+		}
+	}
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(primary_rays_tiled);
+
+// just the ends, what the intersect() calls take
+static void primary_rays_ends(bench_state &state)
+{
+	const size_t width = 1000, height = 600;
+	ray_generator rays(eye, screen_to_world(width, height), width, height);
+
+	for (auto _ : state)
+		for (size_t y = 0; y < height; ++y)
+			for (size_t x = 0; x < width; ++x)
+				do_not_optimize(rays.end(x, y));
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(primary_rays_ends);
+
+// one path traced sample for every pixel of the small frame on one thread, samples/s a core, compare with a4_frame_small
+static void a4_path_sample(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto inv = screen_to_world(width, height);
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+	auto scene = objects.objects();
+
+	uint32_t n = 0;
+	for (auto _ : state)
+	{
+		for (size_t y = 0; y < height; ++y)
+		{
+			for (size_t x = 0; x < width; ++x)
+			{
+				path_rng rng{ pixel_seed(static_cast<uint32_t>(x), static_cast<uint32_t>(y), n) };
+				do_not_optimize(follow_path(scene, lights, eye, inv, 1.0 * x, 1.0 * y, {}, {}, rng));
+			}
+		}
+
+		n += 1;
+	}
+
+	state.set_items_per_iteration(width * height); // samples/s
+}
+BENCHMARK(a4_path_sample);
+
+// the small frame through a lens focused on the gaze point, 16 samples a pixel in the tiles that could blur
+// compare with a4_frame_small for the tiles left at one, and with a4_frame_aa16
+static void a4_frame_lens(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto inv = screen_to_world(width, height);
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+	auto scene = objects.objects();
+
+	lens_options options;
+	options.aperture = 1;
+
+	thin_lens lens(eye, vec3d{{ 0, 0, 0 }}, vec3d{{ 0, 1, 0 }}, inv, width, height, options);
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(width, height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(render_lens(scene, lights, lens, image));
+	}
+
+	state.set_items_per_iteration(width * height); // pixels/s
+}
+BENCHMARK(a4_frame_lens);
+
+// the small frame through a pinhole with the ball moving 10 to the right while the shutter is open, 16 samples a pixel
+// in the tiles it or its shadow sweeps over, compare with a4_frame_lens
+static void a4_frame_motion(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto inv = screen_to_world(width, height);
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+	objects.ball.move_to(translate(-10.0, 20.0, 0.0) * scale(20.0));
+	auto scene = objects.objects();
+
+	thin_lens lens(eye, vec3d{{ 0, 0, 0 }}, vec3d{{ 0, 1, 0 }}, inv, width, height, {});
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(width, height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(render_lens(scene, lights, lens, image));
+	}
+
+	state.set_items_per_iteration(width * height); // pixels/s
+}
+BENCHMARK(a4_frame_motion);
+
+// the ball as a million triangles, compare with a4_frame_small
+static void a4_frame_mesh(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto inv = screen_to_world(width, height);
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+
+	static mesh ball = sphere_mesh();
+	ball.transforms = objects.ball.transforms;
+	ball.material = objects.ball.material;
+
+	std::array<surface *, 3> scene{{ &objects.dunce, &objects.ground, &ball }};
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(width, height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(render(scene, lights, eye, inv, image));
+	}
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(a4_frame_mesh);
+
+// 10k copies of a 2k triangle cone on the A4 ground, each copy is an instance of 264 bytes where a copy of the mesh
+// would be about 100 KB, so 2.6 MB all told instead of 1 GB
+static void a4_frame_forest(bench_state &state)
+{
+	const size_t width = 250, height = 150;
+
+	auto inv = screen_to_world(width, height);
+	light_list lights{ { {{ 40.0, 80.0, 0.0, 1.0 }}, 1.0 } };
+
+	a4_scene objects;
+
+	static mesh tree;
+	static instance_set forest;
+
+	if (forest.instances.empty())
+	{
+		tessellate_cone(tree, 64, 16);
+		tree.build();
+
+		forest.shape = &tree;
+		uint32_t looks[2] = {
+			forest.add_look({ .color = vec3d{{ 30, 120, 40 }}, .k_ambient = 0.1, .k_diffuse = 1, .k_specular = 255, .k_reflect = 0, .fallout = 256 }),
+			forest.add_look({ .color = vec3d{{ 60, 140, 30 }}, .k_ambient = 0.1, .k_diffuse = 1, .k_specular = 255, .k_reflect = 0, .fallout = 256 })
+		};
+
+		for (size_t i = 0; i < 10000; ++i)
+		{
+			auto place = translate(random_double(-100, 100), 0.0, random_double(-100, 100)) * roty(random_double(0, 2 * M_PI)) *
+				scale(random_double(1, 2), random_double(4, 8), random_double(1, 2));
+			forest.add(place, looks[i % 2]);
+		}
+
+		forest.build();
+	}
+
+	std::array<surface *, 2> scene{{ &objects.ground, &forest }};
+
+	sf::Image image;
+	for (auto _ : state)
+	{
+		image.create(width, height, sf::Color(0, 0, 0, 0));
+		do_not_optimize(render(scene, lights, eye, inv, image));
+	}
+
+	state.set_items_per_iteration(width * height);
+}
+BENCHMARK(a4_frame_forest);
+
+// lights scattered above the scene, as bright together as the one A4 light
+static light_list random_lights(size_t count)
+{
+	light_list lights;
+	for (size_t i = 0; i < count; ++i)
+		lights.add({ {{ random_double(-100, 100), random_double(20, 120), random_double(-100, 100), 1.0 }}, 1.5 / count });
+
+	lights.build_tree();
+	return lights;
+}
+
+// sampling 4 lights a hit should cost about the same whatever the light count
+static void a4_frame_lights_sampled(bench_state &state, size_t count)
+{
+	render_options options;
+	options.light_samples = 4;
+
+	time_frame(state, random_lights(count), 250, 150, options);
+}
+
+static void a4_frame_16_lights_sampled(bench_state &state) { a4_frame_lights_sampled(state, 16); }
+static void a4_frame_4096_lights_sampled(bench_state &state) { a4_frame_lights_sampled(state, 4096); }
+BENCHMARK(a4_frame_16_lights_sampled);
+BENCHMARK(a4_frame_4096_lights_sampled);
+
+// a scene file of count random spheres, written to the temp directory the once
+static std::string random_scene_file(size_t count)
+{
+	auto path = (std::filesystem::temp_directory_path() / ("a4_bench_" + std::to_string(count) + ".scene")).string();
+	if (std::filesystem::exists(path))
+		return path;
+
+	std::ofstream out(path);
+	out << "light 40 80 0 1\n";
+
+	char line[160];
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::snprintf(line, sizeof(line), "sphere\n\ttranslate %.3f %.3f %.3f\n\tscale %.3f\n\tcolor %d %d %d\n",
+			random_double(-100, 100), random_double(0, 50), random_double(-100, 100), random_double(0.1, 2),
+			static_cast<int>(random_double(0, 255)), static_cast<int>(random_double(0, 255)), static_cast<int>(random_double(0, 255)));
+		out << line;
+	}
+
+	return path;
+}
+
+// parsing 100k surfaces from text, compare with a4_scene_cached
+static void a4_scene_parse(bench_state &state)
+{
+	auto path = random_scene_file(100000);
+
+	std::ifstream in(path);
+	std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	for (auto _ : state)
+	{
+		scene_data scene;
+		std::string error;
+		do_not_optimize(parse_scene(text, scene, error));
+	}
+
+	state.set_items_per_iteration(100000); // surfaces/s
+}
+BENCHMARK(a4_scene_parse);
+
+// the same scene mapped from its binary cache, hashing the text included
+static void a4_scene_cached(bench_state &state)
+{
+	auto path = random_scene_file(100000);
+
+	scene_data warm;
+	std::string error;
+	load_scene(path, warm, error); // writes the cache if it's not there yet
+
+	for (auto _ : state)
+	{
+		scene_data scene;
+		do_not_optimize(load_scene(path, scene, error));
+	}
+
+	state.set_items_per_iteration(100000);
+}
+BENCHMARK(a4_scene_cached);
+
+BENCHMARK_MAIN();
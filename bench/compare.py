@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+# compares two benchmark result files written with --out, flags benchmarks that got slower than the threshold
+# usage: compare.py <baseline.json> <contender.json> [--threshold 5]
+# exits with 1 when anything regressed, so it can gate a build
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        results = json.load(f)
+
+    # only the median (real_time) is compared, it's the least sensitive to the odd slow repetition
+    return {b['name']: b for b in results['benchmarks']}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='compare two benchmark runs')
+    parser.add_argument('baseline')
+    parser.add_argument('contender')
+    parser.add_argument('--threshold', type=float, default=5.0, help='%% slowdown that counts as a regression')
+    args = parser.parse_args()
+
+    base = load(args.baseline)
+    new = load(args.contender)
+
+    print(f'{"benchmark":<28} {"baseline ns":>14} {"contender ns":>14} {"change":>9}')
+
+    regressed = []
+    for name, b in base.items():
+        if name not in new:
+            print(f'{name:<28} {b["real_time"]:>14.1f} {"missing":>14}')
+            continue
+
+        old_ns = b['real_time']
+        new_ns = new[name]['real_time']
+        change = 100.0 * (new_ns - old_ns) / old_ns if old_ns > 0 else 0.0
+
+        # a difference smaller than the noise of either run isn't worth flagging
+        noise = 100.0 * max(b.get('stddev_time', 0.0) / old_ns if old_ns > 0 else 0.0,
+                            new[name].get('stddev_time', 0.0) / new_ns if new_ns > 0 else 0.0)
+
+        flag = ''
+        if change > max(args.threshold, noise):
+            flag = '  REGRESSION'
+            regressed.append(name)
+        elif change < -max(args.threshold, noise):
+            flag = '  faster'
+
+        print(f'{name:<28} {old_ns:>14.1f} {new_ns:>14.1f} {change:>+8.1f}%{flag}')
+
+    for name in new:
+        if name not in base:
+            print(f'{name:<28} {"new":>14} {new[name]["real_time"]:>14.1f}')
+
+    if regressed:
+        print(f'\n{len(regressed)} regression(s) over {args.threshold}%: {", ".join(regressed)}')
+        return 1
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
+#include "profiler.hpp"
+
+profiler::scope::scope(profiler &prof, size_t stage) :
+	prof(prof),
+	stage(stage),
+	start(clock::now())
+{}
+
+profiler::scope::~scope()
+{
+	prof.current.stage_ms[stage] += ms_since(start);
+}
+
+profiler::profiler(std::vector<std::string> stage_names, size_t capacity) :
+	names(std::move(stage_names)),
+	ring(std::max<size_t>(capacity, 1))
+{
+	names.resize(std::min(names.size(), frame_record::max_stages));
+}
+
+void profiler::begin_frame()
+{
+	current = {};
+	frame_start = clock::now();
+}
+
+void profiler::end_frame()
+{
+	current.frame_ms = ms_since(frame_start);
+
+	ring[head] = current;
+	head = (head + 1) % ring.size();
+	filled = std::min(filled + 1, ring.size());
+}
+
+profiler::scope profiler::time(size_t stage)
+{
+	return scope(*this, stage);
+}
+
+void profiler::count(const draw_counts &counts)
+{
+	current.counts.lines += counts.lines;
+	current.counts.pixels += counts.pixels;
+	current.counts.triangles += counts.triangles;
+}
+
+size_t profiler::frames() const
+{
+	return filled;
+}
+
+double profiler::percentile(double p) const
+{
+	if (filled == 0)
+		return 0;
+
+	std::vector<double> times;
+	times.reserve(filled);
+	for (size_t i = 0; i < filled; ++i)
+		times.push_back(ring[i].frame_ms);
+
+	// nearest rank
+	size_t rank = static_cast<size_t>(std::clamp(p / 100.0, 0.0, 1.0) * (filled - 1) + 0.5);
+	std::nth_element(times.begin(), times.begin() + rank, times.end());
+
+	return times[rank];
+}
+
+std::string profiler::summary() const
+{
+	char line[128];
+	std::string text;
+
+	std::snprintf(line, sizeof(line), "frame ms  p50 %.2f  p95 %.2f  p99 %.2f  (%zu frames)\n",
+		percentile(50), percentile(95), percentile(99), filled);
+	text += line;
+
+	if (filled == 0)
+		return text;
+
+	const auto &last = ring[(head + ring.size() - 1) % ring.size()];
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		std::snprintf(line, sizeof(line), "%-10s %8.2f ms\n", names[i].c_str(), last.stage_ms[i]);
+		text += line;
+	}
+
+	std::snprintf(line, sizeof(line), "lines %zu  pixels %zu  triangles %zu",
+		last.counts.lines, last.counts.pixels, last.counts.triangles);
+	text += line;
+
+	return text;
+}
+
+bool profiler::dump_csv(const std::string &path) const
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+
+	out << "frame,frame_ms";
+	for (auto &name : names)
+		out << ',' << name << "_ms";
+	out << ",lines,pixels,triangles\n";
+
+	size_t oldest = (head + ring.size() - filled) % ring.size();
+	for (size_t i = 0; i < filled; ++i)
+	{
+		const auto &rec = ring[(oldest + i) % ring.size()];
+
+		out << i << ',' << rec.frame_ms;
+		for (size_t s = 0; s < names.size(); ++s)
+			out << ',' << rec.stage_ms[s];
+		out << ',' << rec.counts.lines << ',' << rec.counts.pixels << ',' << rec.counts.triangles << '\n';
+	}
+
+	return out.good();
+}
+
+double profiler::ms_since(clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+}
+
+stats_overlay::stats_overlay()
+{
+	const char *fonts[] = {
+		"C:\\Windows\\Fonts\\consola.ttf",
+		"/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+		"/System/Library/Fonts/Menlo.ttc",
+	};
+
+	for (auto path : fonts)
+	{
+		if (font.loadFromFile(path))
+		{
+			has_font = true;
+			break;
+		}
+	}
+
+	text.setFont(font);
+	text.setCharacterSize(14);
+	text.setFillColor(sf::Color::Red);
+	text.setPosition(8, 8);
+}
+
+void stats_overlay::draw(sf::RenderWindow &window, const profiler &prof)
+{
+	auto summary = prof.summary();
+
+	if (!has_font)
+	{
+		window.setTitle(summary.substr(0, summary.find('\n')));
+		return;
+	}
+
+	text.setString(summary);
+	window.draw(text);
+}
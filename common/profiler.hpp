@@ -0,0 +1,103 @@
+#ifndef COMMON_PROFILER_HPP
+#define COMMON_PROFILER_HPP
+
+// frame timings shared by A2, A3 and A4, one copy here that each project builds with its own sources
+// draw_counts lives here as well, since the drawing code of every project returns one
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <SFML/Graphics.hpp>
+
+// how much got drawn, returned by the drawing functions
+struct draw_counts
+{
+	size_t lines = 0;
+	size_t pixels = 0;
+	size_t triangles = 0;
+};
+
+// timings and draw counts of one frame
+struct frame_record
+{
+	constexpr static size_t max_stages = 8;
+
+	std::array<double, max_stages> stage_ms{}; // time spent in each stage
+	double frame_ms = 0; // begin_frame() to end_frame()
+	draw_counts counts;
+};
+
+// records per-stage frame timings into a ring buffer of the last capacity frames
+// stages are indices into the names given at construction, usually an enum of the program's stages
+class profiler
+{
+public:
+	using clock = std::chrono::steady_clock;
+
+	// adds the time it's alive to a stage of the current frame
+	class scope
+	{
+		profiler &prof;
+		size_t stage;
+		clock::time_point start;
+
+	public:
+		scope(profiler &prof, size_t stage);
+		~scope();
+
+		scope(const scope &) = delete;
+		scope &operator=(const scope &) = delete;
+	};
+
+	profiler(std::vector<std::string> stage_names, size_t capacity = 1024);
+
+	void begin_frame();
+	void end_frame();
+
+	// times a stage until the returned scope goes out of scope
+	scope time(size_t stage);
+
+	// adds to the draw counts of the current frame
+	void count(const draw_counts &counts);
+
+	// number of frames kept, at most capacity
+	size_t frames() const;
+
+	// p-th percentile (0 to 100) of the kept frame times, in ms
+	double percentile(double p) const;
+
+	// text for the overlay: frame time percentiles, stages and counts of the last frame
+	std::string summary() const;
+
+	// writes the kept frames oldest first, one row per frame
+	bool dump_csv(const std::string &path) const;
+
+private:
+	std::vector<std::string> names;
+	std::vector<frame_record> ring;
+	size_t head = 0; // where the next frame goes
+	size_t filled = 0;
+
+	frame_record current;
+	clock::time_point frame_start;
+
+	static double ms_since(clock::time_point start);
+};
+
+// draws the profiler summary in the top left corner of a window
+// SFML can't draw text without a font file, if none of the usual monospace fonts are around the summary goes in the title bar
+class stats_overlay
+{
+	sf::Font font;
+	sf::Text text;
+	bool has_font = false;
+
+public:
+	stats_overlay();
+
+	void draw(sf::RenderWindow &window, const profiler &prof);
+};
+
+#endif //COMMON_PROFILER_HPP
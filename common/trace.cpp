@@ -0,0 +1,123 @@
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#include "trace.hpp"
+
+int32_t trace_fine_stride = 8;
+
+static const auto trace_epoch = std::chrono::steady_clock::now();
+
+static std::mutex registry_lock;
+static std::vector<std::unique_ptr<trace_buffer>> registry; // every thread's buffer, in order of first use
+
+static const trace_buffer *main_buffer = nullptr; // set by trace_start()
+static const char *trace_category = "trace";
+
+trace_buffer &trace_local()
+{
+	thread_local trace_buffer *local = nullptr;
+
+	if (!local)
+	{
+		auto buffer = std::make_unique<trace_buffer>();
+		buffer->events.reserve(trace_capacity);
+
+		std::lock_guard<std::mutex> guard(registry_lock);
+		buffer->tid = static_cast<uint32_t>(registry.size());
+		local = buffer.get();
+		registry.push_back(std::move(buffer));
+	}
+
+	return *local;
+}
+
+void trace_start(const char *category)
+{
+	trace_category = category;
+	main_buffer = &trace_local();
+}
+
+int64_t trace_now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count();
+}
+
+bool write_trace(const std::string &path)
+{
+	std::ofstream out(path);
+	if (!out)
+		return false;
+
+	std::lock_guard<std::mutex> guard(registry_lock);
+
+	size_t dropped = 0;
+	bool first = true;
+
+	out << std::fixed << std::setprecision(3); // ts and dur are in us, keep ns resolution
+	out << "{\"traceEvents\":[\n";
+
+	for (auto &buffer : registry)
+	{
+		if (!first)
+			out << ",\n";
+		first = false;
+
+		auto thread_name = buffer.get() == main_buffer ? std::string("main") : "worker " + std::to_string(buffer->tid);
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid
+			<< ",\"args\":{\"name\":\"" << thread_name << "\"}}";
+
+		for (auto &e : buffer->events)
+		{
+			out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << trace_category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+				<< ",\"ts\":" << e.start_ns / 1000.0 << ",\"dur\":" << e.dur_ns / 1000.0
+				<< ",\"args\":{\"tile\":" << e.tile << ",\"object\":" << e.object << "}}";
+		}
+
+		dropped += buffer->dropped;
+	}
+
+	out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_zones\":" << dropped << "}}\n";
+
+	return out.good();
+}
+
+trace_zone::trace_zone(const char *name, int32_t object, bool fine) :
+	name(fine && !trace_local().fine ? nullptr : name),
+	object(object),
+	start(this->name ? trace_now() : 0)
+{}
+
+trace_zone::~trace_zone()
+{
+	if (!name)
+		return;
+
+	auto &buffer = trace_local();
+
+	if (buffer.events.size() == buffer.events.capacity())
+	{
+		buffer.dropped += 1;
+		return;
+	}
+
+	buffer.events.push_back({ name, start, trace_now() - start, buffer.tile, object });
+}
+
+trace_tile::trace_tile(int32_t tile) :
+	previous(trace_local().tile)
+{
+	auto &buffer = trace_local();
+
+	buffer.tile = tile;
+	buffer.fine = trace_fine_stride <= 1 || tile % trace_fine_stride == 0;
+}
+
+trace_tile::~trace_tile()
+{
+	auto &buffer = trace_local();
+
+	buffer.tile = previous;
+	buffer.fine = trace_fine_stride <= 1 || previous < 0 || previous % trace_fine_stride == 0;
+}
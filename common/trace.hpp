@@ -0,0 +1,100 @@
+#ifndef COMMON_TRACE_HPP
+#define COMMON_TRACE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// scoped zone tracing, written out as Chrome trace_event JSON (chrome://tracing, ui.perfetto.dev), shared by A3 and A4
+// everything compiles away unless ENABLE_TRACING is defined
+//
+// each thread records into its own preallocated buffer, so recording a zone takes no locks and no allocations
+// once a buffer is full further zones on that thread are dropped and counted instead
+// a whole frame has millions of per-ray or per-triangle zones, so fine zones are only kept in every trace_fine_stride-th tile
+// write_trace() must only be called once the traced threads are done
+
+// one finished zone
+struct trace_event
+{
+	const char *name; // has to outlive the trace, string literals only
+	int64_t start_ns;
+	int64_t dur_ns;
+	int32_t tile; // -1 when not in a tile
+	int32_t object; // -1 when not about an object
+};
+
+// events of one thread, owned by the trace so they outlive the thread
+struct trace_buffer
+{
+	std::vector<trace_event> events;
+	size_t dropped = 0;
+	uint32_t tid = 0;
+	int32_t tile = -1; // tile this thread is working on, tags every zone it records
+	bool fine = true; // whether fine zones are kept in this tile
+};
+
+// max events kept per thread
+constexpr size_t trace_capacity = 1 << 20;
+
+// fine zones are kept in tiles whose id is a multiple of this, set it before tracing starts
+extern int32_t trace_fine_stride;
+
+// buffer of the calling thread, registered on first use
+trace_buffer &trace_local();
+
+// marks the calling thread as the main one and names the category every zone is written under, "a3" or "a4"
+// call it from main before starting any thread, workers can register before main records its first zone
+void trace_start(const char *category);
+
+// ns since the trace started
+int64_t trace_now();
+
+// writes every thread's events as trace_event JSON, false if the file can't be written
+bool write_trace(const std::string &path);
+
+// records a zone from construction to destruction on the calling thread
+// fine zones are the per-ray or per-triangle ones, skipped outside the sampled tiles
+class trace_zone
+{
+	const char *name; // null when skipped
+	int32_t object;
+	int64_t start;
+
+public:
+	trace_zone(const char *name, int32_t object = -1, bool fine = false);
+	~trace_zone();
+
+	trace_zone(const trace_zone &) = delete;
+	trace_zone &operator=(const trace_zone &) = delete;
+};
+
+// tags zones recorded on the calling thread with a tile id while alive
+class trace_tile
+{
+	int32_t previous;
+
+public:
+	trace_tile(int32_t tile);
+	~trace_tile();
+
+	trace_tile(const trace_tile &) = delete;
+	trace_tile &operator=(const trace_tile &) = delete;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#if defined(ENABLE_TRACING)
+#define TRACE_ZONE(name) ::trace_zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define TRACE_FINE_ZONE(name) ::trace_zone TRACE_CONCAT(trace_zone_, __LINE__)(name, -1, true)
+#define TRACE_OBJECT_ZONE(name, object) ::trace_zone TRACE_CONCAT(trace_zone_, __LINE__)(name, static_cast<int32_t>(object), true)
+#define TRACE_TILE(tile) ::trace_tile TRACE_CONCAT(trace_tile_, __LINE__)(static_cast<int32_t>(tile))
+#else
+#define TRACE_ZONE(name)
+#define TRACE_FINE_ZONE(name)
+#define TRACE_OBJECT_ZONE(name, object)
+#define TRACE_TILE(tile)
+#endif
+
+#endif //COMMON_TRACE_HPP